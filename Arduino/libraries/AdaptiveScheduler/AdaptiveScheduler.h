@@ -0,0 +1,170 @@
+/*
+ * Adaptive sampling scheduler
+ *
+ * Chooses the next sampling interval from how fast the readings change,
+ * and decides which samples are worth publishing:
+ * - Stable readings (every channel within its deadband of the previous
+ *   sample) stretch the interval by 1.5x, up to max_interval_ms
+ * - Readings moving by more than the deadband halve it
+ * - A jump of at least fast_step, or a threshold crossing, drops straight
+ *   to min_interval_ms
+ * - publish_due() is true once any channel has moved by its deadband
+ *   since the last published sample, on a threshold crossing, or after
+ *   heartbeat_ms without a publish
+ *
+ * Values are the integer fixed-point units the sketch already uses
+ * (centi-degC, Pa, ...). Not thread safe: keep it in the task that reads
+ * the sensors.
+ *
+ * Usage per reading:
+ *   scheduler.update(TEMP_CHANNEL, sample.sht21_temp);
+ *   ...
+ *   uint32_t next = scheduler.end_sample();
+ *   if (scheduler.publish_due(millis())) { publish(); scheduler.published(millis()); }
+ */
+
+#ifndef ADAPTIVE_SCHEDULER_H
+#define ADAPTIVE_SCHEDULER_H
+
+#include <Arduino.h>
+
+#define ADAPTIVE_MAX_CHANNELS 8
+#define ADAPTIVE_NO_THRESHOLD INT32_MIN
+
+// Change seen in one sampling cycle
+#define ADAPTIVE_STABLE   0
+#define ADAPTIVE_CHANGING 1
+#define ADAPTIVE_FAST     2
+
+class AdaptiveScheduler {
+public:
+  AdaptiveScheduler(uint32_t min_interval_ms, uint32_t max_interval_ms, uint32_t heartbeat_ms)
+    : _min_interval(min_interval_ms),
+      _max_interval(max_interval_ms < min_interval_ms ? min_interval_ms : max_interval_ms),
+      _heartbeat(heartbeat_ms), _interval(min_interval_ms), _num_channels(0),
+      _cycle_change(ADAPTIVE_STABLE), _significant(true), _last_publish(0) {}
+
+  // deadband: smallest change worth publishing; fast_step: change between
+  // two samples that returns to the fastest rate; threshold: level whose
+  // crossing is always published (e.g. an IAQ alarm level). Returns the
+  // channel index, or -1 when all channels are in use.
+  int8_t add_channel(int32_t deadband, int32_t fast_step, int32_t threshold = ADAPTIVE_NO_THRESHOLD) {
+    if (_num_channels >= ADAPTIVE_MAX_CHANNELS) {
+      return -1;
+    }
+    Channel& ch = _channels[_num_channels];
+    ch.deadband = deadband;
+    ch.fast_step = fast_step;
+    ch.threshold = threshold;
+    ch.has_value = false;
+    return _num_channels++;
+  }
+
+  // Record this cycle's value; channels without a valid reading are skipped
+  void update(uint8_t channel, int32_t value) {
+    if (channel >= _num_channels) {
+      return;
+    }
+    Channel& ch = _channels[channel];
+
+    if (!ch.has_value) {
+      // First reading: publish it and keep sampling fast
+      ch.has_value = true;
+      ch.last_sample = value;
+      ch.last_published = value;
+      _significant = true;
+      _cycle_change = ADAPTIVE_FAST;
+      return;
+    }
+
+    uint32_t step = _distance(value, ch.last_sample);
+    if (step >= (uint32_t)ch.fast_step) {
+      _raise(ADAPTIVE_FAST);
+    } else if (step >= (uint32_t)ch.deadband) {
+      _raise(ADAPTIVE_CHANGING);
+    }
+
+    if (ch.threshold != ADAPTIVE_NO_THRESHOLD &&
+        (value >= ch.threshold) != (ch.last_sample >= ch.threshold)) {
+      _raise(ADAPTIVE_FAST);
+      _significant = true;
+    }
+
+    if (_distance(value, ch.last_published) >= (uint32_t)ch.deadband) {
+      _significant = true;
+    }
+
+    ch.last_sample = value;
+  }
+
+  // Close the cycle: adapt and return the interval until the next sample
+  uint32_t end_sample() {
+    if (_cycle_change == ADAPTIVE_FAST) {
+      _interval = _min_interval;
+    } else if (_cycle_change == ADAPTIVE_CHANGING) {
+      _interval = _interval / 2 > _min_interval ? _interval / 2 : _min_interval;
+    } else {
+      uint32_t longer = _interval + _interval / 2;
+      _interval = longer < _max_interval ? longer : _max_interval;
+    }
+    _cycle_change = ADAPTIVE_STABLE;
+    return _interval;
+  }
+
+  // Force the fastest rate and a publish (e.g. after a user command)
+  void trigger() {
+    _cycle_change = ADAPTIVE_FAST;
+    _interval = _min_interval;
+    _significant = true;
+  }
+
+  bool publish_due(uint32_t now) {
+    return _significant || now - _last_publish >= _heartbeat;
+  }
+
+  // Current values become the reference for the next publish decision
+  void published(uint32_t now) {
+    for (uint8_t i = 0; i < _num_channels; i++) {
+      _channels[i].last_published = _channels[i].last_sample;
+    }
+    _significant = false;
+    _last_publish = now;
+  }
+
+  uint32_t interval() { return _interval; }
+  uint32_t min_interval() { return _min_interval; }
+  uint32_t max_interval() { return _max_interval; }
+
+private:
+  struct Channel {
+    int32_t deadband;
+    int32_t fast_step;
+    int32_t threshold;
+    int32_t last_sample;
+    int32_t last_published;
+    bool has_value;
+  };
+
+  uint32_t _min_interval;
+  uint32_t _max_interval;
+  uint32_t _heartbeat;
+  uint32_t _interval;
+
+  Channel _channels[ADAPTIVE_MAX_CHANNELS];
+  uint8_t _num_channels;
+  uint8_t _cycle_change;
+  bool _significant;
+  uint32_t _last_publish;
+
+  static uint32_t _distance(int32_t a, int32_t b) {
+    return a > b ? (uint32_t)a - (uint32_t)b : (uint32_t)b - (uint32_t)a;
+  }
+
+  void _raise(uint8_t change) {
+    if (change > _cycle_change) {
+      _cycle_change = change;
+    }
+  }
+};
+
+#endif
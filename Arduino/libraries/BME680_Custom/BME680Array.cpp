@@ -0,0 +1,139 @@
+/*
+ * BME680 array implementation
+ */
+
+#include "BME680Array.h"
+
+BME680Array::BME680Array(I2CBus& bus) {
+  _bus = &bus;
+  _mux_addr = TCA9548A_I2C_ADDR;
+  _count = 0;
+}
+
+bool BME680Array::add(BME680_Custom& sensor, uint8_t mux_channel) {
+  if (_count >= BME680_ARRAY_MAX) {
+    return false;
+  }
+  
+  Device& dev = _devices[_count++];
+  dev.sensor = &sensor;
+  dev.mux_channel = mux_channel;
+  sensor.set_nvs_channel(mux_channel);
+  dev.state = MEAS_IDLE;
+  dev.present = false;
+  dev.valid = false;
+  return true;
+}
+
+bool BME680Array::select(uint8_t index) {
+  uint8_t channel = _devices[index].mux_channel;
+  if (channel == BME680_NO_MUX) {
+    return true;
+  }
+  return _bus->write_cmd(_mux_addr, (uint8_t)(1 << (channel & 0x07)));
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool BME680Array::restore_state(uint8_t index, uint32_t max_age_seconds) {
+  I2CBusLock hold(*_bus);
+  return select(index) && _devices[index].sensor->restore_state(max_age_seconds);
+}
+#endif
+
+uint8_t BME680Array::begin() {
+  uint8_t found = 0;
+  
+  for (uint8_t i = 0; i < _count; i++) {
+    I2CBusLock hold(*_bus);
+    Device& dev = _devices[i];
+    dev.present = select(i) && dev.sensor->begin();
+    dev.state = MEAS_IDLE;
+    if (dev.present) found++;
+  }
+  return found;
+}
+
+uint8_t BME680Array::start_measurement() {
+  uint8_t started = 0;
+  
+  // Back to back, so all conversions overlap
+  for (uint8_t i = 0; i < _count; i++) {
+    Device& dev = _devices[i];
+    dev.valid = false;
+    if (!dev.present) {
+      dev.state = MEAS_IDLE;
+      continue;
+    }
+  
+    I2CBusLock hold(*_bus);
+    if (select(i) && dev.sensor->start_measurement()) {
+      dev.state = MEAS_PENDING;
+      started++;
+    } else {
+      dev.state = MEAS_ERROR;
+    }
+  }
+  return started;
+}
+
+uint8_t BME680Array::poll() {
+  bool pending = false;
+  bool ready = false;
+  
+  for (uint8_t i = 0; i < _count; i++) {
+    Device& dev = _devices[i];
+    if (dev.state == MEAS_PENDING) {
+      I2CBusLock hold(*_bus);
+      dev.state = select(i) ? dev.sensor->poll() : MEAS_ERROR;
+    }
+    pending |= dev.state == MEAS_PENDING;
+    ready |= dev.state == MEAS_READY;
+  }
+  
+  if (pending) return MEAS_PENDING;
+  return ready ? MEAS_READY : MEAS_ERROR;
+}
+
+uint8_t BME680Array::fetch() {
+  uint8_t valid = 0;
+  
+  for (uint8_t i = 0; i < _count; i++) {
+    Device& dev = _devices[i];
+    if (dev.state != MEAS_READY) {
+      continue;
+    }
+  
+    I2CBusLock hold(*_bus);
+    dev.valid = select(i) && dev.sensor->fetch();
+    dev.state = MEAS_IDLE;
+    if (dev.valid) valid++;
+  }
+  return valid;
+}
+
+uint16_t BME680Array::get_time_until_ready() {
+  // Local timing only, no bus traffic
+  uint16_t wait = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_devices[i].state == MEAS_PENDING) {
+      wait = max(wait, _devices[i].sensor->get_time_until_ready());
+    }
+  }
+  return wait;
+}
+
+uint8_t BME680Array::measure() {
+  if (start_measurement() == 0) {
+    return 0;
+  }
+  
+  uint16_t wait = get_time_until_ready();
+  if (wait > 0) {
+    delay(wait);
+  }
+  
+  while (poll() == MEAS_PENDING) {
+    delay(1);
+  }
+  return fetch();
+}
@@ -0,0 +1,91 @@
+/*
+ * Several BME680s read in one acquisition pass
+ *
+ * Holds up to BME680_ARRAY_MAX BME680_Custom instances (each with its own
+ * calibration, settings and baseline), either at 0x76/0x77 on the same bus
+ * or behind a TCA9548A mux. start_measurement() triggers forced mode on all
+ * of them back to back, so the conversions run in parallel. After a single
+ * wait for the slowest one, poll() and fetch() read every result in one
+ * pass. N sensors take about as long as one conversion.
+ *
+ * Behind a mux, call a device's methods through the array, or select()
+ * it while holding the bus (I2CBusLock) first. add() puts the mux channel
+ * in each device's NVS key, so devices with the same address on different
+ * channels save and restore their own state.
+ */
+
+#ifndef BME680_ARRAY_H
+#define BME680_ARRAY_H
+
+#include <Arduino.h>
+#include "I2CBus.h"
+#include "BME680_Custom.h"
+
+#define BME680_ARRAY_MAX 8
+#define BME680_NO_MUX    BME680_NVS_NO_CHANNEL  // Device is directly on the bus
+
+#define TCA9548A_I2C_ADDR 0x70
+
+class BME680Array {
+public:
+  BME680Array(I2CBus& bus = i2c_bus);
+
+  // Route devices with a mux channel through a TCA9548A at mux_addr
+  void set_mux(uint8_t mux_addr = TCA9548A_I2C_ADDR) { _mux_addr = mux_addr; }
+
+  // The sensor must outlive the array. Returns false when full.
+  bool add(BME680_Custom& sensor, uint8_t mux_channel = BME680_NO_MUX);
+
+  // begin() on every device; returns how many answered. Missing
+  // devices are skipped by every later pass.
+  uint8_t begin();
+
+  // Triggers all present devices; returns how many started
+  uint8_t start_measurement();
+
+  // MEAS_PENDING until every started device has finished, then
+  // MEAS_READY if at least one has a result, MEAS_ERROR if none
+  uint8_t poll();
+
+  // Reads every finished device into its data/data_fixed; returns how
+  // many have a valid reading
+  uint8_t fetch();
+
+  // Time until the slowest device is done
+  uint16_t get_time_until_ready();
+
+  // Blocking: start, one shared wait, read all
+  uint8_t measure();
+
+  uint8_t size() { return _count; }
+  BME680_Custom& device(uint8_t index) { return *_devices[index].sensor; }
+  bool is_present(uint8_t index) { return _devices[index].present; }
+  bool is_valid(uint8_t index) { return _devices[index].valid; }  // Last fetch()
+  uint8_t get_mux_channel(uint8_t index) { return _devices[index].mux_channel; }
+
+  // Routes the mux to the device (no-op without one)
+  bool select(uint8_t index);
+
+#if defined(ARDUINO_ARCH_ESP32)
+  // Device state save/restore; restore reads the chip, so it goes
+  // through the mux
+  bool save_state(uint8_t index) { return _devices[index].sensor->save_state(); }
+  bool restore_state(uint8_t index, uint32_t max_age_seconds = BME680_STATE_MAX_AGE);
+#endif
+
+private:
+  struct Device {
+    BME680_Custom* sensor;
+    uint8_t mux_channel;
+    uint8_t state;
+    bool present;
+    bool valid;
+  };
+
+  I2CBus* _bus;
+  uint8_t _mux_addr;
+  Device _devices[BME680_ARRAY_MAX];
+  uint8_t _count;
+};
+
+#endif
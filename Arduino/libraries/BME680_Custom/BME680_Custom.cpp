@@ -4,8 +4,18 @@
  */
 
 #include "BME680_Custom.h"
+#include <HotPathMetrics.h>
+#include <time.h>
 
-// Lookup tables for gas resistance calculation
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Preferences.h>
+#endif
+
+// Unix time before which the system clock is considered not set (2020-09-13)
+#define CLOCK_VALID_EPOCH 1600000000UL
+
+// Lookup tables for gas resistance calculation (low-gas variant only; not
+// linked into builds that only use BME680<BME680_VARIANT_GAS_HIGH>)
 const uint32_t lookupTable1[16] = {
   2147483647, 2147483647, 2147483647, 2147483647,
   2147483647, 2126008810, 2147483647, 2130303777, 2147483647,
@@ -20,14 +30,122 @@ const uint32_t lookupTable2[16] = {
   1000000, 500000, 250000, 125000
 };
 
-BME680_Custom::BME680_Custom(uint8_t i2c_addr) {
+// Coefficient offsets in the 41 bytes read from COEFF_ADDR1 and
+// COEFF_ADDR2 back to back (Bosch BME680 SensorAPI layout)
+#define COEFF_T2_LSB   1
+#define COEFF_T2_MSB   2
+#define COEFF_T3       3
+#define COEFF_P1_LSB   5
+#define COEFF_P1_MSB   6
+#define COEFF_P2_LSB   7
+#define COEFF_P2_MSB   8
+#define COEFF_P3       9
+#define COEFF_P4_LSB   11
+#define COEFF_P4_MSB   12
+#define COEFF_P5_LSB   13
+#define COEFF_P5_MSB   14
+#define COEFF_P7       15
+#define COEFF_P6       16
+#define COEFF_P8_LSB   19
+#define COEFF_P8_MSB   20
+#define COEFF_P9_LSB   21
+#define COEFF_P9_MSB   22
+#define COEFF_P10      23
+#define COEFF_H2_MSB   25
+#define COEFF_H2_LSB   26   // Low nibble is H1's
+#define COEFF_H1_LSB   26
+#define COEFF_H1_MSB   27
+#define COEFF_H3       28
+#define COEFF_H4       29
+#define COEFF_H5       30
+#define COEFF_H6       31
+#define COEFF_H7       32
+#define COEFF_T1_LSB   33
+#define COEFF_T1_MSB   34
+#define COEFF_GH2_LSB  35
+#define COEFF_GH2_MSB  36
+#define COEFF_GH1      37
+#define COEFF_GH3      38
+
+// Ambient temperature assumed for the heater set-point until the first reading
+#define DEFAULT_AMBIENT_TEMP 25  // degC
+
+// Frames per block in compensate_batch() (about 600 bytes of stack)
+#define BME680_BATCH_BLOCK 16
+
+// Measurement cycles per oversampling setting (OS_NONE..OS_16X)
+static const uint8_t osToMeasCycles[6] = {0, 1, 2, 4, 8, 16};
+
+// Timed sites (see HotPathMetrics.h); I2C transactions are timed in I2CBus
+METRIC_SITE(metric_bme680_read, "bme680_read");    // Blocking read, conversion included
+METRIC_SITE(metric_bme680_fetch, "bme680_fetch");  // Field read and compensation
+METRIC_SITE(metric_iaq, "iaq_score");
+
+BME680_Custom::BME680_Custom(uint8_t i2c_addr, I2CBus& bus) {
   _i2c_addr = i2c_addr;
+  _nvs_channel = BME680_NVS_NO_CHANNEL;
+  _bus = &bus;
   _variant = 0;
+  _cal_valid = false;
   _offset_temp_in_t_fine = 0;
-  _ambient_temperature = 0;
+  _ambient_temperature = DEFAULT_AMBIENT_TEMP;
   _gas_baseline = 0.0;
   _hum_baseline = 0.0;
+  _gas_baseline_fixed = 0;
+  _hum_baseline_fixed = 0;
   _baseline_established = false;
+  _calibrating = false;
+  _baseline_verbose = false;
+  _burn_in_start = 0;
+  _burn_in_ms = 0;
+  _baseline_reset();
+  
+  // Settings match the register reset values
+  _os_h = OS_NONE;
+  _os_p = OS_NONE;
+  _os_t = OS_NONE;
+  _run_gas = 0;
+  _filter = FILTER_SIZE_0;
+  _heater_profile = 0;
+  for (uint8_t i = 0; i < NUM_HEATER_PROFILES; i++) {
+    _heater_temp[i] = 0;
+    _heater_duration[i] = 0;
+  }
+  
+  // Register shadow starts at the reset values
+  for (uint8_t i = 0; i < CTRL_REGS_LEN; i++) {
+    _ctrl_regs[i] = 0;
+  }
+  for (uint8_t i = 0; i < NUM_HEATER_PROFILES; i++) {
+    _res_heat[i] = 0;
+    _gas_wait[i] = 0;
+  }
+  _ctrl_dirty = 0;
+  _res_heat_dirty = 0;
+  _gas_wait_dirty = 0;
+  
+  _meas_state = MEAS_IDLE;
+  _meas_start = 0;
+  _meas_duration = 0;
+  
+  _sweep_steps = 0;
+  _sweep_step = 0;
+  _sweep_saved_profile = 0;
+  _sweep_active = false;
+  _tph_skipped = false;
+  _sweep_start = 0;
+  memset(&sweep, 0, sizeof(sweep));
+  
+  _cont_active = false;
+  _cont_primed = false;
+  _cont_decimation = BME680_CONT_DECIMATION;
+  _cont_iir_shift = 0;
+  _cont_count = 0;
+  _cont_sum_t = 0;
+  _cont_sum_p = 0;
+  _cont_sum_h = 0;
+  _cont_window_start = 0;
+  memset(&continuous, 0, sizeof(continuous));
   
   // Initialize data structure
   data.temperature = 0.0;
@@ -36,26 +154,54 @@ BME680_Custom::BME680_Custom(uint8_t i2c_addr) {
   data.gas_resistance = 0.0;
   data.heat_stable = false;
   data.gas_valid = false;
+  
+  data_fixed.pressure = 0;
+  data_fixed.humidity = 0;
+  data_fixed.gas_resistance = 0;
+  data_fixed.temperature = 0;
+  data_fixed.heat_stable = false;
+  data_fixed.gas_valid = false;
 }
 
 bool BME680_Custom::begin() {
+  return _begin<BME680_VARIANT_ANY>();
+}
+
+template <uint8_t Variant>
+bool BME680_Custom::_begin() {
   // Check chip ID
   uint8_t chip_id = _read_byte(CHIP_ID_ADDR);
   if (chip_id != BME680_CHIP_ID) {
     return false;
   }
   
-  _variant = _read_byte(CHIP_VARIANT_ADDR);
+  uint8_t variant = _read_byte(CHIP_VARIANT_ADDR);
+  if (Variant != BME680_VARIANT_ANY && variant != Variant) {
+    return false;  // Built for the other variant
+  }
+  
+  // Restored coefficients only apply to the same chip variant
+  if (variant != _variant) {
+    _cal_valid = false;
+  }
+  _variant = variant;
   
   // Soft reset
   _write_byte(SOFT_RESET_ADDR, SOFT_RESET_CMD);
   delay(10);
   
+  // Seed the register shadow with the post-reset control block
+  _read_bytes(CTRL_REGS_ADDR, _ctrl_regs, CTRL_REGS_LEN);
+  _ctrl_regs[CONF_T_P_MODE_ADDR - CTRL_REGS_ADDR] &= ~MODE_MSK;
+  _ctrl_dirty = 0;
+  
   // Set to sleep mode
   set_power_mode(SLEEP_MODE);
   
-  // Get calibration data
-  _get_calibration_data();
+  // Get calibration data (unless restored by restore_state())
+  if (!_cal_valid) {
+    _get_calibration_data();
+  }
   
   // Default settings (matching Python implementation)
   set_humidity_oversample(OS_2X);
@@ -63,55 +209,54 @@ bool BME680_Custom::begin() {
   set_temperature_oversample(OS_8X);
   set_filter(FILTER_SIZE_3);
   
-  if (_variant == 0x01) {
+  if (_variant == BME680_VARIANT_GAS_HIGH) {
     set_gas_status(ENABLE_GAS_MEAS_HIGH);
   } else {
     set_gas_status(ENABLE_GAS_MEAS_LOW);
   }
   
   // Initial read
-  get_sensor_data();
+  _get_sensor_data<Variant>();
   
   return true;
 }
 
 void BME680_Custom::_get_calibration_data() {
-  uint8_t cal1[COEFF_ADDR1_LEN];
-  uint8_t cal2[COEFF_ADDR2_LEN];
+  uint8_t coeff[COEFF_ADDR1_LEN + COEFF_ADDR2_LEN];
   
-  _read_bytes(COEFF_ADDR1, cal1, COEFF_ADDR1_LEN);
-  _read_bytes(COEFF_ADDR2, cal2, COEFF_ADDR2_LEN);
+  _read_bytes(COEFF_ADDR1, coeff, COEFF_ADDR1_LEN);
+  _read_bytes(COEFF_ADDR2, coeff + COEFF_ADDR1_LEN, COEFF_ADDR2_LEN);
   
   // Temperature coefficients
-  _cal.par_t1 = _bytes_to_word(cal1[33], cal1[32]);
-  _cal.par_t2 = _bytes_to_word(cal1[1], cal1[2], true);
-  _cal.par_t3 = _twos_comp(cal1[3]);
+  _cal.par_t1 = _bytes_to_word(coeff[COEFF_T1_MSB], coeff[COEFF_T1_LSB]);
+  _cal.par_t2 = _bytes_to_word(coeff[COEFF_T2_MSB], coeff[COEFF_T2_LSB], true);
+  _cal.par_t3 = _twos_comp(coeff[COEFF_T3]);
   
   // Pressure coefficients
-  _cal.par_p1 = _bytes_to_word(cal1[5], cal1[6]);
-  _cal.par_p2 = _bytes_to_word(cal1[7], cal1[8], true);
-  _cal.par_p3 = _twos_comp(cal1[9]);
-  _cal.par_p4 = _bytes_to_word(cal1[11], cal1[12], true);
-  _cal.par_p5 = _bytes_to_word(cal1[13], cal1[14], true);
-  _cal.par_p6 = _twos_comp(cal1[16]);
-  _cal.par_p7 = _twos_comp(cal1[15]);
-  _cal.par_p8 = _bytes_to_word(cal1[19], cal1[20], true);
-  _cal.par_p9 = _bytes_to_word(cal1[21], cal1[22], true);
-  _cal.par_p10 = cal1[23];
-  
-  // Humidity coefficients
-  _cal.par_h1 = ((cal1[25] << 4) | (cal1[26] & 0x0F));
-  _cal.par_h2 = ((cal1[26] >> 4) | (cal1[27] << 4));
-  _cal.par_h3 = _twos_comp(cal1[28]);
-  _cal.par_h4 = _twos_comp(cal1[29]);
-  _cal.par_h5 = _twos_comp(cal1[30]);
-  _cal.par_h6 = cal1[31];
-  _cal.par_h7 = _twos_comp(cal1[32]);
+  _cal.par_p1 = _bytes_to_word(coeff[COEFF_P1_MSB], coeff[COEFF_P1_LSB]);
+  _cal.par_p2 = _bytes_to_word(coeff[COEFF_P2_MSB], coeff[COEFF_P2_LSB], true);
+  _cal.par_p3 = _twos_comp(coeff[COEFF_P3]);
+  _cal.par_p4 = _bytes_to_word(coeff[COEFF_P4_MSB], coeff[COEFF_P4_LSB], true);
+  _cal.par_p5 = _bytes_to_word(coeff[COEFF_P5_MSB], coeff[COEFF_P5_LSB], true);
+  _cal.par_p6 = _twos_comp(coeff[COEFF_P6]);
+  _cal.par_p7 = _twos_comp(coeff[COEFF_P7]);
+  _cal.par_p8 = _bytes_to_word(coeff[COEFF_P8_MSB], coeff[COEFF_P8_LSB], true);
+  _cal.par_p9 = _bytes_to_word(coeff[COEFF_P9_MSB], coeff[COEFF_P9_LSB], true);
+  _cal.par_p10 = coeff[COEFF_P10];
+  
+  // Humidity coefficients (H1 and H2 are 12 bits, sharing one byte)
+  _cal.par_h1 = ((uint16_t)coeff[COEFF_H1_MSB] << 4) | (coeff[COEFF_H1_LSB] & 0x0F);
+  _cal.par_h2 = ((uint16_t)coeff[COEFF_H2_MSB] << 4) | (coeff[COEFF_H2_LSB] >> 4);
+  _cal.par_h3 = _twos_comp(coeff[COEFF_H3]);
+  _cal.par_h4 = _twos_comp(coeff[COEFF_H4]);
+  _cal.par_h5 = _twos_comp(coeff[COEFF_H5]);
+  _cal.par_h6 = coeff[COEFF_H6];
+  _cal.par_h7 = _twos_comp(coeff[COEFF_H7]);
   
   // Gas coefficients
-  _cal.par_gh1 = _twos_comp(cal2[0]);
-  _cal.par_gh2 = _bytes_to_word(cal2[2], cal2[1], true);
-  _cal.par_gh3 = _twos_comp(cal2[3]);
+  _cal.par_gh1 = _twos_comp(coeff[COEFF_GH1]);
+  _cal.par_gh2 = _bytes_to_word(coeff[COEFF_GH2_MSB], coeff[COEFF_GH2_LSB], true);
+  _cal.par_gh3 = _twos_comp(coeff[COEFF_GH3]);
   
   // Other calibration data
   uint8_t heat_range = _read_byte(ADDR_RES_HEAT_RANGE_ADDR);
@@ -120,73 +265,685 @@ void BME680_Custom::_get_calibration_data() {
   
   _cal.res_heat_range = (heat_range & RHRANGE_MSK) >> 4;
   _cal.res_heat_val = heat_value;
-  _cal.range_sw_err = (sw_error & RSERROR_MSK) >> 4;
+  _cal.range_sw_err = (int8_t)(sw_error & (int8_t)RSERROR_MSK) / 16;  // Signed 4 bits
+  
+  _cal_valid = true;
 }
 
+// State save/restore
+void BME680_Custom::export_state(BME680State& state) {
+  memset(&state, 0, sizeof(state));
+  state.version = BME680_STATE_VERSION;
+  state.variant = _variant;
+  state.i2c_addr = _i2c_addr;
+  state.baseline_established = _baseline_established;
+  state.timestamp = _get_time();
+  state.gas_baseline = _gas_baseline_fixed;
+  state.hum_baseline = _hum_baseline_fixed;
+  state.cal = _cal;
+}
+
+bool BME680_Custom::import_state(const BME680State& state, uint32_t max_age_seconds) {
+  if (state.version != BME680_STATE_VERSION || state.i2c_addr != _i2c_addr) {
+    return false;
+  }
+  
+  _variant = state.variant;
+  _cal = state.cal;
+  _cal_valid = true;
+  
+  if (!state.baseline_established) {
+    return true;
+  }
+  
+  // Reject stale baselines when both timestamps are known
+  uint32_t now = _get_time();
+  if (max_age_seconds > 0 && now != 0 && state.timestamp != 0 &&
+      (now < state.timestamp || (now - state.timestamp) > max_age_seconds)) {
+    return true;
+  }
+  
+  _gas_baseline_fixed = state.gas_baseline;
+  _hum_baseline_fixed = state.hum_baseline;
+#ifndef BME680_FIXED_ONLY
+  _gas_baseline = _gas_baseline_fixed;
+  _hum_baseline = _hum_baseline_fixed / 1000.0f;
+#endif
+  _baseline_established = true;
+  _calibrating = false;
+  
+  return true;
+}
+
+// Deep-sleep retention
+void BME680_Custom::export_sleep_state(BME680SleepState& state) {
+  state.magic = _cal_valid ? BME680_SLEEP_MAGIC : 0;
+  state.variant = _variant;
+  state.i2c_addr = _i2c_addr;
+  state.cal = _cal;
+  state.ambient_temperature = _ambient_temperature;
+  
+  state.os_h = _os_h;
+  state.os_p = _os_p;
+  state.os_t = _os_t;
+  state.run_gas = _run_gas;
+  state.filter = _filter;
+  state.heater_profile = _heater_profile;
+  memcpy(state.heater_temp, _heater_temp, sizeof(_heater_temp));
+  memcpy(state.heater_duration, _heater_duration, sizeof(_heater_duration));
+  memcpy(state.ctrl_regs, _ctrl_regs, sizeof(_ctrl_regs));
+  memcpy(state.res_heat, _res_heat, sizeof(_res_heat));
+  memcpy(state.gas_wait, _gas_wait, sizeof(_gas_wait));
+  
+  state.baseline_established = _baseline_established;
+  state.calibrating = _calibrating;
+  state.gas_baseline = _gas_baseline_fixed;
+  state.hum_baseline = _hum_baseline_fixed;
+  state.burn_in_elapsed = millis() - _burn_in_start;
+  state.burn_in_ms = _burn_in_ms;
+  state.baseline = _baseline;
+}
+
+bool BME680_Custom::resume(const BME680SleepState& state, uint32_t slept_ms) {
+  if (state.magic != BME680_SLEEP_MAGIC || state.i2c_addr != _i2c_addr) {
+    return false;
+  }
+  
+  _variant = state.variant;
+  _cal = state.cal;
+  _cal_valid = true;
+  _ambient_temperature = state.ambient_temperature;
+  
+  _os_h = state.os_h;
+  _os_p = state.os_p;
+  _os_t = state.os_t;
+  _run_gas = state.run_gas;
+  _filter = state.filter;
+  _heater_profile = state.heater_profile;
+  memcpy(_heater_temp, state.heater_temp, sizeof(_heater_temp));
+  memcpy(_heater_duration, state.heater_duration, sizeof(_heater_duration));
+  memcpy(_ctrl_regs, state.ctrl_regs, sizeof(_ctrl_regs));
+  memcpy(_res_heat, state.res_heat, sizeof(_res_heat));
+  memcpy(_gas_wait, state.gas_wait, sizeof(_gas_wait));
+  
+  _baseline_established = state.baseline_established;
+  _calibrating = state.calibrating;
+  _gas_baseline_fixed = state.gas_baseline;
+  _hum_baseline_fixed = state.hum_baseline;
+#ifndef BME680_FIXED_ONLY
+  _gas_baseline = _gas_baseline_fixed;
+  _hum_baseline = _hum_baseline_fixed / 1000.0f;
+#endif
+  _burn_in_ms = state.burn_in_ms;
+  _burn_in_start = millis() - (state.burn_in_elapsed + slept_ms);
+  _baseline = state.baseline;
+  
+  // The sensor keeps its registers while the ESP32 sleeps; if the control
+  // block differs it was power cycled and everything is written again
+  uint8_t regs[CTRL_REGS_LEN];
+  _read_bytes(CTRL_REGS_ADDR, regs, CTRL_REGS_LEN);
+  regs[CONF_T_P_MODE_ADDR - CTRL_REGS_ADDR] &= ~MODE_MSK;
+  
+  if (memcmp(regs, _ctrl_regs, CTRL_REGS_LEN) == 0) {
+    _ctrl_dirty = 0;
+    _res_heat_dirty = 0;
+    _gas_wait_dirty = 0;
+  } else {
+    if (_read_byte(CHIP_ID_ADDR) != BME680_CHIP_ID) {
+      return false;
+    }
+    _ctrl_dirty = (1 << CTRL_REGS_LEN) - 1;
+    _res_heat_dirty = (1 << NUM_HEATER_PROFILES) - 1;
+    _gas_wait_dirty = (1 << NUM_HEATER_PROFILES) - 1;
+  }
+  
+  _meas_state = MEAS_IDLE;
+  return true;
+}
+
+uint32_t BME680_Custom::_get_time() {
+  time_t now = time(nullptr);
+  return ((unsigned long)now >= CLOCK_VALID_EPOCH) ? (uint32_t)now : 0;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void BME680_Custom::_nvs_key(char* key, uint8_t variant) {
+  // NVS keys are limited to 15 characters. Without a mux channel the key
+  // is the same as before channels were added, so saved state still loads.
+  if (_nvs_channel == BME680_NVS_NO_CHANNEL) {
+    snprintf(key, 16, "state_%02x_%02x", variant, _i2c_addr);
+  } else {
+    snprintf(key, 16, "state_%02x_%02x_%u", variant, _i2c_addr, _nvs_channel);
+  }
+}
+
+bool BME680_Custom::save_state() {
+  if (!_cal_valid) {
+    return false;
+  }
+  
+  BME680State state;
+  export_state(state);
+  
+  char key[16];
+  _nvs_key(key, _variant);
+  
+  Preferences prefs;
+  if (!prefs.begin(BME680_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  size_t written = prefs.putBytes(key, &state, sizeof(state));
+  prefs.end();
+  
+  return written == sizeof(state);
+}
+
+bool BME680_Custom::restore_state(uint32_t max_age_seconds) {
+  // Variant is needed for the key; two single-byte reads instead of 41
+  if (_read_byte(CHIP_ID_ADDR) != BME680_CHIP_ID) {
+    return false;
+  }
+  uint8_t variant = _read_byte(CHIP_VARIANT_ADDR);
+  
+  char key[16];
+  _nvs_key(key, variant);
+  
+  Preferences prefs;
+  if (!prefs.begin(BME680_NVS_NAMESPACE, true)) {
+    return false;
+  }
+  BME680State state;
+  size_t read = prefs.getBytes(key, &state, sizeof(state));
+  prefs.end();
+  
+  if (read != sizeof(state) || state.variant != variant) {
+    return false;
+  }
+  
+  return import_state(state, max_age_seconds);
+}
+#endif
+
 bool BME680_Custom::get_sensor_data() {
-  set_power_mode(FORCED_MODE);
+  return _get_sensor_data<BME680_VARIANT_ANY>();
+}
+
+template <uint8_t Variant>
+bool BME680_Custom::_get_sensor_data() {
+  METRIC_SCOPE(metric_bme680_read);
+  
+  if (!start_measurement()) {
+    return false;
+  }
+  
+  delay(_meas_duration);
+  
+  uint8_t state;
+  while ((state = poll()) == MEAS_PENDING) {
+    delay(1);
+  }
+  
+  if (state != MEAS_READY) {
+    return false;
+  }
+  
+  return _fetch<Variant>();
+}
+
+bool BME680_Custom::start_measurement() {
+  if (_meas_state == MEAS_PENDING) {
+    return false;
+  }
+  
+  // Write pending configuration and trigger a forced conversion in one
+  // transaction, without the settling delay in set_power_mode()
+  _flush_config(true);
   
-  for (uint8_t attempt = 0; attempt < 10; attempt++) {
-    uint8_t status = _read_byte(FIELD0_ADDR);
+  _meas_duration = get_measurement_duration();
+  _meas_start = millis();
+  _meas_state = MEAS_PENDING;
+  
+  return true;
+}
+
+uint8_t BME680_Custom::poll() {
+  if (_meas_state != MEAS_PENDING) {
+    uint8_t state = _meas_state;
     
-    if ((status & NEW_DATA_MSK) == 0) {
-      delay(10);
-      continue;
+    // Errors are reported once
+    if (state == MEAS_ERROR) {
+      _meas_state = MEAS_IDLE;
     }
-    
-    uint8_t regs[FIELD_LENGTH];
+    return state;
+  }
+  
+  unsigned long elapsed = millis() - _meas_start;
+  
+  // No bus traffic until the conversion can have finished
+  if (elapsed < _meas_duration) {
+    return MEAS_PENDING;
+  }
+  
+  uint8_t status = _read_byte(FIELD0_ADDR);
+  if (status & NEW_DATA_MSK) {
+    _meas_state = MEAS_READY;
+  } else if (elapsed > (unsigned long)_meas_duration + MEAS_TIMEOUT_MS) {
+    _meas_state = MEAS_IDLE;
+    return MEAS_ERROR;
+  }
+  
+  return _meas_state;
+}
+
+bool BME680_Custom::fetch() {
+  return _fetch<BME680_VARIANT_ANY>();
+}
+
+template <uint8_t Variant>
+bool BME680_Custom::_fetch() {
+  if (_meas_state != MEAS_READY) {
+    return false;
+  }
+  METRIC_SCOPE(metric_bme680_fetch);
+  
+  uint8_t regs[FIELD_LENGTH];
+  _read_bytes(FIELD0_ADDR, regs, FIELD_LENGTH);
+  _parse_field_data<Variant>(regs);
+  
+  if (_calibrating && data_fixed.heat_stable) {
+    _baseline_push(data_fixed.gas_resistance, data_fixed.humidity);
+  }
+  
+  _meas_state = MEAS_IDLE;
+  return true;
+}
+
+uint16_t BME680_Custom::get_measurement_duration() {
+  uint32_t duration = _tph_duration(_tph_skipped);
+  
+  if (_run_gas) {
+    duration += _heater_duration[_heater_profile];
+  }
+  
+  return (uint16_t)duration;
+}
+
+uint16_t BME680_Custom::_tph_duration(bool skip_tph) {
+  // Bosch formula: 1963 us per measurement cycle, 477 us per TPH switch
+  // plus gas measurement, rounded up to ms and one ms for wake up
+  uint32_t meas_cycles = skip_tph ? 0 : osToMeasCycles[_os_t] + osToMeasCycles[_os_p] + osToMeasCycles[_os_h];
+  uint32_t tph_dur = meas_cycles * 1963UL;
+  tph_dur += 477UL * 4;
+  tph_dur += 477UL * 5;
+  tph_dur += 500;
+  tph_dur /= 1000;
+  tph_dur += 1;
+  
+  return (uint16_t)tph_dur;
+}
+
+uint16_t BME680_Custom::get_time_until_ready() {
+  if (_meas_state != MEAS_PENDING) {
+    return 0;
+  }
+  
+  unsigned long elapsed = millis() - _meas_start;
+  if (elapsed >= _meas_duration) {
+    return 0;
+  }
+  
+  return _meas_duration - elapsed;
+}
+
+// ============================================================================
+// HEATER-PROFILE SWEEP
+// ============================================================================
+
+bool BME680_Custom::set_heater_sweep(const uint16_t* temperatures, const uint16_t* durations, uint8_t count) {
+  if (_sweep_active || count == 0) {
+    return false;
+  }
+  if (count > NUM_HEATER_PROFILES) count = NUM_HEATER_PROFILES;
+  
+  // All set-points go out in one burst; each step then only rewrites
+  // the profile index and the mode register
+  set_heater_profiles(temperatures, durations, count);
+  _sweep_steps = count;
+  return true;
+}
+
+bool BME680_Custom::start_sweep() {
+  // Needs gas measurements enabled (set_gas_status(), default after begin())
+  if (_sweep_active || _sweep_steps == 0 || !_run_gas || _meas_state == MEAS_PENDING) {
+    return false;
+  }
+  
+  sweep.steps = _sweep_steps;
+  sweep.heat_stable_mask = 0;
+  sweep.gas_valid_mask = 0;
+  sweep.duration_ms = 0;
+  for (uint8_t i = 0; i < _sweep_steps; i++) {
+    sweep.heater_temp[i] = _heater_temp[i];
+    sweep.gas_resistance[i] = 0;
+  }
+  
+  _sweep_saved_profile = _heater_profile;
+  _sweep_step = 0;
+  _sweep_active = true;
+  _sweep_start = millis();
+  
+  select_gas_heater_profile(0);
+  if (!start_measurement()) {
+    _end_sweep();
+    return false;
+  }
+  return true;
+}
+
+uint8_t BME680_Custom::poll_sweep() {
+  if (!_sweep_active) {
+    return MEAS_IDLE;
+  }
+  
+  uint8_t state = poll();
+  if (state == MEAS_PENDING) {
+    return MEAS_PENDING;
+  }
+  if (state != MEAS_READY) {
+    _end_sweep();
+    return MEAS_ERROR;
+  }
+  
+  uint8_t step = _sweep_step;
+  uint8_t regs[FIELD_LENGTH];
+  uint32_t gas_resistance;
+  bool heat_stable;
+  bool gas_valid;
+  
+  if (step == 0) {
+    // Full reading; temperature also feeds the heater compensation
     _read_bytes(FIELD0_ADDR, regs, FIELD_LENGTH);
-    
-    // Extract ADC values
-    uint32_t adc_pres = ((uint32_t)regs[2] << 12) | ((uint32_t)regs[3] << 4) | (regs[4] >> 4);
-    uint32_t adc_temp = ((uint32_t)regs[5] << 12) | ((uint32_t)regs[6] << 4) | (regs[7] >> 4);
-    uint16_t adc_hum = ((uint16_t)regs[8] << 8) | regs[9];
-    uint16_t adc_gas_res_low = ((uint16_t)regs[13] << 2) | (regs[14] >> 6);
-    uint16_t adc_gas_res_high = ((uint16_t)regs[15] << 2) | (regs[16] >> 6);
-    uint8_t gas_range_l = regs[14] & GAS_RANGE_MSK;
-    uint8_t gas_range_h = regs[16] & GAS_RANGE_MSK;
-    
-    // Check heat stable and gas valid
-    if (_variant == 0x01) {
-      data.heat_stable = (regs[16] & HEAT_STAB_MSK) > 0;
-      data.gas_valid = (regs[16] & GASM_VALID_MSK) > 0;
+    _parse_field_data(regs);
+    gas_resistance = data_fixed.gas_resistance;
+    heat_stable = data_fixed.heat_stable;
+    gas_valid = data_fixed.gas_valid;
+  } else {
+    // Gas registers only
+    _read_bytes(FIELD0_ADDR + 13, &regs[13], FIELD_LENGTH - 13);
+    _parse_gas(regs, gas_resistance, heat_stable, gas_valid);
+  }
+  _meas_state = MEAS_IDLE;
+  
+  sweep.gas_resistance[step] = gas_resistance;
+  if (heat_stable) sweep.heat_stable_mask |= (1 << step);
+  if (gas_valid) sweep.gas_valid_mask |= (1 << step);
+  
+  if (++_sweep_step < _sweep_steps) {
+    // Next set-point straight away, without re-measuring T/P/H
+    if (step == 0) {
+      _skip_tph(true);
+    }
+    select_gas_heater_profile(_sweep_step);
+    if (!start_measurement()) {
+      _end_sweep();
+      return MEAS_ERROR;
+    }
+    return MEAS_PENDING;
+  }
+  
+  sweep.duration_ms = millis() - _sweep_start;
+  _end_sweep();
+  return MEAS_READY;
+}
+
+bool BME680_Custom::get_sweep_data() {
+  if (!start_sweep()) {
+    return false;
+  }
+  
+  uint8_t state;
+  while ((state = poll_sweep()) == MEAS_PENDING) {
+    uint16_t wait = get_time_until_ready();
+    delay(wait ? wait : 1);
+  }
+  
+  return state == MEAS_READY;
+}
+
+uint16_t BME680_Custom::get_sweep_duration() {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < _sweep_steps; i++) {
+    total += _tph_duration(i > 0) + _heater_duration[i];
+  }
+  return (uint16_t)min(total, (uint32_t)0xFFFF);
+}
+
+bool BME680_Custom::is_sweeping() {
+  return _sweep_active;
+}
+
+// ============================================================================
+// CONTINUOUS T/P/H MODE
+// ============================================================================
+
+bool BME680_Custom::start_continuous(uint8_t decimation, uint8_t iir_shift) {
+  if (_cont_active || _sweep_active || _meas_state == MEAS_PENDING || decimation == 0) {
+    return false;
+  }
+  
+  get_config(_cont_saved);
+  set_humidity_oversample(OS_1X);
+  set_pressure_oversample(OS_1X);
+  set_temperature_oversample(OS_1X);
+  set_filter(FILTER_SIZE_0);
+  set_gas_status(0);
+  
+  _cont_decimation = decimation;
+  _cont_iir_shift = min(iir_shift, (uint8_t)15);
+  _cont_count = 0;
+  _cont_sum_t = 0;
+  _cont_sum_p = 0;
+  _cont_sum_h = 0;
+  _cont_primed = false;
+  memset(&continuous, 0, sizeof(continuous));
+  
+  // Settings and the first trigger in one transaction
+  if (!start_measurement()) {
+    apply(_cont_saved);
+    return false;
+  }
+  _cont_window_start = _meas_start;
+  _cont_active = true;
+  return true;
+}
+
+uint8_t BME680_Custom::poll_continuous() {
+  if (!_cont_active) {
+    return MEAS_IDLE;
+  }
+  
+  unsigned long now = millis();
+  unsigned long elapsed = now - _meas_start;
+  if (elapsed < _meas_duration) {
+    return MEAS_PENDING;
+  }
+  
+  // Status byte and T/P/H ADCs in one read, no separate status poll
+  uint8_t regs[10];
+  _read_bytes(FIELD0_ADDR, regs, sizeof(regs));
+  
+  if (!(regs[0] & NEW_DATA_MSK)) {
+    if (elapsed > (unsigned long)_meas_duration + MEAS_TIMEOUT_MS) {
+      continuous.lost++;
+      _trigger_forced();
+    }
+    return MEAS_PENDING;
+  }
+  
+  // Next conversion runs while this one is compensated
+  _trigger_forced();
+  
+  uint32_t adc_pres = ((uint32_t)regs[2] << 12) | ((uint32_t)regs[3] << 4) | (regs[4] >> 4);
+  uint32_t adc_temp = ((uint32_t)regs[5] << 12) | ((uint32_t)regs[6] << 4) | (regs[7] >> 4);
+  uint16_t adc_hum = ((uint16_t)regs[8] << 8) | regs[9];
+  
+  // Temperature first: it sets t_fine for the other two
+  int32_t temp = _calc_temperature(adc_temp);
+  _ambient_temperature = temp / 100;
+  _cont_sum_t += temp;
+  _cont_sum_p += _calc_pressure(adc_pres);
+  _cont_sum_h += _calc_humidity(adc_hum);
+  
+  if (++_cont_count < _cont_decimation) {
+    return MEAS_PENDING;
+  }
+  
+  _cont_output();
+  return MEAS_READY;
+}
+
+void BME680_Custom::stop_continuous() {
+  if (!_cont_active) {
+    return;
+  }
+  
+  _cont_active = false;
+  _meas_state = MEAS_IDLE;
+  
+  // The conversion in flight finishes on its own and the chip drops back
+  // to sleep mode; the restored settings go out now
+  apply(_cont_saved);
+}
+
+void BME680_Custom::_trigger_forced() {
+  if (_ctrl_dirty || _res_heat_dirty || _gas_wait_dirty) {
+    // Settings changed since the last trigger: they go out with it
+    _flush_config(true);
+    _meas_duration = get_measurement_duration();
+  } else {
+    // Only the mode register: the rest of the control block is unchanged
+    uint8_t mode_idx = CONF_T_P_MODE_ADDR - CTRL_REGS_ADDR;
+    _write_byte(CONF_T_P_MODE_ADDR, _ctrl_regs[mode_idx] | FORCED_MODE);
+  }
+  _meas_start = millis();
+}
+
+void BME680_Custom::_cont_output() {
+  uint8_t n = _cont_count;
+  int32_t avg[3] = {
+    (_cont_sum_t + (_cont_sum_t >= 0 ? n / 2 : -(int32_t)(n / 2))) / n,
+    (int32_t)((_cont_sum_p + n / 2) / n),
+    (int32_t)((_cont_sum_h + n / 2) / n)
+  };
+  
+  for (uint8_t i = 0; i < 3; i++) {
+    int32_t x = avg[i] * (1L << BME680_CONT_IIR_FRAC);
+    if (!_cont_primed || _cont_iir_shift == 0) {
+      _cont_iir[i] = x;
     } else {
-      data.heat_stable = (regs[14] & HEAT_STAB_MSK) > 0;
-      data.gas_valid = (regs[14] & GASM_VALID_MSK) > 0;
+      _cont_iir[i] += (x - _cont_iir[i]) >> _cont_iir_shift;
     }
-    
-    // Calculate values
-    int32_t temp = _calc_temperature(adc_temp);
-    data.temperature = temp / 100.0;
-    _ambient_temperature = temp;
-    
-    data.pressure = _calc_pressure(adc_pres) / 100.0;
-    data.humidity = _calc_humidity(adc_hum) / 1000.0;
-    
-    if (_variant == 0x01) {
-      data.gas_resistance = _calc_gas_resistance(adc_gas_res_high, gas_range_h);
+  }
+  _cont_primed = true;
+  
+  int32_t half = 1L << (BME680_CONT_IIR_FRAC - 1);
+  continuous.temperature = (int16_t)((_cont_iir[0] + half) >> BME680_CONT_IIR_FRAC);
+  continuous.pressure = (uint32_t)((_cont_iir[1] + half) >> BME680_CONT_IIR_FRAC);
+  continuous.humidity = (uint32_t)((_cont_iir[2] + half) >> BME680_CONT_IIR_FRAC);
+  continuous.samples = n;
+  
+  // Rate over this output's window
+  unsigned long now = millis();
+  unsigned long window = now - _cont_window_start;
+  continuous.rate = window ? (uint16_t)min((uint32_t)(n * 100000UL / window), (uint32_t)0xFFFF) : 0;
+  _cont_window_start = now;
+  
+  _cont_count = 0;
+  _cont_sum_t = 0;
+  _cont_sum_p = 0;
+  _cont_sum_h = 0;
+}
+
+void BME680_Custom::_skip_tph(bool skip) {
+  // Only the register shadow changes; _os_* keep the configured values
+  _set_bits(CONF_OS_H_ADDR, OSH_MSK, OSH_POS, skip ? OS_NONE : _os_h);
+  _set_bits(CONF_T_P_MODE_ADDR, OSP_MSK, OSP_POS, skip ? OS_NONE : _os_p);
+  _set_bits(CONF_T_P_MODE_ADDR, OST_MSK, OST_POS, skip ? OS_NONE : _os_t);
+  _tph_skipped = skip;
+}
+
+void BME680_Custom::_end_sweep() {
+  // Restored registers go out with the next measurement
+  if (_tph_skipped) {
+    _skip_tph(false);
+  }
+  select_gas_heater_profile(_sweep_saved_profile);
+  _sweep_active = false;
+}
+
+template <uint8_t Variant>
+void BME680_Custom::_parse_field_data(const uint8_t* regs) {
+  // Extract ADC values
+  uint32_t adc_pres = ((uint32_t)regs[2] << 12) | ((uint32_t)regs[3] << 4) | (regs[4] >> 4);
+  uint32_t adc_temp = ((uint32_t)regs[5] << 12) | ((uint32_t)regs[6] << 4) | (regs[7] >> 4);
+  uint16_t adc_hum = ((uint16_t)regs[8] << 8) | regs[9];
+  
+  // Calculate values
+  int32_t temp = _calc_temperature(adc_temp);
+  data_fixed.temperature = (int16_t)temp;
+  _ambient_temperature = temp / 100;
+  
+  data_fixed.pressure = _calc_pressure(adc_pres);
+  data_fixed.humidity = _calc_humidity(adc_hum);
+  
+  _parse_gas<Variant>(regs, data_fixed.gas_resistance, data_fixed.heat_stable, data_fixed.gas_valid);
+  
+#ifndef BME680_FIXED_ONLY
+  data.temperature = data_fixed.temperature / 100.0f;
+  data.pressure = data_fixed.pressure / 100.0f;
+  data.humidity = data_fixed.humidity / 1000.0f;
+  data.gas_resistance = data_fixed.gas_resistance;
+  data.heat_stable = data_fixed.heat_stable;
+  data.gas_valid = data_fixed.gas_valid;
+#endif
+}
+
+// regs is the field block from FIELD0_ADDR; only bytes 13-16 are used
+template <uint8_t Variant>
+void BME680_Custom::_parse_gas(const uint8_t* regs, uint32_t& gas_resistance, bool& heat_stable, bool& gas_valid) {
+  if constexpr (Variant == BME680_VARIANT_ANY) {
+    if (_variant == BME680_VARIANT_GAS_HIGH) {
+      _parse_gas<BME680_VARIANT_GAS_HIGH>(regs, gas_resistance, heat_stable, gas_valid);
     } else {
-      data.gas_resistance = _calc_gas_resistance(adc_gas_res_low, gas_range_l);
+      _parse_gas<BME680_VARIANT_GAS_LOW>(regs, gas_resistance, heat_stable, gas_valid);
     }
-    
-    return true;
+    return;
   }
   
-  return false;
+  // The low-gas variant reports in 0x2A/0x2B, the high-gas variant in 0x2C/0x2D
+  const uint8_t* gas = (Variant == BME680_VARIANT_GAS_HIGH) ? &regs[15] : &regs[13];
+  uint16_t adc_gas_res = ((uint16_t)gas[0] << 2) | (gas[1] >> 6);
+  uint8_t gas_range = gas[1] & GAS_RANGE_MSK;
+  
+  heat_stable = (gas[1] & HEAT_STAB_MSK) > 0;
+  gas_valid = (gas[1] & GASM_VALID_MSK) > 0;
+  gas_resistance = _calc_gas_resistance<Variant>(adc_gas_res, gas_range);
 }
 
 int32_t BME680_Custom::_calc_temperature(uint32_t temp_adc) {
-  int32_t var1 = (temp_adc >> 3) - ((int32_t)_cal.par_t1 << 1);
-  int32_t var2 = (var1 * (int32_t)_cal.par_t2) >> 11;
-  int32_t var3 = ((((var1 >> 1) * (var1 >> 1)) >> 12) * ((int32_t)_cal.par_t3 << 4)) >> 14;
+  // 64-bit like the SensorAPI: var1 * par_t2 and var1^2 reach 2^32
+  int64_t var1 = (int64_t)(temp_adc >> 3) - ((int32_t)_cal.par_t1 << 1);
+  int64_t var2 = (var1 * (int32_t)_cal.par_t2) >> 11;
+  int64_t var3 = ((((var1 >> 1) * (var1 >> 1)) >> 12) * ((int32_t)_cal.par_t3 << 4)) >> 14;
   
-  _cal.t_fine = var2 + var3 + _offset_temp_in_t_fine;
+  _cal.t_fine = (int32_t)(var2 + var3) + _offset_temp_in_t_fine;
   int32_t calc_temp = (((_cal.t_fine * 5) + 128) >> 8);
   
   return calc_temp;
 }
 
 uint32_t BME680_Custom::_calc_pressure(uint32_t pres_adc) {
+  // Bosch integer path: 32-bit, with the divide ordered to stay in range
   int32_t var1 = ((int32_t)_cal.t_fine >> 1) - 64000;
   int32_t var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)_cal.par_p6) >> 2;
   var2 = var2 + ((var1 * (int32_t)_cal.par_p5) << 1);
@@ -197,20 +954,27 @@ uint32_t BME680_Custom::_calc_pressure(uint32_t pres_adc) {
   var1 = var1 >> 18;
   
   var1 = ((32768 + var1) * (int32_t)_cal.par_p1) >> 15;
-  int64_t calc_pres = 1048576 - pres_adc;
-  calc_pres = ((calc_pres - (var2 >> 12)) * 3125);
+  if (var1 == 0) {
+    return 0;  // Blank coefficients
+  }
+  
+  int32_t calc_pres = 1048576 - pres_adc;
+  calc_pres = (int32_t)((uint32_t)(calc_pres - (var2 >> 12)) * 3125U);
   
-  if (calc_pres >= ((int64_t)1 << 31)) {
-    calc_pres = ((calc_pres / var1) << 1);
+  if (calc_pres >= 0x40000000) {
+    calc_pres = (calc_pres / var1) << 1;
   } else {
-    calc_pres = ((calc_pres << 1) / var1);
+    calc_pres = (calc_pres << 1) / var1;
   }
   
   var1 = ((int32_t)_cal.par_p9 * (((calc_pres >> 3) * (calc_pres >> 3)) >> 13)) >> 12;
-  int32_t var2 = ((calc_pres >> 2) * (int32_t)_cal.par_p8) >> 13;
-  int64_t var3 = ((calc_pres >> 8) * (calc_pres >> 8) * (calc_pres >> 8) * (int64_t)_cal.par_p10) >> 17;
+  var2 = ((calc_pres >> 2) * (int32_t)_cal.par_p8) >> 13;
   
-  calc_pres = (calc_pres) + ((var1 + var2 + var3 + ((int32_t)_cal.par_p7 << 7)) >> 4);
+  // (p >> 8)^3 * p10 is near the top of the int32 range, so 64-bit here
+  int32_t p8 = calc_pres >> 8;
+  int32_t var3 = (int32_t)(((int64_t)p8 * p8 * p8 * (int32_t)_cal.par_p10) >> 17);
+  
+  calc_pres = calc_pres + ((var1 + var2 + var3 + ((int32_t)_cal.par_p7 << 7)) >> 4);
   
   return (uint32_t)calc_pres;
 }
@@ -236,8 +1000,14 @@ uint32_t BME680_Custom::_calc_humidity(uint16_t hum_adc) {
   return (uint32_t)calc_hum;
 }
 
+template <uint8_t Variant>
 uint32_t BME680_Custom::_calc_gas_resistance(uint16_t gas_res_adc, uint8_t gas_range) {
-  if (_variant == 0x01) {
+  if constexpr (Variant == BME680_VARIANT_ANY) {
+    if (_variant == BME680_VARIANT_GAS_HIGH) {
+      return _calc_gas_resistance<BME680_VARIANT_GAS_HIGH>(gas_res_adc, gas_range);
+    }
+    return _calc_gas_resistance<BME680_VARIANT_GAS_LOW>(gas_res_adc, gas_range);
+  } else if constexpr (Variant == BME680_VARIANT_GAS_HIGH) {
     // High variant
     uint32_t var1 = 262144 >> gas_range;
     int32_t var2 = gas_res_adc - 512;
@@ -247,28 +1017,186 @@ uint32_t BME680_Custom::_calc_gas_resistance(uint16_t gas_res_adc, uint8_t gas_r
     calc_gas_res *= 100;
     return (uint32_t)calc_gas_res;
   } else {
-    // Low variant
-    int32_t var1 = ((1340 + (5 * (int32_t)_cal.range_sw_err)) * (int32_t)lookupTable1[gas_range]) >> 16;
-    int32_t var2 = (((gas_res_adc << 15) - 16777216) + var1);
-    int32_t var3 = ((lookupTable2[gas_range] * var1) >> 9);
-    int64_t calc_gas_res = ((var3 + (var2 >> 1)) / var2);
+    // Low variant (the table products need 64 bits)
+    int64_t var1 = ((1340 + (5 * (int64_t)_cal.range_sw_err)) * (int64_t)lookupTable1[gas_range]) >> 16;
+    int64_t var2 = (((int64_t)gas_res_adc << 15) - 16777216) + var1;
+    int64_t var3 = ((int64_t)lookupTable2[gas_range] * var1) >> 9;
     
-    if (calc_gas_res < 0) {
-      calc_gas_res = ((int64_t)1 << 32) + calc_gas_res;
+    return (uint32_t)((var3 + (var2 >> 1)) / var2);
+  }
+}
+
+// Batch compensation
+void BME680_Custom::compensate_batch(const uint8_t* frames, size_t n, SensorDataFixed* out) {
+  _compensate<BME680_VARIANT_ANY>(frames, n, out);
+}
+
+void BME680_Custom::compensate_batch(const CalibrationData& cal, uint8_t variant,
+                                     const uint8_t* frames, size_t n, SensorDataFixed* out) {
+  _compensate_batch<BME680_VARIANT_ANY>(cal, variant, 0, frames, n, out);
+}
+
+template <uint8_t Variant>
+void BME680_Custom::_compensate(const uint8_t* frames, size_t n, SensorDataFixed* out) {
+  _compensate_batch<Variant>(_cal, _variant, _offset_temp_in_t_fine, frames, n, out);
+}
+
+template <uint8_t Variant>
+void BME680_Custom::_compensate_batch(const CalibrationData& cal, uint8_t variant, int32_t t_fine_offset,
+                                      const uint8_t* frames, size_t n, SensorDataFixed* out) {
+  if constexpr (Variant == BME680_VARIANT_ANY) {
+    if (variant == BME680_VARIANT_GAS_HIGH) {
+      _compensate_batch<BME680_VARIANT_GAS_HIGH>(cal, variant, t_fine_offset, frames, n, out);
+    } else {
+      _compensate_batch<BME680_VARIANT_GAS_LOW>(cal, variant, t_fine_offset, frames, n, out);
+    }
+    return;
+  }
+  
+  // Same integer formulas as _calc_*(), with the per-calibration terms
+  // computed once. Frames are unpacked a block at a time into one array
+  // per channel, and each channel is one loop with no calls and no
+  // variant checks, which the compiler keeps in registers (and vectorizes
+  // on hosts with SIMD; pressure divides by a per-frame value and stays
+  // scalar).
+  const int32_t t1 = (int32_t)cal.par_t1 << 1;
+  const int32_t t2 = cal.par_t2;
+  const int32_t t3 = (int32_t)cal.par_t3 << 4;
+  
+  const int32_t p1 = cal.par_p1;
+  const int32_t p2 = cal.par_p2;
+  const int32_t p3 = (int32_t)cal.par_p3 << 5;
+  const int32_t p4 = (int32_t)cal.par_p4 << 16;
+  const int32_t p5 = cal.par_p5;
+  const int32_t p6 = cal.par_p6;
+  const int32_t p7 = (int32_t)cal.par_p7 << 7;
+  const int32_t p8 = cal.par_p8;
+  const int32_t p9 = cal.par_p9;
+  const int32_t p10 = cal.par_p10;
+  
+  const int32_t h1 = (int32_t)cal.par_h1 * 16;
+  const int32_t h2 = cal.par_h2;
+  const int32_t h3 = cal.par_h3;
+  const int32_t h4 = cal.par_h4;
+  const int32_t h5 = cal.par_h5;
+  const int32_t h6 = (int32_t)cal.par_h6 << 7;
+  const int32_t h7 = cal.par_h7;
+  
+  // Gas: everything but the ADC term depends only on the range
+  constexpr bool high = (Variant == BME680_VARIANT_GAS_HIGH);
+  constexpr uint8_t gas_offset = high ? 15 : 13;
+  int64_t gas_var1[16];
+  int64_t gas_var3[16];
+  for (uint8_t r = 0; r < 16; r++) {
+    if constexpr (high) {
+      gas_var1[r] = 0;
+      gas_var3[r] = (int64_t)10000 * (262144 >> r);
+    } else {
+      gas_var1[r] = ((1340 + (5 * (int64_t)cal.range_sw_err)) * (int64_t)lookupTable1[r]) >> 16;
+      gas_var3[r] = ((int64_t)lookupTable2[r] * gas_var1[r]) >> 9;
+    }
+  }
+  
+  int32_t adc_t[BME680_BATCH_BLOCK];
+  int32_t adc_p[BME680_BATCH_BLOCK];
+  int32_t adc_h[BME680_BATCH_BLOCK];
+  int32_t adc_g[BME680_BATCH_BLOCK];
+  uint8_t gas_lsb[BME680_BATCH_BLOCK];
+  int32_t t_fine[BME680_BATCH_BLOCK];
+  
+  for (size_t base = 0; base < n; base += BME680_BATCH_BLOCK) {
+    uint8_t m = (n - base < BME680_BATCH_BLOCK) ? (uint8_t)(n - base) : BME680_BATCH_BLOCK;
+    const uint8_t* f = frames + base * FIELD_LENGTH;
+    SensorDataFixed* o = out + base;
+  
+    for (uint8_t i = 0; i < m; i++, f += FIELD_LENGTH) {
+      adc_p[i] = ((uint32_t)f[2] << 12) | ((uint32_t)f[3] << 4) | (f[4] >> 4);
+      adc_t[i] = ((uint32_t)f[5] << 12) | ((uint32_t)f[6] << 4) | (f[7] >> 4);
+      adc_h[i] = ((uint16_t)f[8] << 8) | f[9];
+      adc_g[i] = ((uint16_t)f[gas_offset] << 2) | (f[gas_offset + 1] >> 6);
+      gas_lsb[i] = f[gas_offset + 1];
+    }
+  
+    // Temperature (t_fine feeds the other two)
+    for (uint8_t i = 0; i < m; i++) {
+      int64_t var1 = (int64_t)(adc_t[i] >> 3) - t1;
+      int64_t var2 = (var1 * t2) >> 11;
+      int64_t var3 = ((((var1 >> 1) * (var1 >> 1)) >> 12) * t3) >> 14;
+      t_fine[i] = (int32_t)(var2 + var3) + t_fine_offset;
+      o[i].temperature = (int16_t)(((t_fine[i] * 5) + 128) >> 8);
+    }
+  
+    // Pressure
+    for (uint8_t i = 0; i < m; i++) {
+      int32_t var1 = (t_fine[i] >> 1) - 64000;
+      int32_t var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * p6) >> 2;
+      var2 = var2 + ((var1 * p5) << 1);
+      var2 = (var2 >> 2) + p4;
+      var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * p3) >> 3) + ((p2 * var1) >> 1);
+      var1 = var1 >> 18;
+      var1 = ((32768 + var1) * p1) >> 15;
+      if (var1 == 0) {
+        o[i].pressure = 0;
+        continue;
+      }
+  
+      int32_t calc_pres = 1048576 - adc_p[i];
+      calc_pres = (int32_t)((uint32_t)(calc_pres - (var2 >> 12)) * 3125U);
+      if (calc_pres >= 0x40000000) {
+        calc_pres = (calc_pres / var1) << 1;
+      } else {
+        calc_pres = (calc_pres << 1) / var1;
+      }
+  
+      var1 = (p9 * (((calc_pres >> 3) * (calc_pres >> 3)) >> 13)) >> 12;
+      var2 = ((calc_pres >> 2) * p8) >> 13;
+      int32_t pp = calc_pres >> 8;
+      int32_t var3 = (int32_t)(((int64_t)pp * pp * pp * p10) >> 17);
+      o[i].pressure = (uint32_t)(calc_pres + ((var1 + var2 + var3 + p7) >> 4));
+    }
+  
+    // Humidity
+    for (uint8_t i = 0; i < m; i++) {
+      int32_t temp_scaled = ((t_fine[i] * 5) + 128) >> 8;
+      int32_t var1 = (adc_h[i] - h1) - (((temp_scaled * h3) / 100) >> 1);
+      int32_t var2 = (h2 * (((temp_scaled * h4) / 100) +
+                            (((temp_scaled * ((temp_scaled * h5) / 100)) >> 6) / 100) +
+                            (1 * 16384))) >> 10;
+      int32_t var3 = var1 * var2;
+      int32_t var4 = (h6 + ((temp_scaled * h7) / 100)) >> 4;
+      int32_t var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
+      int32_t var6 = (var4 * var5) >> 1;
+      int32_t calc_hum = (((var3 + var6) >> 10) * 1000) >> 12;
+      o[i].humidity = (uint32_t)constrain(calc_hum, 0, 100000);
+    }
+  
+    // Gas
+    if constexpr (high) {
+      for (uint8_t i = 0; i < m; i++) {
+        int32_t var2 = 4096 + (adc_g[i] - 512) * 3;
+        o[i].gas_resistance = (uint32_t)(gas_var3[gas_lsb[i] & GAS_RANGE_MSK] / var2) * 100;
+      }
+    } else {
+      for (uint8_t i = 0; i < m; i++) {
+        uint8_t range = gas_lsb[i] & GAS_RANGE_MSK;
+        int64_t var2 = (((int64_t)adc_g[i] << 15) - 16777216) + gas_var1[range];
+        o[i].gas_resistance = (uint32_t)((gas_var3[range] + (var2 >> 1)) / var2);
+      }
+    }
+    for (uint8_t i = 0; i < m; i++) {
+      o[i].heat_stable = (gas_lsb[i] & HEAT_STAB_MSK) > 0;
+      o[i].gas_valid = (gas_lsb[i] & GASM_VALID_MSK) > 0;
     }
-    
-    return (uint32_t)calc_gas_res;
   }
 }
 
 bool BME680_Custom::set_baselines(uint16_t burn_in_time_seconds, bool verbose) {
-  unsigned long start_time = millis();
-  unsigned long burn_in_ms = burn_in_time_seconds * 1000UL;
-  
-  float gas_sum = 0.0;
-  float hum_sum = 0.0;
-  uint16_t count = 0;
-  uint16_t averaged_qty = 50;
+  _baseline_reset();
+  _baseline_established = false;
+  _baseline_verbose = verbose;
+  _burn_in_start = millis();
+  _burn_in_ms = burn_in_time_seconds * 1000UL;
+  _calibrating = true;
   
   if (verbose) {
     Serial.print("Calibrating baseline for ");
@@ -276,56 +1204,73 @@ bool BME680_Custom::set_baselines(uint16_t burn_in_time_seconds, bool verbose) {
     Serial.println(" seconds...");
   }
   
-  while ((millis() - start_time) < burn_in_ms) {
-    if (get_sensor_data() && data.heat_stable) {
-      gas_sum += data.gas_resistance;
-      hum_sum += data.humidity;
-      count++;
-      
-      if (verbose && (count % 10 == 0)) {
-        Serial.print("Progress: ");
-        Serial.print((millis() - start_time) / 1000);
-        Serial.print("s - Gas: ");
-        Serial.print(data.gas_resistance);
-        Serial.print(" Ohms, Hum: ");
-        Serial.print(data.humidity);
-        Serial.println("%");
-      }
-      
-      delay(1000);
-    } else {
-      delay(100);
-    }
+  return true;
+}
+
+void BME680_Custom::_baseline_reset() {
+  for (uint8_t i = 0; i < BASELINE_SAMPLES; i++) {
+    _baseline.gas[i] = 0;
+    _baseline.hum[i] = 0;
   }
+  _baseline.gas_sum = 0;
+  _baseline.hum_sum = 0;
+  _baseline.head = 0;
+  _baseline.count = 0;
+  _baseline.pushed = 0;
+}
+
+void BME680_Custom::_baseline_push(uint32_t gas, uint32_t hum) {
+  // Drop the oldest sample once the window is full
+  if (_baseline.count == BASELINE_SAMPLES) {
+    _baseline.gas_sum -= _baseline.gas[_baseline.head];
+    _baseline.hum_sum -= _baseline.hum[_baseline.head];
+  } else {
+    _baseline.count++;
+  }
+  
+  _baseline.gas[_baseline.head] = gas;
+  _baseline.hum[_baseline.head] = hum;
+  _baseline.gas_sum += gas;
+  _baseline.hum_sum += hum;
+  _baseline.head = (_baseline.head + 1) % BASELINE_SAMPLES;
+  _baseline.pushed++;
   
-  if (count < averaged_qty) {
-    averaged_qty = count;
+  if (_baseline_verbose && (_baseline.pushed % 10 == 0)) {
+    Serial.print("Progress: ");
+    Serial.print((millis() - _burn_in_start) / 1000);
+    Serial.print("s - Gas: ");
+    Serial.print(gas);
+    Serial.print(" Ohms, Hum: ");
+    Serial.print(hum / 1000);
+    Serial.println("%");
   }
   
-  if (count > 0) {
-    // Use last N readings for baseline
-    uint16_t start_idx = (count > averaged_qty) ? (count - averaged_qty) : 0;
-    // For simplicity, we'll use average of all readings
-    // In a full implementation, you'd store readings and average last N
-    _gas_baseline = gas_sum / count;
-    _hum_baseline = hum_sum / count;
-    _baseline_established = true;
-    
-    if (verbose) {
-      Serial.print("Baseline established - Gas: ");
-      Serial.print(_gas_baseline);
-      Serial.print(" Ohms, Hum: ");
-      Serial.print(_hum_baseline);
-      Serial.println("%");
-    }
-    
-    return true;
+  if ((millis() - _burn_in_start) < _burn_in_ms || _baseline.count < BASELINE_MIN_SAMPLES) {
+    return;
   }
   
-  return false;
+  // Burn-in complete - baseline is the average of the last N readings
+  _gas_baseline_fixed = _baseline.gas_sum / _baseline.count;
+  _hum_baseline_fixed = _baseline.hum_sum / _baseline.count;
+#ifndef BME680_FIXED_ONLY
+  _gas_baseline = _gas_baseline_fixed;
+  _hum_baseline = _hum_baseline_fixed / 1000.0f;
+#endif
+  _baseline_established = true;
+  _calibrating = false;
+  
+  if (_baseline_verbose) {
+    Serial.print("Baseline established - Gas: ");
+    Serial.print(_gas_baseline_fixed);
+    Serial.print(" Ohms, Hum: ");
+    Serial.print(_hum_baseline_fixed / 1000);
+    Serial.println("%");
+  }
 }
 
 float BME680_Custom::calculate_iaq_score(float hum_weighting) {
+  METRIC_SCOPE(metric_iaq);
+  
   if (!_baseline_established) {
     return -1.0;
   }
@@ -360,6 +1305,44 @@ float BME680_Custom::calculate_iaq_score(float hum_weighting) {
   return air_quality_score;
 }
 
+int16_t BME680_Custom::calculate_iaq_score_fixed(uint8_t hum_weighting_pct) {
+  METRIC_SCOPE(metric_iaq);
+  
+  if (!_baseline_established) {
+    return -1;
+  }
+  
+  if (data_fixed.gas_resistance == 0 || _gas_baseline_fixed == 0) {
+    return -1;
+  }
+  
+  if (hum_weighting_pct > 100) hum_weighting_pct = 100;
+  
+  // Scores in centi-points; humidity in milli-%RH (100000 = 100%)
+  int32_t hum_max = (int32_t)hum_weighting_pct * 100;
+  int32_t gas_max = 10000 - hum_max;
+  int32_t hum = (int32_t)data_fixed.humidity;
+  int32_t hum_base = (int32_t)_hum_baseline_fixed;
+  
+  // Calculate humidity score
+  int32_t hum_score;
+  if (hum > hum_base) {
+    hum_score = (hum_base < 100000) ? (int32_t)(((int64_t)(100000 - hum) * hum_max) / (100000 - hum_base)) : 0;
+  } else {
+    hum_score = (hum_base > 0) ? (int32_t)(((int64_t)hum * hum_max) / hum_base) : hum_max;
+  }
+  
+  // Calculate gas score
+  int32_t gas_score;
+  if (data_fixed.gas_resistance < _gas_baseline_fixed) {
+    gas_score = (int32_t)(((uint64_t)data_fixed.gas_resistance * gas_max) / _gas_baseline_fixed);
+  } else {
+    gas_score = gas_max;
+  }
+  
+  return (int16_t)(hum_score + gas_score);
+}
+
 bool BME680_Custom::check_safe_to_open(float threshold) {
   if (!_baseline_established) {
     return false;
@@ -375,46 +1358,110 @@ bool BME680_Custom::check_safe_to_open(float threshold) {
 
 // Configuration methods
 void BME680_Custom::set_humidity_oversample(uint8_t value) {
+  _os_h = value;
   _set_bits(CONF_OS_H_ADDR, OSH_MSK, OSH_POS, value);
 }
 
 void BME680_Custom::set_pressure_oversample(uint8_t value) {
+  _os_p = value;
   _set_bits(CONF_T_P_MODE_ADDR, OSP_MSK, OSP_POS, value);
 }
 
 void BME680_Custom::set_temperature_oversample(uint8_t value) {
+  _os_t = value;
   _set_bits(CONF_T_P_MODE_ADDR, OST_MSK, OST_POS, value);
 }
 
 void BME680_Custom::set_filter(uint8_t value) {
+  _filter = value;
   _set_bits(CONF_ODR_FILT_ADDR, FILTER_MSK, FILTER_POS, value);
 }
 
 void BME680_Custom::set_gas_status(uint8_t value) {
+  _run_gas = value;
   _set_bits(CONF_ODR_RUN_GAS_NBC_ADDR, RUN_GAS_MSK, RUN_GAS_POS, value);
 }
 
 void BME680_Custom::set_gas_heater_temperature(uint16_t temperature, uint8_t nb_profile) {
   temperature = constrain(temperature, 200, 400);
-  uint8_t res_heat = _calc_heater_resistance(temperature);
-  _write_byte(RES_HEAT0_ADDR + nb_profile, res_heat);
+  if (nb_profile >= NUM_HEATER_PROFILES) return;
+  
+  _heater_temp[nb_profile] = temperature;
+  _res_heat[nb_profile] = _calc_heater_resistance(temperature);
+  _res_heat_dirty |= (1 << nb_profile);
 }
 
 void BME680_Custom::set_gas_heater_duration(uint16_t duration, uint8_t nb_profile) {
-  uint8_t dur = _calc_heater_duration(duration);
-  _write_byte(GAS_WAIT0_ADDR + nb_profile, dur);
+  if (nb_profile >= NUM_HEATER_PROFILES) return;
+  
+  // Longest duration the heater register can encode is 4032 ms
+  _heater_duration[nb_profile] = (duration < 0xFC0) ? duration : 0xFC0;
+  _gas_wait[nb_profile] = _calc_heater_duration(duration);
+  _gas_wait_dirty |= (1 << nb_profile);
 }
 
 void BME680_Custom::select_gas_heater_profile(uint8_t profile) {
   if (profile > 9) profile = 9;
+  _heater_profile = profile;
   _set_bits(CONF_ODR_RUN_GAS_NBC_ADDR, NBCONV_MSK, NBCONV_POS, profile);
 }
 
 void BME680_Custom::set_power_mode(uint8_t mode) {
-  _set_bits(CONF_T_P_MODE_ADDR, MODE_MSK, MODE_POS, mode);
+  if (mode == FORCED_MODE) {
+    _flush_config(true);
+  } else {
+    _ctrl_dirty |= (1 << (CONF_T_P_MODE_ADDR - CTRL_REGS_ADDR));
+    _flush_config(false);
+  }
   delay(10);
 }
 
+void BME680_Custom::flush_config() {
+  _flush_config(false);
+}
+
+void BME680_Custom::apply(const BME680Config& config) {
+  set_humidity_oversample(config.os_hum);
+  set_pressure_oversample(config.os_pres);
+  set_temperature_oversample(config.os_temp);
+  set_filter(config.filter);
+  set_gas_status(config.run_gas);
+  
+  uint8_t count = (config.num_heater_profiles < NUM_HEATER_PROFILES) ? config.num_heater_profiles : NUM_HEATER_PROFILES;
+  for (uint8_t i = 0; i < count; i++) {
+    set_gas_heater_temperature(config.heater_temp[i], i);
+    set_gas_heater_duration(config.heater_duration[i], i);
+  }
+  select_gas_heater_profile(config.heater_profile);
+  
+  flush_config();
+}
+
+void BME680_Custom::get_config(BME680Config& config) {
+  config.os_hum = _os_h;
+  config.os_pres = _os_p;
+  config.os_temp = _os_t;
+  config.filter = _filter;
+  config.run_gas = _run_gas;
+  config.heater_profile = _heater_profile;
+  config.num_heater_profiles = NUM_HEATER_PROFILES;
+  for (uint8_t i = 0; i < NUM_HEATER_PROFILES; i++) {
+    config.heater_temp[i] = _heater_temp[i];
+    config.heater_duration[i] = _heater_duration[i];
+  }
+}
+
+void BME680_Custom::set_heater_profiles(const uint16_t* temperatures, const uint16_t* durations, uint8_t count) {
+  if (count > NUM_HEATER_PROFILES) count = NUM_HEATER_PROFILES;
+  
+  for (uint8_t i = 0; i < count; i++) {
+    set_gas_heater_temperature(temperatures[i], i);
+    set_gas_heater_duration(durations[i], i);
+  }
+  
+  flush_config();
+}
+
 // Helper methods
 float BME680_Custom::get_gas_baseline() {
   return _baseline_established ? _gas_baseline : -1.0;
@@ -424,43 +1471,111 @@ float BME680_Custom::get_hum_baseline() {
   return _baseline_established ? _hum_baseline : -1.0;
 }
 
+uint32_t BME680_Custom::get_gas_baseline_fixed() {
+  return _baseline_established ? _gas_baseline_fixed : 0;
+}
+
+uint32_t BME680_Custom::get_hum_baseline_fixed() {
+  return _baseline_established ? _hum_baseline_fixed : 0;
+}
+
 bool BME680_Custom::is_baseline_established() {
   return _baseline_established;
 }
 
-// Low-level I2C methods
+bool BME680_Custom::is_calibrating() {
+  return _calibrating;
+}
+
+uint8_t BME680_Custom::get_baseline_sample_count() {
+  return _baseline.count;
+}
+
+// Low-level I2C methods (each call is one bus transaction)
 void BME680_Custom::_write_byte(uint8_t reg, uint8_t value) {
-  Wire.beginTransmission(_i2c_addr);
-  Wire.write(reg);
-  Wire.write(value);
-  Wire.endTransmission();
+  _bus->write_reg(_i2c_addr, reg, value);
 }
 
 uint8_t BME680_Custom::_read_byte(uint8_t reg) {
-  Wire.beginTransmission(_i2c_addr);
-  Wire.write(reg);
-  Wire.endTransmission();
-  Wire.requestFrom(_i2c_addr, (uint8_t)1);
-  return Wire.read();
+  return _bus->read_reg(_i2c_addr, reg);
 }
 
 void BME680_Custom::_read_bytes(uint8_t reg, uint8_t* data, uint8_t len) {
-  Wire.beginTransmission(_i2c_addr);
-  Wire.write(reg);
-  Wire.endTransmission();
-  Wire.requestFrom(_i2c_addr, len);
-  for (uint8_t i = 0; i < len; i++) {
-    data[i] = Wire.read();
+  _bus->read_regs(_i2c_addr, reg, data, len);
+}
+
+void BME680_Custom::_write_regs(const uint8_t* pairs, uint8_t count) {
+  // Register/value pairs in as few transactions as the Wire buffer allows,
+  // without another driver's traffic in between
+  uint8_t pairs_per_tx = BME680_WIRE_BUFFER_LEN / 2;
+  I2CBusLock hold(*_bus);
+  
+  for (uint8_t i = 0; i < count; i += pairs_per_tx) {
+    uint8_t n = ((count - i) < pairs_per_tx) ? (count - i) : pairs_per_tx;
+    _bus->write(_i2c_addr, &pairs[i * 2], n * 2);
   }
 }
 
 void BME680_Custom::_set_bits(uint8_t reg, uint8_t mask, uint8_t position, uint8_t value) {
+  if (reg >= CTRL_REGS_ADDR && reg < CTRL_REGS_ADDR + CTRL_REGS_LEN) {
+    uint8_t idx = reg - CTRL_REGS_ADDR;
+    uint8_t temp = (_ctrl_regs[idx] & ~mask) | ((value << position) & mask);
+    if (temp != _ctrl_regs[idx]) {
+      _ctrl_regs[idx] = temp;
+      _ctrl_dirty |= (1 << idx);
+    }
+    return;
+  }
+  
+  I2CBusLock hold(*_bus);
   uint8_t temp = _read_byte(reg);
   temp &= ~mask;
   temp |= (value << position) & mask;
   _write_byte(reg, temp);
 }
 
+void BME680_Custom::_flush_config(bool trigger) {
+  uint8_t pairs[(CTRL_REGS_LEN + 2 * NUM_HEATER_PROFILES) * 2];
+  uint8_t count = 0;
+  
+  for (uint8_t i = 0; i < NUM_HEATER_PROFILES; i++) {
+    if (_res_heat_dirty & (1 << i)) {
+      pairs[count * 2] = RES_HEAT0_ADDR + i;
+      pairs[count * 2 + 1] = _res_heat[i];
+      count++;
+    }
+    if (_gas_wait_dirty & (1 << i)) {
+      pairs[count * 2] = GAS_WAIT0_ADDR + i;
+      pairs[count * 2 + 1] = _gas_wait[i];
+      count++;
+    }
+  }
+  
+  // The mode register goes last so the conversion starts with the new settings
+  uint8_t mode_idx = CONF_T_P_MODE_ADDR - CTRL_REGS_ADDR;
+  for (uint8_t i = 0; i < CTRL_REGS_LEN; i++) {
+    if (i != mode_idx && (_ctrl_dirty & (1 << i))) {
+      pairs[count * 2] = CTRL_REGS_ADDR + i;
+      pairs[count * 2 + 1] = _ctrl_regs[i];
+      count++;
+    }
+  }
+  
+  if (trigger || (_ctrl_dirty & (1 << mode_idx))) {
+    pairs[count * 2] = CONF_T_P_MODE_ADDR;
+    pairs[count * 2 + 1] = _ctrl_regs[mode_idx] | (trigger ? FORCED_MODE : SLEEP_MODE);
+    count++;
+  }
+  
+  if (count > 0) {
+    _write_regs(pairs, count);
+  }
+  
+  _ctrl_dirty = 0;
+  _res_heat_dirty = 0;
+  _gas_wait_dirty = 0;
+}
+
 int16_t BME680_Custom::_bytes_to_word(uint8_t msb, uint8_t lsb, bool signed_val) {
   int16_t word = ((uint16_t)msb << 8) | lsb;
   if (signed_val && (word & 0x8000)) {
@@ -480,8 +1595,8 @@ uint8_t BME680_Custom::_calc_heater_resistance(uint16_t temperature) {
   temperature = constrain(temperature, 200, 400);
   
   int32_t var1 = (((int32_t)_ambient_temperature * (int32_t)_cal.par_gh3) / 1000) * 256;
-  int32_t var2 = ((int32_t)_cal.par_gh1 + 784) * 
-                 (((((int32_t)_cal.par_gh2 + 154009) * temperature * 5) / 100) + 3276800) / 10;
+  int32_t var2 = ((int32_t)_cal.par_gh1 + 784) *
+                 ((((((int32_t)_cal.par_gh2 + 154009) * temperature * 5) / 100) + 3276800) / 10);
   int32_t var3 = var1 + (var2 / 2);
   int32_t var4 = (var3 / ((int32_t)_cal.res_heat_range + 4));
   int32_t var5 = (131 * (int32_t)_cal.res_heat_val) + 65536;
@@ -507,3 +1622,17 @@ uint8_t BME680_Custom::_calc_heater_duration(uint16_t duration) {
   return 0xFF;
 }
 
+
+// Variant paths for BME680<Variant> (BME680_Custom.h), and the run-time
+// forms for the host harness
+#define BME680_INSTANTIATE(V) \
+  template bool BME680_Custom::_begin<V>(); \
+  template bool BME680_Custom::_get_sensor_data<V>(); \
+  template bool BME680_Custom::_fetch<V>(); \
+  template void BME680_Custom::_compensate<V>(const uint8_t*, size_t, SensorDataFixed*); \
+  template void BME680_Custom::_parse_field_data<V>(const uint8_t*); \
+  template uint32_t BME680_Custom::_calc_gas_resistance<V>(uint16_t, uint8_t);
+
+BME680_INSTANTIATE(BME680_VARIANT_GAS_LOW)
+BME680_INSTANTIATE(BME680_VARIANT_GAS_HIGH)
+BME680_INSTANTIATE(BME680_VARIANT_ANY)
@@ -6,6 +6,11 @@
  * - Baseline calibration for IAQ
  * - IAQ score calculation
  * - Heat stable detection
+ * - Heater-profile sweeps (gas resistance at up to 10 set-points)
+ * - Continuous T/P/H sampling with fixed-point decimation
+ * - Bus access through a lockable I2CBus, shareable across tasks
+ * - Several sensors in one acquisition pass (BME680Array.h)
+ * - Chip variant fixed at compile time (BME680<Variant>), optional
  * 
  * Ported from Python implementation to Arduino C++
  */
@@ -15,6 +20,7 @@
 
 #include <Wire.h>
 #include <Arduino.h>
+#include "I2CBus.h"
 
 // I2C Addresses
 #define BME680_I2C_ADDR_PRIMARY   0x76
@@ -45,10 +51,25 @@
 #define SLEEP_MODE  0
 #define FORCED_MODE 1
 
+// Measurement states (returned by poll())
+#define MEAS_IDLE     0
+#define MEAS_PENDING  1
+#define MEAS_READY    2
+#define MEAS_ERROR    3
+
+// Extra time allowed past the computed conversion time before poll() gives up
+#define MEAS_TIMEOUT_MS 100
+
 // Gas measurement
 #define ENABLE_GAS_MEAS_LOW  0x01
 #define ENABLE_GAS_MEAS_HIGH 0x02
 
+// Chip variants (CHIP_VARIANT_ADDR). BME680_VARIANT_ANY reads the variant
+// from the chip at begin() and checks it on every reading.
+#define BME680_VARIANT_GAS_LOW  0x00
+#define BME680_VARIANT_GAS_HIGH 0x01
+#define BME680_VARIANT_ANY      0xFF
+
 // Register addresses
 #define CHIP_ID_ADDR          0xD0
 #define CHIP_VARIANT_ADDR     0xF0
@@ -70,6 +91,19 @@
 #define ADDR_RES_HEAT_VAL_ADDR   0x00
 #define ADDR_RANGE_SW_ERR_ADDR   0x04
 
+// Control register block (0x70-0x75) kept in the register shadow
+#define CTRL_REGS_ADDR        CONF_HEAT_CTRL_ADDR
+#define CTRL_REGS_LEN         6
+
+// Largest I2C transaction Wire can buffer
+#if defined(I2C_BUFFER_LENGTH)
+#define BME680_WIRE_BUFFER_LEN I2C_BUFFER_LENGTH
+#elif defined(BUFFER_LENGTH)
+#define BME680_WIRE_BUFFER_LEN BUFFER_LENGTH
+#else
+#define BME680_WIRE_BUFFER_LEN 32
+#endif
+
 // Masks
 #define NEW_DATA_MSK    0x80
 #define GAS_INDEX_MSK   0x0F
@@ -100,7 +134,16 @@
 // Field length
 #define FIELD_LENGTH    17
 
-// Lookup tables for gas resistance calculation
+// Number of heater set-points
+#define NUM_HEATER_PROFILES 10
+
+// Rolling IAQ baseline: average of the last BASELINE_SAMPLES heat-stable
+// readings, established once the burn-in has passed with at least
+// BASELINE_MIN_SAMPLES readings collected
+#define BASELINE_SAMPLES     50
+#define BASELINE_MIN_SAMPLES 10
+
+// Lookup tables for gas resistance calculation (low-gas variant only)
 extern const uint32_t lookupTable1[16];
 extern const uint32_t lookupTable2[16];
 
@@ -135,6 +178,111 @@ struct CalibrationData {
   int8_t range_sw_err;
 };
 
+// Complete sensor configuration, programmed in one transaction by apply()
+struct BME680Config {
+  uint8_t os_hum;
+  uint8_t os_pres;
+  uint8_t os_temp;
+  uint8_t filter;
+  uint8_t run_gas;
+  uint8_t heater_profile;
+  uint8_t num_heater_profiles;
+  uint16_t heater_temp[NUM_HEATER_PROFILES];
+  uint16_t heater_duration[NUM_HEATER_PROFILES];
+};
+
+// Persisted driver state: calibration coefficients and IAQ baseline,
+// keyed by chip variant, I2C address and mux channel. Version 2:
+// coefficients saved by version 1 were parsed from the wrong offsets and
+// are not restored.
+#define BME680_STATE_VERSION 2
+#define BME680_NVS_NAMESPACE "bme680"
+
+// Default age after which a saved baseline is no longer restored (1 day)
+#define BME680_STATE_MAX_AGE 86400UL
+
+// No mux channel in the NVS key (device directly on the bus)
+#define BME680_NVS_NO_CHANNEL 0xFF
+
+struct BME680State {
+  uint8_t version;
+  uint8_t variant;
+  uint8_t i2c_addr;
+  bool baseline_established;
+  uint32_t timestamp;       // Unix time when saved, 0 if the clock was not set
+  uint32_t gas_baseline;    // Ohms
+  uint32_t hum_baseline;    // milli-%RH
+  CalibrationData cal;
+};
+
+// Ring buffer of heat-stable samples with running sums
+struct BaselineRing {
+  uint32_t gas[BASELINE_SAMPLES];   // Ohms
+  uint32_t hum[BASELINE_SAMPLES];   // milli-%RH
+  uint64_t gas_sum;
+  uint32_t hum_sum;
+  uint8_t head;
+  uint8_t count;
+  uint16_t pushed;  // Samples since the reset (count stops at the window size)
+};
+
+// Driver state kept across deep sleep (in RTC_DATA_ATTR memory): the
+// coefficients, the settings and register shadow the sensor still holds,
+// and the baseline ring including a calibration in progress
+#define BME680_SLEEP_MAGIC 0x680D
+
+struct BME680SleepState {
+  uint16_t magic;           // BME680_SLEEP_MAGIC once exported
+  uint8_t variant;
+  uint8_t i2c_addr;
+  CalibrationData cal;
+  int32_t ambient_temperature;  // degC
+  
+  uint8_t os_h;
+  uint8_t os_p;
+  uint8_t os_t;
+  uint8_t run_gas;
+  uint8_t filter;
+  uint8_t heater_profile;
+  uint16_t heater_temp[NUM_HEATER_PROFILES];
+  uint16_t heater_duration[NUM_HEATER_PROFILES];
+  uint8_t ctrl_regs[CTRL_REGS_LEN];
+  uint8_t res_heat[NUM_HEATER_PROFILES];
+  uint8_t gas_wait[NUM_HEATER_PROFILES];
+  
+  bool baseline_established;
+  bool calibrating;
+  uint32_t gas_baseline;    // Ohms
+  uint32_t hum_baseline;    // milli-%RH
+  uint32_t burn_in_elapsed; // ms of burn-in already done
+  uint32_t burn_in_ms;
+  BaselineRing baseline;
+};
+
+// Result of one heater-profile sweep: gas resistance at each set-point
+struct GasSweep {
+  uint8_t steps;
+  uint16_t heat_stable_mask;  // Bit i set if step i reached its target temperature
+  uint16_t gas_valid_mask;
+  uint16_t duration_ms;       // First trigger to last result
+  uint16_t heater_temp[NUM_HEATER_PROFILES];      // degC
+  uint32_t gas_resistance[NUM_HEATER_PROFILES];   // Ohms
+};
+
+// Continuous T/P/H mode
+#define BME680_CONT_DECIMATION 8  // Conversions averaged into one output
+#define BME680_CONT_IIR_FRAC   8  // Fraction bits kept by the output filter
+
+// One decimated output of the continuous mode
+struct ContinuousData {
+  uint32_t pressure;     // Pa
+  uint32_t humidity;     // milli-%RH
+  int16_t temperature;   // centi-degC
+  uint16_t samples;      // Conversions behind this output
+  uint16_t rate;         // Achieved conversions per second, centi-Hz
+  uint16_t lost;         // Conversions timed out since start_continuous()
+};
+
 // Sensor data structure
 struct SensorData {
   float temperature;
@@ -145,10 +293,22 @@ struct SensorData {
   bool gas_valid;
 };
 
+// Fixed-point sensor data (integer results straight from the compensation,
+// 32-bit fields first so the struct packs into 16 bytes)
+struct SensorDataFixed {
+  uint32_t pressure;        // Pa
+  uint32_t humidity;        // milli-%RH
+  uint32_t gas_resistance;  // Ohms
+  int16_t temperature;      // centi-degC
+  bool heat_stable;
+  bool gas_valid;
+};
+
 class BME680_Custom {
 public:
-  BME680_Custom(uint8_t i2c_addr = BME680_I2C_ADDR_PRIMARY);
+  BME680_Custom(uint8_t i2c_addr = BME680_I2C_ADDR_PRIMARY, I2CBus& bus = i2c_bus);
   bool begin();
+  uint8_t get_i2c_address() { return _i2c_addr; }
   
   // Configuration
   void set_humidity_oversample(uint8_t value);
@@ -161,31 +321,199 @@ public:
   void select_gas_heater_profile(uint8_t profile);
   void set_power_mode(uint8_t mode);
   
-  // Reading
+  // Configuration setters only update the register shadow; dirty registers
+  // are written together by the next start_measurement() or flush_config()
+  void flush_config();
+  
+  // Burst configuration (all changed registers in one transaction)
+  void apply(const BME680Config& config);
+  void get_config(BME680Config& config);
+  void set_heater_profiles(const uint16_t* temperatures, const uint16_t* durations, uint8_t count);
+  
+  // Reading (blocking - waits for the conversion to finish)
   bool get_sensor_data();
   SensorData data;
   
+  // Same reading in fixed point. Define BME680_FIXED_ONLY to skip the float
+  // conversion into data on boards without an FPU.
+  SensorDataFixed data_fixed;
+  
+  // Non-blocking reading
+  // start_measurement() triggers a forced conversion and returns immediately,
+  // poll() reports MEAS_PENDING/MEAS_READY/MEAS_ERROR, fetch() reads the
+  // result into data. get_time_until_ready() tells the caller when to poll.
+  bool start_measurement();
+  uint8_t poll();
+  bool fetch();
+  uint16_t get_measurement_duration();
+  uint16_t get_time_until_ready();
+  
+  // Heater-profile sweep
+  // set_heater_sweep() programs set-points 0..count-1 in one burst and
+  // start_sweep() runs one forced conversion per set-point back to back.
+  // poll_sweep() returns MEAS_PENDING until the last step is read, then
+  // MEAS_READY with the result in sweep. Only the first step measures
+  // temperature, pressure and humidity (into data); the rest are gas-only,
+  // so each costs its heater duration plus ~6 ms. Sweep readings don't feed
+  // the IAQ baseline, and the sweep's set-points replace profiles
+  // 0..count-1 until they are reprogrammed.
+  bool set_heater_sweep(const uint16_t* temperatures, const uint16_t* durations, uint8_t count);
+  bool start_sweep();
+  uint8_t poll_sweep();
+  bool get_sweep_data();  // Blocking
+  uint16_t get_sweep_duration();
+  bool is_sweeping();
+  GasSweep sweep;
+  
+  // Continuous T/P/H sampling
+  // start_continuous() switches to 1x oversampling with the gas heater and
+  // IIR filter off (the shortest conversion the chip has) and keeps forced
+  // conversions running back to back. poll_continuous() reads each result
+  // with one burst that includes the status byte and re-triggers with a
+  // single mode-register write. Every `decimation` conversions are
+  // averaged in fixed point, smoothed by y += (x - y) >> iir_shift
+  // (0 = off), and returned as MEAS_READY in continuous. No floats, no
+  // baseline updates. stop_continuous() restores the previous settings.
+  bool start_continuous(uint8_t decimation = BME680_CONT_DECIMATION, uint8_t iir_shift = 0);
+  uint8_t poll_continuous();
+  void stop_continuous();
+  bool is_continuous() { return _cont_active; }
+  ContinuousData continuous;
+  
   // Baseline calibration for IAQ
+  // set_baselines() returns immediately; the baseline is built from the
+  // readings taken by fetch() and is_baseline_established() flips once the
+  // burn-in has passed with enough heat-stable samples
   bool set_baselines(uint16_t burn_in_time_seconds = 300, bool verbose = false);
   float get_gas_baseline();
   float get_hum_baseline();
   bool is_baseline_established();
+  bool is_calibrating();
+  uint8_t get_baseline_sample_count();
+  
+  // State save/restore. restore_state() before begin() makes begin() skip
+  // reading the coefficients; the baseline is only restored if it was saved
+  // less than max_age_seconds ago (age is unknown until the clock is set)
+  void export_state(BME680State& state);
+  bool import_state(const BME680State& state, uint32_t max_age_seconds = BME680_STATE_MAX_AGE);
+#if defined(ARDUINO_ARCH_ESP32)
+  bool save_state();
+  bool restore_state(uint32_t max_age_seconds = BME680_STATE_MAX_AGE);
+#endif
+  // Mux channel the device sits on, so identical sensors on different
+  // channels get their own NVS slot (set by BME680Array::add())
+  void set_nvs_channel(uint8_t channel) { _nvs_channel = channel; }
+  
+  // Batch compensation of logged field blocks: n frames of FIELD_LENGTH
+  // bytes (as read from FIELD0_ADDR) into out[0..n-1], same results as
+  // fetch(). No bus access and no driver state changes. The static form
+  // takes the coefficients and variant from an exported BME680State, for
+  // replaying logs away from the sensor.
+  void compensate_batch(const uint8_t* frames, size_t n, SensorDataFixed* out);
+  static void compensate_batch(const CalibrationData& cal, uint8_t variant,
+                               const uint8_t* frames, size_t n, SensorDataFixed* out);
+  
+  // Deep sleep. export_sleep_state() before sleeping (no measurement or
+  // sweep running); resume() instead of begin() after waking. resume()
+  // reads only the control block to check the sensor kept its settings,
+  // and reprograms it on the next measurement if it didn't. slept_ms
+  // counts towards a baseline burn-in in progress. Returns false (call
+  // begin()) if the state is not valid or the sensor doesn't answer.
+  void export_sleep_state(BME680SleepState& state);
+  bool resume(const BME680SleepState& state, uint32_t slept_ms = 0);
   
   // IAQ calculation
   float calculate_iaq_score(float hum_weighting = 0.25);
   bool check_safe_to_open(float threshold = 80.0);
   
+  // Fixed-point IAQ: score in centi-points (0-10000), -1 if unavailable
+  int16_t calculate_iaq_score_fixed(uint8_t hum_weighting_pct = 25);
+  uint32_t get_gas_baseline_fixed();
+  uint32_t get_hum_baseline_fixed();
+  
+protected:
+  // Paths that depend on the chip variant, for BME680<Variant>. Instantiated
+  // in the .cpp for BME680_VARIANT_GAS_LOW, _GAS_HIGH and _ANY (the public
+  // functions above, which branch on _variant).
+  template <uint8_t Variant> bool _begin();
+  template <uint8_t Variant> bool _get_sensor_data();
+  template <uint8_t Variant> bool _fetch();
+  template <uint8_t Variant> void _compensate(const uint8_t* frames, size_t n, SensorDataFixed* out);
+  
 private:
+  // Host test harness (extras/host) calls the compensation directly
+  friend class BME680HostHarness;
+  
   uint8_t _i2c_addr;
+  uint8_t _nvs_channel;
+  I2CBus* _bus;
   uint8_t _variant;
   CalibrationData _cal;
+  bool _cal_valid;
   int32_t _offset_temp_in_t_fine;
-  int32_t _ambient_temperature;
+  int32_t _ambient_temperature;  // degC, for the heater set-points
+  
+  // Current settings (used to compute the conversion time)
+  uint8_t _os_h;
+  uint8_t _os_p;
+  uint8_t _os_t;
+  uint8_t _run_gas;
+  uint8_t _filter;
+  uint8_t _heater_profile;
+  uint16_t _heater_temp[NUM_HEATER_PROFILES];
+  uint16_t _heater_duration[NUM_HEATER_PROFILES];
+  
+  // Register shadow (control block and heater set-points)
+  uint8_t _ctrl_regs[CTRL_REGS_LEN];
+  uint8_t _res_heat[NUM_HEATER_PROFILES];
+  uint8_t _gas_wait[NUM_HEATER_PROFILES];
+  uint8_t _ctrl_dirty;
+  uint16_t _res_heat_dirty;
+  uint16_t _gas_wait_dirty;
+  
+  // Non-blocking measurement state
+  uint8_t _meas_state;
+  unsigned long _meas_start;
+  uint16_t _meas_duration;
+  
+  // Sweep state
+  uint8_t _sweep_steps;       // Configured set-points, 0 = no sweep
+  uint8_t _sweep_step;
+  uint8_t _sweep_saved_profile;
+  bool _sweep_active;
+  bool _tph_skipped;          // T/P/H oversampling forced off (gas-only steps)
+  unsigned long _sweep_start;
+  
+  // Continuous state
+  bool _cont_active;
+  bool _cont_primed;          // Output filter holds a value
+  uint8_t _cont_decimation;
+  uint8_t _cont_iir_shift;
+  uint8_t _cont_count;
+  int32_t _cont_sum_t;
+  uint32_t _cont_sum_p;
+  uint32_t _cont_sum_h;
+  int32_t _cont_iir[3];       // T, P, H with BME680_CONT_IIR_FRAC fraction bits
+  unsigned long _cont_window_start;
+  BME680Config _cont_saved;
+  
+  void _trigger_forced();
+  void _cont_output();
   
   // Baseline data
   float _gas_baseline;
   float _hum_baseline;
+  uint32_t _gas_baseline_fixed;
+  uint32_t _hum_baseline_fixed;
   bool _baseline_established;
+  bool _calibrating;
+  bool _baseline_verbose;
+  unsigned long _burn_in_start;
+  unsigned long _burn_in_ms;
+  BaselineRing _baseline;
+  
+  void _baseline_reset();
+  void _baseline_push(uint32_t gas, uint32_t hum);
   
   // IAQ calculation
   float _calculate_humidity_score(float hum_weighting);
@@ -195,25 +523,72 @@ private:
   void _write_byte(uint8_t reg, uint8_t value);
   uint8_t _read_byte(uint8_t reg);
   void _read_bytes(uint8_t reg, uint8_t* data, uint8_t len);
+  void _write_regs(const uint8_t* pairs, uint8_t count);
   
   // Register manipulation
   void _set_bits(uint8_t reg, uint8_t mask, uint8_t position, uint8_t value);
+  void _flush_config(bool trigger);
   
   // Calibration
   void _get_calibration_data();
+  uint32_t _get_time();
+#if defined(ARDUINO_ARCH_ESP32)
+  void _nvs_key(char* key, uint8_t variant);
+#endif
+  
+  // Field data
+  template <uint8_t Variant = BME680_VARIANT_ANY>
+  void _parse_field_data(const uint8_t* regs);
+  template <uint8_t Variant = BME680_VARIANT_ANY>
+  void _parse_gas(const uint8_t* regs, uint32_t& gas_resistance, bool& heat_stable, bool& gas_valid);
+  
+  // Sweep steps
+  uint16_t _tph_duration(bool skip_tph);
+  void _skip_tph(bool skip);
+  void _end_sweep();
   
   // Calculations
   int32_t _calc_temperature(uint32_t temp_adc);
   uint32_t _calc_pressure(uint32_t pres_adc);
   uint32_t _calc_humidity(uint16_t hum_adc);
+  template <uint8_t Variant = BME680_VARIANT_ANY>
   uint32_t _calc_gas_resistance(uint16_t gas_res_adc, uint8_t gas_range);
   uint8_t _calc_heater_resistance(uint16_t temperature);
   uint8_t _calc_heater_duration(uint16_t duration);
+  template <uint8_t Variant>
+  static void _compensate_batch(const CalibrationData& cal, uint8_t variant, int32_t t_fine_offset,
+                                const uint8_t* frames, size_t n, SensorDataFixed* out);
   
   // Helper functions
   int16_t _bytes_to_word(uint8_t msb, uint8_t lsb, bool signed_val = false);
   int8_t _twos_comp(uint8_t val);
 };
 
+// Driver for one chip variant, fixed at compile time:
+//   BME680<BME680_VARIANT_GAS_LOW> bme680(BME680_I2C_ADDR_PRIMARY);
+// begin() returns false on the other variant. get_sensor_data(), fetch()
+// and compensate_batch() don't check the variant, and a build that only
+// uses the high-gas variant doesn't link the low-gas lookup tables or
+// formula. Everything else (sweeps included) is BME680_Custom's, which
+// also serves through a BME680_Custom& (BME680Array).
+template <uint8_t Variant>
+class BME680 : public BME680_Custom {
+  static_assert(Variant == BME680_VARIANT_GAS_LOW || Variant == BME680_VARIANT_GAS_HIGH,
+                "BME680<Variant>: BME680_VARIANT_GAS_LOW or BME680_VARIANT_GAS_HIGH");
+  
+public:
+  BME680(uint8_t i2c_addr = BME680_I2C_ADDR_PRIMARY, I2CBus& bus = i2c_bus)
+    : BME680_Custom(i2c_addr, bus) {}
+  
+  bool begin() { return _begin<Variant>(); }
+  bool get_sensor_data() { return _get_sensor_data<Variant>(); }
+  bool fetch() { return _fetch<Variant>(); }
+  
+  using BME680_Custom::compensate_batch;
+  void compensate_batch(const uint8_t* frames, size_t n, SensorDataFixed* out) {
+    _compensate<Variant>(frames, n, out);
+  }
+};
+
 #endif
 
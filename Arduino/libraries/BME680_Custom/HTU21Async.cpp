@@ -0,0 +1,113 @@
+/*
+ * Non-blocking SHT21/HTU21 driver implementation
+ */
+
+#include "HTU21Async.h"
+
+HTU21Async::HTU21Async(I2CBus& bus) {
+  _bus = &bus;
+  _state = MEAS_IDLE;
+  _humidity_phase = false;
+  _step_start = 0;
+  _step_duration = 0;
+  _temperature = 0;
+  _humidity = 0;
+}
+
+bool HTU21Async::begin() {
+  if (!_bus->write_cmd(HTU21_I2C_ADDR, HTU21_CMD_SOFT_RESET)) {
+    return false;
+  }
+  delay(HTU21_RESET_TIME_MS);
+  _state = MEAS_IDLE;
+  return true;
+}
+
+bool HTU21Async::start() {
+  if (_state == MEAS_PENDING) {
+    return false;
+  }
+  
+  _humidity_phase = false;
+  if (!_command(HTU21_CMD_TEMP_NOHOLD, HTU21_TEMP_TIME_MS)) {
+    _state = MEAS_ERROR;
+    return false;
+  }
+  _state = MEAS_PENDING;
+  return true;
+}
+
+uint8_t HTU21Async::poll() {
+  if (_state != MEAS_PENDING) {
+    return _state;
+  }
+  
+  unsigned long elapsed = millis() - _step_start;
+  if (elapsed < _step_duration) {
+    return MEAS_PENDING;
+  }
+  
+  uint8_t buf[3];
+  if (_bus->read(HTU21_I2C_ADDR, buf, 3) != 3) {
+    // NACK: still converting
+    if (elapsed >= (unsigned long)_step_duration + MEAS_TIMEOUT_MS) {
+      _state = MEAS_ERROR;
+    }
+    return _state;
+  }
+  if (_crc8(buf, 2) != buf[2]) {
+    _state = MEAS_ERROR;
+    return _state;
+  }
+  
+  // Low two bits are status
+  uint32_t raw = ((uint16_t)buf[0] << 8 | buf[1]) & 0xFFFC;
+  
+  if (!_humidity_phase) {
+    // T = -46.85 + 175.72 * raw / 2^16
+    _temperature = (int16_t)((int32_t)((17572 * raw) >> 16) - 4685);
+    
+    _humidity_phase = true;
+    if (!_command(HTU21_CMD_HUM_NOHOLD, HTU21_HUM_TIME_MS)) {
+      _state = MEAS_ERROR;
+    }
+    return _state;
+  }
+  
+  // RH = -6 + 125 * raw / 2^16
+  int32_t humidity = (int32_t)((12500 * raw) >> 16) - 600;
+  _humidity = (uint16_t)constrain(humidity, 0, 10000);
+  _state = MEAS_READY;
+  return _state;
+}
+
+uint16_t HTU21Async::get_time_until_ready() {
+  if (_state != MEAS_PENDING) {
+    return 0;
+  }
+  
+  unsigned long elapsed = millis() - _step_start;
+  if (elapsed >= _step_duration) {
+    return 0;
+  }
+  
+  return _step_duration - elapsed;
+}
+
+bool HTU21Async::_command(uint8_t cmd, uint16_t duration) {
+  _step_start = millis();
+  _step_duration = duration;
+  return _bus->write_cmd(HTU21_I2C_ADDR, cmd);
+}
+
+uint8_t HTU21Async::_crc8(const uint8_t* data, uint8_t len) {
+  // x^8 + x^5 + x^4 + 1, initial value 0
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
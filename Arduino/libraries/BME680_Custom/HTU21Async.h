@@ -0,0 +1,66 @@
+/*
+ * Non-blocking SHT21/HTU21 driver
+ *
+ * Uses the no-hold commands, so the sensor converts with the bus free
+ * and a BME680 conversion can run at the same time. start() triggers
+ * the temperature conversion; poll() chains the humidity conversion
+ * behind it and reports MEAS_PENDING until both are read. Each result
+ * is CRC checked.
+ */
+
+#ifndef HTU21_ASYNC_H
+#define HTU21_ASYNC_H
+
+#include <Arduino.h>
+#include "I2CBus.h"
+#include "BME680_Custom.h"  // MEAS_* states
+
+#define HTU21_I2C_ADDR 0x40
+
+// Commands
+#define HTU21_CMD_TEMP_NOHOLD 0xF3
+#define HTU21_CMD_HUM_NOHOLD  0xF5
+#define HTU21_CMD_SOFT_RESET  0xFE
+
+// Conversion times at the default resolution (14-bit T, 12-bit RH).
+// An SHT21 can take longer; it NACKs the read until done.
+#define HTU21_TEMP_TIME_MS  50
+#define HTU21_HUM_TIME_MS   16
+#define HTU21_RESET_TIME_MS 15
+
+class HTU21Async {
+public:
+  HTU21Async(I2CBus& bus = i2c_bus);
+
+  // Soft reset; returns false if the sensor doesn't acknowledge
+  bool begin();
+
+  // Starts a temperature + humidity measurement
+  bool start();
+  uint8_t poll();
+
+  // ms until poll() should be called again (the end of the current
+  // conversion step, not of the whole measurement)
+  uint16_t get_time_until_ready();
+
+  // Last result: centi-degC and centi-%RH
+  int16_t get_temperature_fixed() { return _temperature; }
+  uint16_t get_humidity_fixed() { return _humidity; }
+  float get_temperature() { return _temperature / 100.0f; }
+  float get_humidity() { return _humidity / 100.0f; }
+
+private:
+  I2CBus* _bus;
+  uint8_t _state;
+  bool _humidity_phase;
+  unsigned long _step_start;
+  uint16_t _step_duration;
+
+  int16_t _temperature;
+  uint16_t _humidity;
+
+  bool _command(uint8_t cmd, uint16_t duration);
+  static uint8_t _crc8(const uint8_t* data, uint8_t len);
+};
+
+#endif
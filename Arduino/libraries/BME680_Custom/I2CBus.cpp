@@ -0,0 +1,107 @@
+/*
+ * Shared I2C bus implementation
+ */
+
+#include "I2CBus.h"
+#include <HotPathMetrics.h>
+
+I2CBus i2c_bus(Wire);
+
+// Bus time per transaction, not counting the wait for the lock
+METRIC_SITE(metric_i2c_write, "i2c_write");
+METRIC_SITE(metric_i2c_read, "i2c_read");
+
+I2CBus::I2CBus(TwoWire& wire) : _wire(wire) {
+#if defined(ARDUINO_ARCH_ESP32)
+  _lock = nullptr;
+#endif
+  _transactions = 0;
+  _errors = 0;
+}
+
+bool I2CBus::begin() {
+#if defined(ARDUINO_ARCH_ESP32)
+  if (!_lock) {
+    _lock = xSemaphoreCreateRecursiveMutex();
+  }
+  return _lock != nullptr;
+#else
+  return true;
+#endif
+}
+
+void I2CBus::lock() {
+#if defined(ARDUINO_ARCH_ESP32)
+  if (_lock) xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+#endif
+}
+
+void I2CBus::unlock() {
+#if defined(ARDUINO_ARCH_ESP32)
+  if (_lock) xSemaphoreGiveRecursive(_lock);
+#endif
+}
+
+bool I2CBus::write(uint8_t addr, const uint8_t* data, uint8_t len) {
+  I2CBusLock hold(*this);
+  METRIC_SCOPE(metric_i2c_write);
+  _transactions++;
+
+  _wire.beginTransmission(addr);
+  _wire.write(data, len);
+  if (_wire.endTransmission() != 0) {
+    _errors++;
+    return false;
+  }
+  return true;
+}
+
+bool I2CBus::write_reg(uint8_t addr, uint8_t reg, uint8_t value) {
+  uint8_t data[2] = { reg, value };
+  return write(addr, data, 2);
+}
+
+bool I2CBus::read_regs(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len) {
+  I2CBusLock hold(*this);
+  METRIC_SCOPE(metric_i2c_read);
+  _transactions++;
+
+  // No stop between the register write and the read
+  _wire.beginTransmission(addr);
+  _wire.write(reg);
+  if (_wire.endTransmission(false) != 0 || _wire.requestFrom(addr, len) != len) {
+    _errors++;
+    memset(data, 0, len);
+    return false;
+  }
+  for (uint8_t i = 0; i < len; i++) {
+    data[i] = _wire.read();
+  }
+  return true;
+}
+
+uint8_t I2CBus::read_reg(uint8_t addr, uint8_t reg) {
+  uint8_t value = 0;
+  read_regs(addr, reg, &value, 1);
+  return value;
+}
+
+uint8_t I2CBus::read(uint8_t addr, uint8_t* data, uint8_t len) {
+  I2CBusLock hold(*this);
+  METRIC_SCOPE(metric_i2c_read);
+  _transactions++;
+
+  uint8_t received = _wire.requestFrom(addr, len);
+  for (uint8_t i = 0; i < received; i++) {
+    data[i] = _wire.read();
+  }
+  return received;
+}
+
+bool I2CBus::probe(uint8_t addr) {
+  I2CBusLock hold(*this);
+  _transactions++;
+
+  _wire.beginTransmission(addr);
+  return _wire.endTransmission() == 0;
+}
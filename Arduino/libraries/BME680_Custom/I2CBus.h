@@ -0,0 +1,73 @@
+/*
+ * Shared I2C bus
+ *
+ * One lock around a TwoWire instance, so drivers in different FreeRTOS
+ * tasks can share the bus. Each call is a complete transaction:
+ * register reads use a repeated start (one transaction instead of two),
+ * and drivers that need several transactions back to back hold the lock
+ * with I2CBusLock. The lock is recursive.
+ *
+ * i2c_bus wraps Wire and is what BME680_Custom and HTU21Async use unless
+ * given another bus. Call i2c_bus.begin() once (after Wire.begin()) before
+ * sharing the bus between tasks; until then the lock is a no-op.
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class I2CBus {
+public:
+  I2CBus(TwoWire& wire);
+
+  // Creates the lock
+  bool begin();
+
+  // Exclusive use across several transactions (prefer I2CBusLock)
+  void lock();
+  void unlock();
+
+  // Returns false if the device didn't acknowledge
+  bool write(uint8_t addr, const uint8_t* data, uint8_t len);
+  bool write_reg(uint8_t addr, uint8_t reg, uint8_t value);
+  bool write_cmd(uint8_t addr, uint8_t cmd) { return write(addr, &cmd, 1); }
+
+  // reg write, repeated start, len bytes read
+  bool read_regs(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len);
+  uint8_t read_reg(uint8_t addr, uint8_t reg);
+
+  // Plain read; returns the bytes received, 0 if the device NACKed
+  // (e.g. an HTU21 still converting)
+  uint8_t read(uint8_t addr, uint8_t* data, uint8_t len);
+
+  // Address-only probe
+  bool probe(uint8_t addr);
+
+  // Statistics
+  uint32_t get_transactions() { return _transactions; }
+  uint32_t get_errors() { return _errors; }
+
+private:
+  TwoWire& _wire;
+#if defined(ARDUINO_ARCH_ESP32)
+  SemaphoreHandle_t _lock;
+#endif
+  volatile uint32_t _transactions;
+  volatile uint32_t _errors;
+};
+
+// Holds the bus for the lifetime of the object
+class I2CBusLock {
+public:
+  I2CBusLock(I2CBus& bus) : _bus(bus) { _bus.lock(); }
+  ~I2CBusLock() { _bus.unlock(); }
+
+private:
+  I2CBus& _bus;
+};
+
+extern I2CBus i2c_bus;
+
+#endif
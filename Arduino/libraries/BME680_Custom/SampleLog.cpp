@@ -0,0 +1,299 @@
+/*
+ * Flash ring log implementation
+ */
+
+#include "SampleLog.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+// Record layout
+//   0  uint32_t seq
+//   4  sample (TELEMETRY_SAMPLE_SIZE bytes)
+//  29  uint8_t  reserved
+//  30  uint16_t crc16 over bytes 0-29
+#define RECORD_CRC_OFFSET 30
+
+#define ACK_PATH SAMPLE_LOG_DIR "/ack"
+
+SampleLog::SampleLog() {
+  _ready = false;
+  _oldest_seq = 0;
+  _next_seq = 0;
+  _acked_seq = 0;
+  _read_seq = 0;
+  _dropped = 0;
+  _skip_start = 0;
+  _skip_end = 0;
+  _segment_id = 0;
+}
+
+bool SampleLog::begin(bool format_if_failed) {
+  if (!LittleFS.begin(format_if_failed)) {
+    return false;
+  }
+  if (!LittleFS.exists(SAMPLE_LOG_DIR) && !LittleFS.mkdir(SAMPLE_LOG_DIR)) {
+    return false;
+  }
+
+  // Segment range from the file names (hex segment ids)
+  bool found = false;
+  uint32_t min_id = 0;
+  uint32_t max_id = 0;
+  File dir = LittleFS.open(SAMPLE_LOG_DIR);
+  for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+    const char* name = entry.name();
+    const char* base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+
+    char* end;
+    uint32_t id = strtoul(base, &end, 16);
+    if (end == base || *end != '\0') {
+      continue;
+    }
+    if (!found || id < min_id) min_id = id;
+    if (!found || id > max_id) max_id = id;
+    found = true;
+  }
+  dir.close();
+
+  uint32_t acked = 0;
+  File ack_file = LittleFS.open(ACK_PATH, "r");
+  if (ack_file) {
+    uint8_t buf[4];
+    if (ack_file.read(buf, 4) == 4) {
+      acked = telemetry_get32(buf);
+    }
+    ack_file.close();
+  }
+
+  if (!found) {
+    // Empty: sequence numbers carry on from the last acknowledgement
+    _oldest_seq = _next_seq = _acked_seq = _read_seq = acked;
+    _ready = true;
+    return true;
+  }
+
+  // Tail of the newest segment: the last record with a valid CRC
+  if (!_open_segment(max_id, false)) {
+    return false;
+  }
+  uint32_t base_seq = max_id * SAMPLE_LOG_SEGMENT_RECORDS;
+  uint32_t n = min((uint32_t)(_segment.size() / SAMPLE_LOG_RECORD_SIZE), (uint32_t)SAMPLE_LOG_SEGMENT_RECORDS);
+  while (n > 0) {
+    uint8_t rec[SAMPLE_LOG_RECORD_SIZE];
+    _segment.seek((n - 1) * SAMPLE_LOG_RECORD_SIZE);
+    if (_segment.read(rec, SAMPLE_LOG_RECORD_SIZE) == SAMPLE_LOG_RECORD_SIZE &&
+        _crc16(rec, RECORD_CRC_OFFSET) == telemetry_get16(rec + RECORD_CRC_OFFSET) &&
+        telemetry_get32(rec) == base_seq + n - 1) {
+      break;
+    }
+    n--;
+  }
+
+  _oldest_seq = min_id * SAMPLE_LOG_SEGMENT_RECORDS;
+  _next_seq = base_seq + n;
+
+  // Records the ring overwrote before they were confirmed
+  if (acked < _oldest_seq) {
+    _dropped += _oldest_seq - acked;
+    acked = _oldest_seq;
+  }
+  _acked_seq = min(acked, _next_seq);
+  _read_seq = _acked_seq;
+
+  _ready = true;
+  return true;
+}
+
+bool SampleLog::append(const TelemetrySample& sample) {
+  if (!_ready) {
+    return false;
+  }
+
+  uint32_t id = _next_seq / SAMPLE_LOG_SEGMENT_RECORDS;
+  uint32_t index = _next_seq % SAMPLE_LOG_SEGMENT_RECORDS;
+  if (!_segment || _segment_id != id) {
+    // Only the first record of a segment creates its file
+    if (!_open_segment(id, index == 0)) {
+      return false;
+    }
+    if (index == 0) {
+      _trim();
+    }
+  }
+
+  uint8_t rec[SAMPLE_LOG_RECORD_SIZE];
+  telemetry_put32(rec, _next_seq);
+  telemetry_put_sample(rec + 4, sample);
+  rec[RECORD_CRC_OFFSET - 1] = 0;
+  telemetry_put16(rec + RECORD_CRC_OFFSET, _crc16(rec, RECORD_CRC_OFFSET));
+
+  if (!_segment.seek(index * SAMPLE_LOG_RECORD_SIZE) ||
+      _segment.write(rec, SAMPLE_LOG_RECORD_SIZE) != SAMPLE_LOG_RECORD_SIZE) {
+    return false;
+  }
+  _segment.flush();
+
+  _next_seq++;
+  return true;
+}
+
+uint16_t SampleLog::read(TelemetrySample* out, uint16_t max, uint32_t& first_seq) {
+  if (_read_seq < _oldest_seq) {
+    _read_seq = _oldest_seq;
+  }
+  if (!_ready || _read_seq >= _next_seq || max == 0) {
+    return 0;
+  }
+
+  uint32_t id = _read_seq / SAMPLE_LOG_SEGMENT_RECORDS;
+  uint32_t index = _read_seq % SAMPLE_LOG_SEGMENT_RECORDS;
+  uint32_t n = min(min((uint32_t)max, _next_seq - _read_seq), (uint32_t)(SAMPLE_LOG_SEGMENT_RECORDS - index));
+
+  char path[24];
+  _segment_path(path, id);
+  File f = LittleFS.open(path, "r");
+  if (!f || !f.seek(index * SAMPLE_LOG_RECORD_SIZE)) {
+    return 0;
+  }
+
+  uint16_t count = 0;
+  first_seq = _read_seq;
+  for (uint32_t i = 0; i < n; i++) {
+    uint8_t rec[SAMPLE_LOG_RECORD_SIZE];
+    if (f.read(rec, SAMPLE_LOG_RECORD_SIZE) != SAMPLE_LOG_RECORD_SIZE) {
+      break;
+    }
+
+    bool valid = _crc16(rec, RECORD_CRC_OFFSET) == telemetry_get16(rec + RECORD_CRC_OFFSET) &&
+                 telemetry_get32(rec) == _read_seq;
+    if (!valid) {
+      // Corrupt records are skipped; out[] stays consecutive. Each one is
+      // counted once, however often rewind() reads past it again.
+      if (count > 0) break;
+      if (_read_seq >= _skip_end) {
+        if (_read_seq != _skip_end) {
+          _skip_start = _read_seq;
+        }
+        _skip_end = _read_seq + 1;
+        _dropped++;
+      }
+      _read_seq++;
+      first_seq = _read_seq;
+      continue;
+    }
+
+    telemetry_get_sample(rec + 4, out[count++]);
+    _read_seq++;
+  }
+  f.close();
+
+  // Skipped right after the confirmed records: nothing left to wait for
+  if (_acked_seq >= _skip_start && _acked_seq < _skip_end) {
+    ack(_skip_end - 1);
+  }
+
+  return count;
+}
+
+void SampleLog::ack(uint32_t seq) {
+  // Stale or unknown sequence numbers are ignored
+  if (!_ready || seq < _acked_seq || seq >= _next_seq) {
+    return;
+  }
+
+  _acked_seq = seq + 1;
+  // Corrupt records after the last confirmed one will never be delivered
+  if (_acked_seq >= _skip_start && _acked_seq < _skip_end) {
+    _acked_seq = _skip_end;
+  }
+  if (_read_seq < _acked_seq) {
+    _read_seq = _acked_seq;
+  }
+
+  // Segments that are fully confirmed are no longer needed
+  while (_oldest_seq / SAMPLE_LOG_SEGMENT_RECORDS < _acked_seq / SAMPLE_LOG_SEGMENT_RECORDS) {
+    uint32_t id = _oldest_seq / SAMPLE_LOG_SEGMENT_RECORDS;
+    _delete_segment(id);
+    _oldest_seq = (id + 1) * SAMPLE_LOG_SEGMENT_RECORDS;
+  }
+
+  _save_ack();
+}
+
+void SampleLog::_segment_path(char* path, uint32_t segment_id) {
+  snprintf(path, 24, SAMPLE_LOG_DIR "/%08lx", (unsigned long)segment_id);
+}
+
+bool SampleLog::_open_segment(uint32_t segment_id, bool create) {
+  if (_segment) {
+    _segment.close();
+  }
+
+  char path[24];
+  _segment_path(path, segment_id);
+  _segment = LittleFS.open(path, create ? "w" : "r+");
+  _segment_id = segment_id;
+  return (bool)_segment;
+}
+
+void SampleLog::_delete_segment(uint32_t segment_id) {
+  if (_segment && _segment_id == segment_id) {
+    _segment.close();
+  }
+
+  char path[24];
+  _segment_path(path, segment_id);
+  LittleFS.remove(path);
+}
+
+void SampleLog::_trim() {
+  // The segment just started counts; drop the oldest beyond the limit
+  uint32_t newest = _next_seq / SAMPLE_LOG_SEGMENT_RECORDS;
+  bool lost = false;
+
+  while (newest - _oldest_seq / SAMPLE_LOG_SEGMENT_RECORDS >= SAMPLE_LOG_SEGMENTS) {
+    uint32_t id = _oldest_seq / SAMPLE_LOG_SEGMENT_RECORDS;
+    uint32_t end = (id + 1) * SAMPLE_LOG_SEGMENT_RECORDS;
+    _delete_segment(id);
+
+    if (_acked_seq < end) {
+      _dropped += end - _acked_seq;
+      _acked_seq = end;
+      lost = true;
+    }
+    _oldest_seq = end;
+  }
+
+  if (_read_seq < _acked_seq) {
+    _read_seq = _acked_seq;
+  }
+  if (lost) {
+    _save_ack();
+  }
+}
+
+void SampleLog::_save_ack() {
+  File f = LittleFS.open(ACK_PATH, "w");
+  if (!f) {
+    return;
+  }
+  uint8_t buf[4];
+  telemetry_put32(buf, _acked_seq);
+  f.write(buf, 4);
+  f.close();
+}
+
+uint16_t SampleLog::_crc16(const uint8_t* data, uint8_t len) {
+  // CRC-16/CCITT-FALSE
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Flash ring log of telemetry samples (ESP32, LittleFS)
+ *
+ * Append-only log that keeps samples across outages and reboots until a
+ * consumer has confirmed them:
+ * - Fixed 32-byte records: sequence number, the TelemetryBatch sample
+ *   encoding, CRC-16
+ * - Records live in segment files of SAMPLE_LOG_SEGMENT_RECORDS each.
+ *   The sequence number alone gives the segment and offset, so there is
+ *   no index to keep. When SAMPLE_LOG_SEGMENTS are in use, the oldest
+ *   segment is deleted (the unconfirmed records in it count as dropped).
+ *   Segments are also deleted once every record in them is acknowledged,
+ *   so an empty log takes no flash.
+ * - LittleFS spreads the writes over the partition and keeps the file
+ *   consistent at the last flush; each append is flushed
+ * - read() hands out records from a read cursor without consuming them;
+ *   ack() confirms everything up to a sequence number and is persisted,
+ *   rewind() sends the cursor back to the first unconfirmed record
+ *
+ * Not thread safe: append, read and ack from one task.
+ */
+
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <Arduino.h>
+#include "TelemetryBatch.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <LittleFS.h>
+
+#define SAMPLE_LOG_RECORD_SIZE      32
+#define SAMPLE_LOG_SEGMENT_RECORDS  512   // 16 KB per segment
+#define SAMPLE_LOG_SEGMENTS         16    // 8192 records, 256 KB of flash
+#define SAMPLE_LOG_DIR              "/slog"
+
+class SampleLog {
+public:
+  SampleLog();
+
+  // Mounts LittleFS and recovers the log. A record torn by a power loss
+  // is overwritten by the next append.
+  bool begin(bool format_if_failed = true);
+
+  // Stores the sample under the next sequence number
+  bool append(const TelemetrySample& sample);
+
+  // Up to max records from the read cursor, within one segment, and
+  // advances the cursor. first_seq is the sequence number of out[0];
+  // records are consecutive. Returns 0 when there is nothing to read.
+  uint16_t read(TelemetrySample* out, uint16_t max, uint32_t& first_seq);
+
+  // Everything up to and including seq was delivered
+  void ack(uint32_t seq);
+
+  // Read cursor back to the first unconfirmed record (call after a
+  // reconnect or an ack timeout)
+  void rewind() { _read_seq = _acked_seq; }
+
+  bool ready() const { return _ready; }
+  uint32_t pending() const { return _next_seq - _acked_seq; }      // Not yet confirmed
+  uint32_t unread() const { return _next_seq - _read_seq; }        // Not yet handed out
+  uint32_t get_next_seq() const { return _next_seq; }
+  uint32_t get_acked_seq() const { return _acked_seq; }             // First unconfirmed
+  uint32_t get_dropped() const { return _dropped; }                 // Lost to the ring or CRC errors
+
+private:
+  bool _ready;
+  uint32_t _oldest_seq;   // First record still on flash
+  uint32_t _next_seq;     // Next record appended
+  uint32_t _acked_seq;    // First record not yet confirmed
+  uint32_t _read_seq;     // Next record read() hands out
+  uint32_t _dropped;
+  uint32_t _skip_start;   // Latest run of corrupt records read() skipped
+  uint32_t _skip_end;     // (end is also past every record counted dropped)
+  File _segment;          // Segment being appended to
+  uint32_t _segment_id;
+
+  static void _segment_path(char* path, uint32_t segment_id);
+  bool _open_segment(uint32_t segment_id, bool create);
+  void _delete_segment(uint32_t segment_id);
+  void _trim();
+  void _save_ack();
+  static uint16_t _crc16(const uint8_t* data, uint8_t len);
+};
+
+#endif
+
+#endif
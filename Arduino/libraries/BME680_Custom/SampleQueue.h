@@ -0,0 +1,63 @@
+/*
+ * Wait-free single-producer/single-consumer sample queue
+ *
+ * Fixed-size ring for handing samples from a sensor reader to a consumer
+ * (MQTT, HTTP, serial) running in another task or on the other core.
+ * No locks and no heap: push() and pop() each finish in a bounded number
+ * of steps whatever the other side is doing.
+ *
+ * Exactly one task may call push() and exactly one task may call pop().
+ * N must be a power of two; all N slots are usable.
+ */
+
+#ifndef SAMPLE_QUEUE_H
+#define SAMPLE_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+template <typename T, uint16_t N>
+class SampleQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleQueue size must be a power of two");
+
+public:
+  SampleQueue() : _head(0), _tail(0) {}
+
+  // Producer side; returns false (and drops the item) if the queue is full
+  bool push(const T& item) {
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    if ((uint16_t)(tail - _head.load(std::memory_order_acquire)) == N) {
+      return false;
+    }
+    _items[tail & (N - 1)] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side; returns false if the queue is empty
+  bool pop(T& item) {
+    uint16_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = _items[head & (N - 1)];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Snapshot only; the other side may change it right after
+  uint16_t size() const {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+  uint16_t capacity() const { return N; }
+
+private:
+  T _items[N];
+  // Free-running indices; the slot is index & (N - 1)
+  std::atomic<uint16_t> _head;
+  std::atomic<uint16_t> _tail;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * Telemetry sample batching
+ *
+ * Fixed-point sensor samples are collected in a preallocated ring and
+ * flushed as one versioned binary frame instead of a JSON message per
+ * sensor per reading.
+ *
+ * Frame layout (all fields little-endian):
+ *   0  uint8_t  magic[2]     'T', 'B'
+ *   2  uint8_t  version      TELEMETRY_FRAME_VERSION
+ *   3  uint8_t  sample_size  TELEMETRY_SAMPLE_SIZE
+ *   4  uint16_t count        samples in this frame
+ *   6  uint16_t dropped      samples overwritten since the last frame
+ *   8  uint32_t seq          frame sequence number
+ *  12  uint32_t uptime       ms since boot when the frame was encoded
+ *  16  samples[count]        see TelemetrySample
+ *
+ * Delta frames (encode_delta()) carry the same samples in varints:
+ *   0  uint8_t  magic[2]     'T', 'D'
+ *   2  uint8_t  version      TELEMETRY_DELTA_VERSION
+ *   3  uint8_t  schema       TELEMETRY_SCHEMA_ID
+ *   4  varint   count, dropped, seq, uptime
+ *      samples[count]
+ *
+ * Each sample is its fields in the 'TB' order, each as the zig-zag varint
+ * of its difference from the previous sample (from zero for the first),
+ * wrapped to the field's width; the timestamp as the difference from the
+ * previous time step, so a steady read interval costs one byte. The flags
+ * byte is XORed with the previous one. Varints are unsigned LEB128 (7 bits
+ * per byte, low bits first). The schema ID names the field list and units,
+ * so a decoder knows them without field names in the frame.
+ */
+
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <Arduino.h>
+
+#define TELEMETRY_FRAME_VERSION  1
+#define TELEMETRY_HEADER_SIZE    16
+#define TELEMETRY_SAMPLE_SIZE    25
+#define TELEMETRY_FRAME_SIZE(n)  (TELEMETRY_HEADER_SIZE + (n) * TELEMETRY_SAMPLE_SIZE)
+
+#define TELEMETRY_DELTA_VERSION  1
+#define TELEMETRY_SCHEMA_ID      1   // TelemetrySample fields, in the 'TB' order and units
+#define TELEMETRY_DELTA_HEADER_MAX 20
+#define TELEMETRY_DELTA_SAMPLE_MAX 33  // Every field at its longest varint
+#define TELEMETRY_DELTA_FRAME_MAX(n) (TELEMETRY_DELTA_HEADER_MAX + (n) * TELEMETRY_DELTA_SAMPLE_MAX)
+
+// Sample flags
+#define SAMPLE_SHT21_VALID   0x01
+#define SAMPLE_BME680_VALID  0x02
+#define SAMPLE_HEAT_STABLE   0x04
+#define SAMPLE_IAQ_VALID     0x08
+#define SAMPLE_SIGNIFICANT   0x10  // Published (changed enough, or heartbeat)
+
+// One reading of both sensors in fixed point
+struct TelemetrySample {
+  uint32_t timestamp;        // ms since boot
+  uint32_t bme680_pressure;  // Pa
+  uint32_t bme680_humidity;  // milli-%RH
+  uint32_t bme680_gas;       // Ohms
+  int16_t sht21_temp;        // centi-degC
+  uint16_t sht21_humidity;   // centi-%RH
+  int16_t bme680_temp;       // centi-degC
+  int16_t iaq_score;         // centi-points, -1 if not available
+  uint8_t flags;
+};
+
+// Little-endian field writers
+static inline uint8_t* telemetry_put16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+static inline uint8_t* telemetry_put32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+  return p + 4;
+}
+
+static inline uint16_t telemetry_get16(const uint8_t* p) {
+  return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t telemetry_get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// One sample in its TELEMETRY_SAMPLE_SIZE-byte wire form
+static inline uint8_t* telemetry_put_sample(uint8_t* p, const TelemetrySample& s) {
+  p = telemetry_put32(p, s.timestamp);
+  p = telemetry_put16(p, (uint16_t)s.sht21_temp);
+  p = telemetry_put16(p, s.sht21_humidity);
+  p = telemetry_put16(p, (uint16_t)s.bme680_temp);
+  p = telemetry_put32(p, s.bme680_pressure);
+  p = telemetry_put32(p, s.bme680_humidity);
+  p = telemetry_put32(p, s.bme680_gas);
+  p = telemetry_put16(p, (uint16_t)s.iaq_score);
+  *p++ = s.flags;
+  return p;
+}
+
+static inline const uint8_t* telemetry_get_sample(const uint8_t* p, TelemetrySample& s) {
+  s.timestamp = telemetry_get32(p);
+  s.sht21_temp = (int16_t)telemetry_get16(p + 4);
+  s.sht21_humidity = telemetry_get16(p + 6);
+  s.bme680_temp = (int16_t)telemetry_get16(p + 8);
+  s.bme680_pressure = telemetry_get32(p + 10);
+  s.bme680_humidity = telemetry_get32(p + 14);
+  s.bme680_gas = telemetry_get32(p + 18);
+  s.iaq_score = (int16_t)telemetry_get16(p + 22);
+  s.flags = p[24];
+  return p + TELEMETRY_SAMPLE_SIZE;
+}
+
+static inline uint8_t* telemetry_put_varint(uint8_t* p, uint32_t v) {
+  while (v >= 0x80) {
+    *p++ = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+// Small differences of either sign map to small unsigned values
+static inline uint32_t telemetry_zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline uint8_t* telemetry_put_delta16(uint8_t* p, uint16_t v, uint16_t prev) {
+  return telemetry_put_varint(p, telemetry_zigzag((int16_t)(v - prev)));
+}
+
+static inline uint8_t* telemetry_put_delta32(uint8_t* p, uint32_t v, uint32_t prev) {
+  return telemetry_put_varint(p, telemetry_zigzag((int32_t)(v - prev)));
+}
+
+// One sample in delta form; prev and step hold the previous sample and
+// time step (zero before the first) and are updated
+static inline uint8_t* telemetry_put_delta_sample(uint8_t* p, const TelemetrySample& s,
+                                                  TelemetrySample& prev, uint32_t& step) {
+  uint32_t this_step = s.timestamp - prev.timestamp;
+  p = telemetry_put_delta32(p, this_step, step);
+  p = telemetry_put_delta16(p, (uint16_t)s.sht21_temp, (uint16_t)prev.sht21_temp);
+  p = telemetry_put_delta16(p, s.sht21_humidity, prev.sht21_humidity);
+  p = telemetry_put_delta16(p, (uint16_t)s.bme680_temp, (uint16_t)prev.bme680_temp);
+  p = telemetry_put_delta32(p, s.bme680_pressure, prev.bme680_pressure);
+  p = telemetry_put_delta32(p, s.bme680_humidity, prev.bme680_humidity);
+  p = telemetry_put_delta32(p, s.bme680_gas, prev.bme680_gas);
+  p = telemetry_put_delta16(p, (uint16_t)s.iaq_score, (uint16_t)prev.iaq_score);
+  *p++ = s.flags ^ prev.flags;
+
+  prev = s;
+  step = this_step;
+  return p;
+}
+
+template <uint16_t N>
+class TelemetryBatch {
+public:
+  // constexpr so a batch in RTC_DATA_ATTR memory is not cleared by a
+  // constructor on every wake from deep sleep
+  constexpr TelemetryBatch() : _samples{}, _head(0), _count(0), _dropped(0), _first_time(0) {}
+
+  // Adds a sample, overwriting the oldest one when the ring is full
+  void push(const TelemetrySample& sample) {
+    if (_count == 0) {
+      _first_time = sample.timestamp;
+    }
+
+    _samples[_head] = sample;
+    _head = (_head + 1) % N;
+
+    if (_count < N) {
+      _count++;
+    } else {
+      _dropped++;
+    }
+  }
+
+  uint16_t size() const { return _count; }
+  uint16_t capacity() const { return N; }
+  bool full() const { return _count == N; }
+
+  // True when max_samples are queued or the oldest sample is interval_ms old
+  bool due(unsigned long now, uint16_t max_samples, unsigned long interval_ms) const {
+    if (_count == 0) return false;
+    return _count >= max_samples || (now - _first_time) >= interval_ms;
+  }
+
+  // Writes the frame into out; returns its length, 0 if out is too small.
+  // uptime is the header's time stamp, on the same clock as the samples.
+  size_t encode(uint8_t* out, size_t capacity, uint32_t seq) const {
+    return encode(out, capacity, seq, millis());
+  }
+
+  size_t encode(uint8_t* out, size_t capacity, uint32_t seq, uint32_t uptime) const {
+    size_t len = TELEMETRY_FRAME_SIZE(_count);
+    if (capacity < len) return 0;
+
+    uint8_t* p = out;
+    *p++ = 'T';
+    *p++ = 'B';
+    *p++ = TELEMETRY_FRAME_VERSION;
+    *p++ = TELEMETRY_SAMPLE_SIZE;
+    p = telemetry_put16(p, _count);
+    p = telemetry_put16(p, _dropped);
+    p = telemetry_put32(p, seq);
+    p = telemetry_put32(p, uptime);
+
+    // Oldest sample first
+    uint16_t idx = (_head + N - _count) % N;
+    for (uint16_t i = 0; i < _count; i++) {
+      p = telemetry_put_sample(p, _samples[idx]);
+      idx = (idx + 1) % N;
+    }
+
+    return len;
+  }
+
+  // Same samples as a delta frame (see the top of this file); returns its
+  // length, 0 if out is too small. TELEMETRY_DELTA_FRAME_MAX(size()) always
+  // fits; slowly changing readings take a fraction of that.
+  size_t encode_delta(uint8_t* out, size_t capacity, uint32_t seq) const {
+    return encode_delta(out, capacity, seq, millis());
+  }
+
+  size_t encode_delta(uint8_t* out, size_t capacity, uint32_t seq, uint32_t uptime) const {
+    if (capacity < TELEMETRY_DELTA_HEADER_MAX) return 0;
+
+    uint8_t* p = out;
+    *p++ = 'T';
+    *p++ = 'D';
+    *p++ = TELEMETRY_DELTA_VERSION;
+    *p++ = TELEMETRY_SCHEMA_ID;
+    p = telemetry_put_varint(p, _count);
+    p = telemetry_put_varint(p, _dropped);
+    p = telemetry_put_varint(p, seq);
+    p = telemetry_put_varint(p, uptime);
+
+    TelemetrySample prev = {};
+    uint32_t step = 0;
+    uint16_t idx = (_head + N - _count) % N;
+    for (uint16_t i = 0; i < _count; i++) {
+      if ((size_t)(out + capacity - p) < TELEMETRY_DELTA_SAMPLE_MAX) return 0;
+      p = telemetry_put_delta_sample(p, _samples[idx], prev, step);
+      idx = (idx + 1) % N;
+    }
+
+    return p - out;
+  }
+
+  void clear() {
+    _count = 0;
+    _dropped = 0;
+  }
+
+  // Oldest queued sample (size() must be > 0), for publishing one at a time
+  const TelemetrySample& oldest() const {
+    return _samples[(_head + N - _count) % N];
+  }
+
+  void drop_oldest() {
+    if (_count == 0) return;
+    _count--;
+    if (_count > 0) {
+      _first_time = oldest().timestamp;
+    }
+  }
+
+private:
+  TelemetrySample _samples[N];
+  uint16_t _head;
+  uint16_t _count;
+  uint16_t _dropped;
+  unsigned long _first_time;
+};
+
+#endif
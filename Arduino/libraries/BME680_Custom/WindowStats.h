@@ -0,0 +1,220 @@
+/*
+ * Streaming window statistics
+ *
+ * Per-channel count/min/max/mean/stddev with O(1) work per sample and
+ * fixed storage, so a node can publish one summary per window instead
+ * of every reading:
+ * - RunningStats: tumbling windows. Welford's update for mean and
+ *   variance, no sample storage. reset() starts the next window.
+ * - SlidingStats<N>: the last N samples. Each add() folds the new sample
+ *   in and the oldest out of the Welford sums, and keeps min/max in
+ *   monotonic queues. The sums are recomputed exactly once every N
+ *   samples, and when an outlier leaves, so float rounding can't build up.
+ *
+ * Values are the integer fixed-point units the sketch already uses
+ * (centi-degC, Pa, Ohms, ...). Sums are kept relative to the first
+ * sample, so float precision goes to the variation, not to the offset
+ * (e.g. 101325 Pa). Not thread safe.
+ */
+
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <Arduino.h>
+#include <math.h>
+
+// Window result in channel units
+struct WindowSummary {
+  int32_t min;
+  int32_t max;
+  int32_t mean;
+  uint32_t stddev;   // Sample standard deviation, 0 below two samples
+  uint16_t count;
+};
+
+class RunningStats {
+public:
+  RunningStats() { reset(); }
+
+  void reset() {
+    _count = 0;
+    _offset = 0;
+    _mean = 0.0f;
+    _m2 = 0.0f;
+    _min = INT32_MAX;
+    _max = INT32_MIN;
+  }
+
+  void add(int32_t value) {
+    if (_count == 0) {
+      _offset = value;
+    }
+    _count++;
+
+    float x = (float)(value - _offset);
+    float delta = x - _mean;
+    _mean += delta / _count;
+    _m2 += delta * (x - _mean);
+
+    if (value < _min) _min = value;
+    if (value > _max) _max = value;
+  }
+
+  uint16_t count() const { return _count; }
+  float mean() const { return _offset + _mean; }
+  float variance() const { return _count > 1 ? _m2 / (_count - 1) : 0.0f; }
+  float stddev() const { return sqrtf(variance()); }
+  int32_t min() const { return _min; }
+  int32_t max() const { return _max; }
+
+  // All zero for an empty window
+  void summary(WindowSummary& s) const {
+    s.count = _count;
+    s.min = _count ? _min : 0;
+    s.max = _count ? _max : 0;
+    s.mean = _count ? _offset + (int32_t)lroundf(_mean) : 0;
+    s.stddev = (uint32_t)lroundf(stddev());
+  }
+
+private:
+  uint16_t _count;
+  int32_t _offset;  // First sample of the window
+  float _mean;      // Relative to _offset
+  float _m2;
+  int32_t _min;
+  int32_t _max;
+};
+
+template <uint16_t N>
+class SlidingStats {
+  static_assert(N >= 2, "SlidingStats needs at least two samples");
+
+public:
+  SlidingStats() { reset(); }
+
+  void reset() {
+    _count = 0;
+    _head = 0;
+    _seq = 0;
+    _offset = 0;
+    _mean = 0.0f;
+    _m2 = 0.0f;
+    _min_q.clear();
+    _max_q.clear();
+  }
+
+  void add(int32_t value) {
+    if (_count == 0) {
+      _offset = value;
+    }
+    float x = (float)(value - _offset);
+    bool resum = false;
+
+    if (_count < N) {
+      _count++;
+      float delta = x - _mean;
+      _mean += delta / _count;
+      _m2 += delta * (x - _mean);
+    } else {
+      // Replace the oldest sample in the running sums
+      float old = (float)(_values[_head] - _offset);
+      float old_mean = _mean;
+      _mean += (x - old) / N;
+      _m2 += (x - old) * (x - _mean + old - old_mean);
+      if (_m2 < 0.0f) _m2 = 0.0f;
+
+      // An outlier leaving the window takes most of _m2 with it, and the
+      // remainder would be mostly rounding: recompute
+      float dev = old - old_mean;
+      resum = dev * dev > _m2;
+    }
+    _values[_head] = value;
+    _head = (_head + 1) % N;
+    _seq++;
+
+    // Expire first: a full queue has no slot for the new value
+    _min_q.expire(_seq, N);
+    _max_q.expire(_seq, N);
+    _min_q.push(_seq, value, false);
+    _max_q.push(_seq, value, true);
+
+    if (resum || (_count == N && _head == 0)) {
+      _resum();
+    }
+  }
+
+  uint16_t count() const { return _count; }
+  float mean() const { return _offset + _mean; }
+  float variance() const { return _count > 1 ? _m2 / (_count - 1) : 0.0f; }
+  float stddev() const { return sqrtf(variance()); }
+  int32_t min() const { return _min_q.front(); }
+  int32_t max() const { return _max_q.front(); }
+
+  void summary(WindowSummary& s) const {
+    s.count = _count;
+    s.min = _count ? min() : 0;
+    s.max = _count ? max() : 0;
+    s.mean = _count ? _offset + (int32_t)lroundf(_mean) : 0;
+    s.stddev = (uint32_t)lroundf(stddev());
+  }
+
+private:
+  // Window values in arrival order, keeping only those that can still
+  // become the minimum (or maximum); the current one is at the front
+  struct MonotonicQueue {
+    uint32_t seq[N];
+    int32_t value[N];
+    uint16_t head;
+    uint16_t size;
+
+    void clear() { head = 0; size = 0; }
+
+    void push(uint32_t s, int32_t v, bool keep_max) {
+      while (size > 0) {
+        int32_t back = value[(head + size - 1) % N];
+        if (keep_max ? back > v : back < v) break;
+        size--;
+      }
+      uint16_t slot = (head + size) % N;
+      seq[slot] = s;
+      value[slot] = v;
+      size++;
+    }
+
+    void expire(uint32_t newest, uint16_t window) {
+      while (size > 0 && newest - seq[head] >= window) {
+        head = (head + 1) % N;
+        size--;
+      }
+    }
+
+    int32_t front() const { return size ? value[head] : 0; }
+  };
+
+  int32_t _values[N];
+  uint16_t _count;
+  uint16_t _head;    // Next slot to overwrite (the oldest once full)
+  uint32_t _seq;
+  int32_t _offset;
+  float _mean;
+  float _m2;
+  MonotonicQueue _min_q;
+  MonotonicQueue _max_q;
+
+  void _resum() {
+    // Exact two-pass sums over the ring, relative to the current mean
+    _offset = (int32_t)lroundf(mean());
+    float sum = 0.0f;
+    for (uint16_t i = 0; i < N; i++) {
+      sum += (float)(_values[i] - _offset);
+    }
+    _mean = sum / N;
+    _m2 = 0.0f;
+    for (uint16_t i = 0; i < N; i++) {
+      float d = (float)(_values[i] - _offset) - _mean;
+      _m2 += d * d;
+    }
+  }
+};
+
+#endif
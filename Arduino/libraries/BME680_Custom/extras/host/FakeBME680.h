@@ -0,0 +1,80 @@
+/*
+ * Simulated BME680 on the Wire mock
+ *
+ * A 256-byte register file loaded from a RegisterDump. Writes are
+ * register/value pairs (a lone byte only sets the register pointer) and
+ * reads auto-increment from the pointer, as on the chip. Writing the soft
+ * reset command reloads the dump and clears the control registers; a
+ * forced-mode write to ctrl_meas "converts" instantly: the next field
+ * snapshot of the dump is copied to 0x1D-0x2D and the mode drops back to
+ * sleep. Snapshots repeat once all have been used.
+ */
+
+#ifndef FAKE_BME680_H
+#define FAKE_BME680_H
+
+#include <Wire.h>
+#include "BME680_Custom.h"
+#include "register_dumps.h"
+
+class FakeBME680 : public I2CDevice {
+public:
+  FakeBME680(const RegisterDump& dump) { load(dump); }
+
+  void load(const RegisterDump& dump) {
+    _dump = &dump;
+    memcpy(_regs, dump.image, sizeof(_regs));
+    _ptr = 0;
+    _conversions = 0;
+  }
+
+  void write(const uint8_t* data, size_t len) override {
+    if (len == 1) {
+      _ptr = data[0];
+      return;
+    }
+    for (size_t i = 0; i + 1 < len; i += 2) {
+      _write_reg(data[i], data[i + 1]);
+    }
+  }
+
+  size_t read(uint8_t* data, size_t len) override {
+    for (size_t i = 0; i < len; i++) {
+      data[i] = _regs[_ptr++];
+    }
+    return len;
+  }
+
+  uint8_t reg(uint8_t addr) const { return _regs[addr]; }
+  void set_reg(uint8_t addr, uint8_t value) { _regs[addr] = value; }
+
+  // Forced conversions run so far
+  uint32_t conversions() const { return _conversions; }
+
+private:
+  const RegisterDump* _dump;
+  uint8_t _regs[256];
+  uint8_t _ptr;
+  uint32_t _conversions;
+
+  void _write_reg(uint8_t addr, uint8_t value) {
+    if (addr == SOFT_RESET_ADDR) {
+      if (value == SOFT_RESET_CMD) {
+        memcpy(_regs, _dump->image, sizeof(_regs));
+        memset(&_regs[0x50], 0, 0x76 - 0x50);
+      }
+      return;
+    }
+
+    _regs[addr] = value;
+    if (addr == CONF_T_P_MODE_ADDR && (value & MODE_MSK) == FORCED_MODE) {
+      if (_dump->field_count > 0) {
+        memcpy(&_regs[FIELD0_ADDR], _dump->fields[_conversions % _dump->field_count], FIELD_LENGTH);
+      }
+      _regs[addr] &= ~MODE_MSK;
+      _conversions++;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Bosch BME680 SensorAPI integer compensation, transcribed for the harness
+ *
+ * Independent of the driver: coefficients are parsed from the raw bytes
+ * with the SensorAPI offsets, and each formula follows the SensorAPI
+ * integer path (bme680.c, bme68x.c for the high gas variant) statement
+ * for statement. Two deliberate departures, both matching the driver:
+ * - pressure returns 0 when var1 is zero instead of dividing by it
+ *   (all-zero coefficients)
+ * - the (p >> 8)^3 * p10 term is computed in 64 bits. SensorAPI uses 32
+ *   bits, which gives the same result whenever it doesn't overflow.
+ */
+
+#ifndef BOSCH_REFERENCE_H
+#define BOSCH_REFERENCE_H
+
+#include <stdint.h>
+
+struct BoschCalib {
+  uint16_t par_t1;
+  int16_t par_t2;
+  int8_t par_t3;
+  uint16_t par_p1;
+  int16_t par_p2;
+  int8_t par_p3;
+  int16_t par_p4;
+  int16_t par_p5;
+  int8_t par_p6;
+  int8_t par_p7;
+  int16_t par_p8;
+  int16_t par_p9;
+  uint8_t par_p10;
+  uint16_t par_h1;
+  uint16_t par_h2;
+  int8_t par_h3;
+  int8_t par_h4;
+  int8_t par_h5;
+  uint8_t par_h6;
+  int8_t par_h7;
+  int8_t par_gh1;
+  int16_t par_gh2;
+  int8_t par_gh3;
+  uint8_t res_heat_range;
+  int8_t res_heat_val;
+  int8_t range_sw_err;
+  int32_t t_fine;
+};
+
+#define BOSCH_CONCAT_BYTES(msb, lsb) (((uint16_t)(msb) << 8) | (uint16_t)(lsb))
+
+// coeff: 25 bytes from 0x89, then 16 from 0xE1; the other three are the
+// registers at 0x02, 0x00 and 0x04
+static inline void bosch_parse_calib(const uint8_t* coeff, uint8_t res_heat_range, uint8_t res_heat_val,
+                                     uint8_t range_sw_err, BoschCalib& c) {
+  c.par_t1 = (uint16_t)(BOSCH_CONCAT_BYTES(coeff[34], coeff[33]));
+  c.par_t2 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[2], coeff[1]));
+  c.par_t3 = (int8_t)(coeff[3]);
+
+  c.par_p1 = (uint16_t)(BOSCH_CONCAT_BYTES(coeff[6], coeff[5]));
+  c.par_p2 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[8], coeff[7]));
+  c.par_p3 = (int8_t)coeff[9];
+  c.par_p4 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[12], coeff[11]));
+  c.par_p5 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[14], coeff[13]));
+  c.par_p6 = (int8_t)(coeff[16]);
+  c.par_p7 = (int8_t)(coeff[15]);
+  c.par_p8 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[20], coeff[19]));
+  c.par_p9 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[22], coeff[21]));
+  c.par_p10 = (uint8_t)(coeff[23]);
+
+  c.par_h1 = (uint16_t)(((uint16_t)coeff[27] << 4) | (coeff[26] & 0x0F));
+  c.par_h2 = (uint16_t)(((uint16_t)coeff[25] << 4) | ((coeff[26]) >> 4));
+  c.par_h3 = (int8_t)coeff[28];
+  c.par_h4 = (int8_t)coeff[29];
+  c.par_h5 = (int8_t)coeff[30];
+  c.par_h6 = (uint8_t)coeff[31];
+  c.par_h7 = (int8_t)coeff[32];
+
+  c.par_gh1 = (int8_t)coeff[37];
+  c.par_gh2 = (int16_t)(BOSCH_CONCAT_BYTES(coeff[36], coeff[35]));
+  c.par_gh3 = (int8_t)coeff[38];
+
+  c.res_heat_range = (res_heat_range & 0x30) / 16;
+  c.res_heat_val = (int8_t)res_heat_val;
+  c.range_sw_err = ((int8_t)range_sw_err & (int8_t)0xF0) / 16;
+
+  c.t_fine = 0;
+}
+
+static inline int16_t bosch_calc_temperature(uint32_t temp_adc, BoschCalib& c) {
+  int64_t var1;
+  int64_t var2;
+  int64_t var3;
+  int16_t calc_temp;
+
+  var1 = ((int32_t)temp_adc >> 3) - ((int32_t)c.par_t1 << 1);
+  var2 = (var1 * (int32_t)c.par_t2) >> 11;
+  var3 = ((var1 >> 1) * (var1 >> 1)) >> 12;
+  var3 = ((var3) * ((int32_t)c.par_t3 << 4)) >> 14;
+  c.t_fine = (int32_t)(var2 + var3);
+  calc_temp = (int16_t)(((c.t_fine * 5) + 128) >> 8);
+
+  return calc_temp;
+}
+
+static inline uint32_t bosch_calc_pressure(uint32_t pres_adc, const BoschCalib& c) {
+  int32_t var1;
+  int32_t var2;
+  int32_t var3;
+  int32_t pressure_comp;
+
+  var1 = (((int32_t)c.t_fine) >> 1) - 64000;
+  var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)c.par_p6) >> 2;
+  var2 = var2 + ((var1 * (int32_t)c.par_p5) << 1);
+  var2 = (var2 >> 2) + ((int32_t)c.par_p4 << 16);
+  var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * ((int32_t)c.par_p3 << 5)) >> 3) +
+         (((int32_t)c.par_p2 * var1) >> 1);
+  var1 = var1 >> 18;
+  var1 = ((32768 + var1) * (int32_t)c.par_p1) >> 15;
+  if (var1 == 0) {
+    return 0;
+  }
+  pressure_comp = 1048576 - pres_adc;
+  pressure_comp = (int32_t)((pressure_comp - (var2 >> 12)) * ((uint32_t)3125));
+  if (pressure_comp >= (int32_t)0x40000000) {
+    pressure_comp = ((pressure_comp / var1) << 1);
+  } else {
+    pressure_comp = ((pressure_comp << 1) / var1);
+  }
+  var1 = ((int32_t)c.par_p9 * (int32_t)(((pressure_comp >> 3) * (pressure_comp >> 3)) >> 13)) >> 12;
+  var2 = ((int32_t)(pressure_comp >> 2) * (int32_t)c.par_p8) >> 13;
+  var3 = (int32_t)(((int64_t)(pressure_comp >> 8) * (int64_t)(pressure_comp >> 8) *
+                    (int64_t)(pressure_comp >> 8) * (int64_t)c.par_p10) >> 17);
+
+  pressure_comp = (int32_t)(pressure_comp) + ((var1 + var2 + var3 + ((int32_t)c.par_p7 << 7)) >> 4);
+
+  return (uint32_t)pressure_comp;
+}
+
+static inline uint32_t bosch_calc_humidity(uint16_t hum_adc, const BoschCalib& c) {
+  int32_t var1;
+  int32_t var2;
+  int32_t var3;
+  int32_t var4;
+  int32_t var5;
+  int32_t var6;
+  int32_t temp_scaled;
+  int32_t calc_hum;
+
+  temp_scaled = (((int32_t)c.t_fine * 5) + 128) >> 8;
+  var1 = (int32_t)(hum_adc - ((int32_t)((int32_t)c.par_h1 * 16))) -
+         (((temp_scaled * (int32_t)c.par_h3) / ((int32_t)100)) >> 1);
+  var2 = ((int32_t)c.par_h2 *
+          (((temp_scaled * (int32_t)c.par_h4) / ((int32_t)100)) +
+           (((temp_scaled * ((temp_scaled * (int32_t)c.par_h5) / ((int32_t)100))) >> 6) / ((int32_t)100)) +
+           (int32_t)(1 << 14))) >> 10;
+  var3 = var1 * var2;
+  var4 = (int32_t)c.par_h6 << 7;
+  var4 = ((var4) + ((temp_scaled * (int32_t)c.par_h7) / ((int32_t)100))) >> 4;
+  var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
+  var6 = (var4 * var5) >> 1;
+  calc_hum = (((var3 + var6) >> 10) * ((int32_t)1000)) >> 12;
+
+  if (calc_hum > 100000) {
+    calc_hum = 100000;
+  } else if (calc_hum < 0) {
+    calc_hum = 0;
+  }
+
+  return (uint32_t)calc_hum;
+}
+
+// Low gas variant (BME680)
+static inline uint32_t bosch_calc_gas_resistance_low(uint16_t gas_res_adc, uint8_t gas_range, const BoschCalib& c) {
+  static const uint32_t lookup_table1[16] = {
+    UINT32_C(2147483647), UINT32_C(2147483647), UINT32_C(2147483647), UINT32_C(2147483647),
+    UINT32_C(2147483647), UINT32_C(2126008810), UINT32_C(2147483647), UINT32_C(2130303777),
+    UINT32_C(2147483647), UINT32_C(2147483647), UINT32_C(2143188679), UINT32_C(2136746228),
+    UINT32_C(2147483647), UINT32_C(2126008810), UINT32_C(2147483647), UINT32_C(2147483647)
+  };
+  static const uint32_t lookup_table2[16] = {
+    UINT32_C(4096000000), UINT32_C(2048000000), UINT32_C(1024000000), UINT32_C(512000000),
+    UINT32_C(255744255), UINT32_C(127110228), UINT32_C(64000000), UINT32_C(32258064),
+    UINT32_C(16016016), UINT32_C(8000000), UINT32_C(4000000), UINT32_C(2000000),
+    UINT32_C(1000000), UINT32_C(500000), UINT32_C(250000), UINT32_C(125000)
+  };
+  int64_t var1;
+  uint64_t var2;
+  int64_t var3;
+  uint32_t calc_gas_res;
+
+  var1 = (int64_t)((1340 + (5 * (int64_t)c.range_sw_err)) * ((int64_t)lookup_table1[gas_range])) >> 16;
+  var2 = (((int64_t)((int64_t)gas_res_adc << 15) - (int64_t)(16777216)) + var1);
+  var3 = (((int64_t)lookup_table2[gas_range] * (int64_t)var1) >> 9);
+  calc_gas_res = (uint32_t)((var3 + ((int64_t)var2 >> 1)) / (int64_t)var2);
+
+  return calc_gas_res;
+}
+
+// High gas variant (BME688 style, bme68x.c)
+static inline uint32_t bosch_calc_gas_resistance_high(uint16_t gas_res_adc, uint8_t gas_range) {
+  uint32_t calc_gas_res;
+  uint32_t var1 = UINT32_C(262144) >> gas_range;
+  int32_t var2 = (int32_t)gas_res_adc - INT32_C(512);
+
+  var2 *= INT32_C(3);
+  var2 = INT32_C(4096) + var2;
+
+  calc_gas_res = (UINT32_C(10000) * var1) / (uint32_t)var2;
+  calc_gas_res = calc_gas_res * 100;
+
+  return calc_gas_res;
+}
+
+// amb_temp in degC; SensorAPI clamps only the top (the driver also clamps
+// below 200 degC)
+static inline uint8_t bosch_calc_heater_res(uint16_t temp, int8_t amb_temp, const BoschCalib& c) {
+  uint8_t heatr_res;
+  int32_t var1;
+  int32_t var2;
+  int32_t var3;
+  int32_t var4;
+  int32_t var5;
+  int32_t heatr_res_x100;
+
+  if (temp > 400) {
+    temp = 400;
+  }
+
+  var1 = (((int32_t)amb_temp * c.par_gh3) / 1000) * 256;
+  var2 = (c.par_gh1 + 784) * (((((c.par_gh2 + 154009) * temp * 5) / 100) + 3276800) / 10);
+  var3 = var1 + (var2 / 2);
+  var4 = (var3 / (c.res_heat_range + 4));
+  var5 = (131 * c.res_heat_val) + 65536;
+  heatr_res_x100 = (int32_t)(((var4 / var5) - 250) * 34);
+  heatr_res = (uint8_t)((heatr_res_x100 + 50) / 100);
+
+  return heatr_res;
+}
+
+static inline uint8_t bosch_calc_heater_dur(uint16_t dur) {
+  uint8_t factor = 0;
+  uint8_t durval;
+
+  if (dur >= 0xfc0) {
+    durval = 0xff;
+  } else {
+    while (dur > 0x3F) {
+      dur = dur / 4;
+      factor += 1;
+    }
+    durval = (uint8_t)(dur + (factor * 64));
+  }
+
+  return durval;
+}
+
+#endif
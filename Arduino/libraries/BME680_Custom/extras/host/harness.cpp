@@ -0,0 +1,919 @@
+/*
+ * Host harness for the BME680_Custom compensation math
+ *
+ *   bme680_host           coefficient parsing, golden values through the
+ *                         full begin()/get_sensor_data() path, a
+ *                         randomized differential sweep of every kernel
+ *                         against bosch_reference.h, and BME680<Variant>
+ *                         against the run-time driver, and the
+ *                         SlidingStats window min/max
+ *   bme680_host --bench   ns per compensation kernel, per fetch() and per
+ *                         frame of compensate_batch(), and I2C traffic per
+ *                         begin() and per sample
+ *   bme680_host --golden  golden rows for every dump, from the reference
+ *
+ * --seed N changes the sweep's inputs. Exits non-zero on any mismatch.
+ */
+
+#include <chrono>
+#include "BME680_Custom.h"
+#include "FakeBME680.h"
+#include "bosch_reference.h"
+#include "register_dumps.h"
+#include "WindowStats.h"
+
+#define SENSOR_ADDR BME680_I2C_ADDR_PRIMARY
+
+// Sweep sizes
+#define SWEEP_COEFF_SETS   500
+#define SWEEP_ADC_SAMPLES  2000
+#define SWEEP_BATCH_FRAMES 37
+
+// Mismatches printed per check before going quiet
+#define MAX_REPORTED 5
+
+// ===== Access to driver internals (friend of BME680_Custom) =====
+
+class BME680HostHarness {
+public:
+  static const CalibrationData& cal(BME680_Custom& s) { return s._cal; }
+  static int32_t t_fine(BME680_Custom& s) { return s._cal.t_fine; }
+  static uint8_t variant(BME680_Custom& s) { return s._variant; }
+
+  static void set_cal(BME680_Custom& s, const BoschCalib& c, uint8_t variant) {
+    CalibrationData& d = s._cal;
+    d.par_t1 = c.par_t1;
+    d.par_t2 = c.par_t2;
+    d.par_t3 = c.par_t3;
+    d.par_p1 = c.par_p1;
+    d.par_p2 = c.par_p2;
+    d.par_p3 = c.par_p3;
+    d.par_p4 = c.par_p4;
+    d.par_p5 = c.par_p5;
+    d.par_p6 = c.par_p6;
+    d.par_p7 = c.par_p7;
+    d.par_p8 = c.par_p8;
+    d.par_p9 = c.par_p9;
+    d.par_p10 = c.par_p10;
+    d.par_h1 = c.par_h1;
+    d.par_h2 = c.par_h2;
+    d.par_h3 = c.par_h3;
+    d.par_h4 = c.par_h4;
+    d.par_h5 = c.par_h5;
+    d.par_h6 = c.par_h6;
+    d.par_h7 = c.par_h7;
+    d.par_gh1 = c.par_gh1;
+    d.par_gh2 = c.par_gh2;
+    d.par_gh3 = c.par_gh3;
+    d.res_heat_range = c.res_heat_range;
+    d.res_heat_val = c.res_heat_val;
+    d.range_sw_err = c.range_sw_err;
+    d.t_fine = 0;
+    s._variant = variant;
+    s._cal_valid = true;
+  }
+
+  static void set_ambient(BME680_Custom& s, int32_t degc) { s._ambient_temperature = degc; }
+
+  static int32_t temperature(BME680_Custom& s, uint32_t adc) { return s._calc_temperature(adc); }
+  static uint32_t pressure(BME680_Custom& s, uint32_t adc) { return s._calc_pressure(adc); }
+  static uint32_t humidity(BME680_Custom& s, uint16_t adc) { return s._calc_humidity(adc); }
+  static uint32_t gas(BME680_Custom& s, uint16_t adc, uint8_t range) { return s._calc_gas_resistance(adc, range); }
+  static uint8_t heater_res(BME680_Custom& s, uint16_t temp) { return s._calc_heater_resistance(temp); }
+  static uint8_t heater_dur(BME680_Custom& s, uint16_t dur) { return s._calc_heater_duration(dur); }
+  static void parse_field(BME680_Custom& s, const uint8_t* regs) { s._parse_field_data(regs); }
+
+  template <uint8_t Variant>
+  static void parse_field(BME680_Custom& s, const uint8_t* regs) { s._parse_field_data<Variant>(regs); }
+
+  // fetch() as if poll() had seen the new-data bit
+  static bool fetch(BME680_Custom& s) {
+    s._meas_state = MEAS_READY;
+    return s.fetch();
+  }
+
+  template <uint8_t Variant>
+  static bool fetch(BME680<Variant>& s) {
+    s._meas_state = MEAS_READY;
+    return s.fetch();
+  }
+};
+
+typedef BME680HostHarness H;
+
+// ===== Checks =====
+
+static uint32_t failures = 0;
+static uint32_t checks = 0;
+
+struct CheckGroup {
+  const char* name;
+  uint32_t failed;
+  uint32_t total;
+};
+
+static CheckGroup begin_group(const char* name) {
+  CheckGroup g = { name, 0, 0 };
+  return g;
+}
+
+static bool check(CheckGroup& g, bool ok) {
+  g.total++;
+  checks++;
+  if (!ok) {
+    g.failed++;
+    failures++;
+  }
+  return ok || g.failed > MAX_REPORTED;
+}
+
+static void end_group(const CheckGroup& g) {
+  printf("%-28s %s  %u checks", g.name, g.failed ? "FAIL" : "ok  ", g.total);
+  if (g.failed) {
+    printf(", %u failed", g.failed);
+  }
+  printf("\n");
+}
+
+// ===== Random inputs =====
+
+static uint32_t rng_state = 0x680C0DE;
+
+static uint32_t rng() {
+  // xorshift32
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+// ===== Helpers =====
+
+static void reference_calib(const uint8_t* image, BoschCalib& c) {
+  uint8_t coeff[COEFF_ADDR1_LEN + COEFF_ADDR2_LEN];
+  memcpy(coeff, &image[COEFF_ADDR1], COEFF_ADDR1_LEN);
+  memcpy(coeff + COEFF_ADDR1_LEN, &image[COEFF_ADDR2], COEFF_ADDR2_LEN);
+  bosch_parse_calib(coeff, image[ADDR_RES_HEAT_RANGE_ADDR], image[ADDR_RES_HEAT_VAL_ADDR],
+                    image[ADDR_RANGE_SW_ERR_ADDR], c);
+}
+
+static bool same_calib(const CalibrationData& d, const BoschCalib& c) {
+  return d.par_t1 == c.par_t1 && d.par_t2 == c.par_t2 && d.par_t3 == c.par_t3 &&
+         d.par_p1 == c.par_p1 && d.par_p2 == c.par_p2 && d.par_p3 == c.par_p3 &&
+         d.par_p4 == c.par_p4 && d.par_p5 == c.par_p5 && d.par_p6 == c.par_p6 &&
+         d.par_p7 == c.par_p7 && d.par_p8 == c.par_p8 && d.par_p9 == c.par_p9 &&
+         d.par_p10 == c.par_p10 &&
+         d.par_h1 == c.par_h1 && d.par_h2 == c.par_h2 && d.par_h3 == c.par_h3 &&
+         d.par_h4 == c.par_h4 && d.par_h5 == c.par_h5 && d.par_h6 == c.par_h6 &&
+         d.par_h7 == c.par_h7 &&
+         d.par_gh1 == c.par_gh1 && d.par_gh2 == c.par_gh2 && d.par_gh3 == c.par_gh3 &&
+         d.res_heat_range == c.res_heat_range && d.res_heat_val == c.res_heat_val &&
+         d.range_sw_err == c.range_sw_err;
+}
+
+static void print_calib(const char* label, const BoschCalib& c) {
+  printf("    %s: t %u %d %d  p %u %d %d %d %d %d %d %d %d %u  h %u %u %d %d %d %u %d  "
+         "gh %d %d %d  heat %u %d  sw %d\n",
+         label, c.par_t1, c.par_t2, c.par_t3,
+         c.par_p1, c.par_p2, c.par_p3, c.par_p4, c.par_p5, c.par_p6, c.par_p7, c.par_p8, c.par_p9, c.par_p10,
+         c.par_h1, c.par_h2, c.par_h3, c.par_h4, c.par_h5, c.par_h6, c.par_h7,
+         c.par_gh1, c.par_gh2, c.par_gh3, c.res_heat_range, c.res_heat_val, c.range_sw_err);
+}
+
+static void driver_calib(BME680_Custom& s, BoschCalib& c) {
+  const CalibrationData& d = H::cal(s);
+  c.par_t1 = d.par_t1;
+  c.par_t2 = d.par_t2;
+  c.par_t3 = d.par_t3;
+  c.par_p1 = d.par_p1;
+  c.par_p2 = d.par_p2;
+  c.par_p3 = d.par_p3;
+  c.par_p4 = d.par_p4;
+  c.par_p5 = d.par_p5;
+  c.par_p6 = d.par_p6;
+  c.par_p7 = d.par_p7;
+  c.par_p8 = d.par_p8;
+  c.par_p9 = d.par_p9;
+  c.par_p10 = d.par_p10;
+  c.par_h1 = d.par_h1;
+  c.par_h2 = d.par_h2;
+  c.par_h3 = d.par_h3;
+  c.par_h4 = d.par_h4;
+  c.par_h5 = d.par_h5;
+  c.par_h6 = d.par_h6;
+  c.par_h7 = d.par_h7;
+  c.par_gh1 = d.par_gh1;
+  c.par_gh2 = d.par_gh2;
+  c.par_gh3 = d.par_gh3;
+  c.res_heat_range = d.res_heat_range;
+  c.res_heat_val = d.res_heat_val;
+  c.range_sw_err = d.range_sw_err;
+  c.t_fine = d.t_fine;
+}
+
+// Reference result for one field block
+static void reference_reading(const uint8_t* regs, uint8_t variant, BoschCalib& c, SensorDataFixed& out) {
+  uint32_t adc_pres = ((uint32_t)regs[2] << 12) | ((uint32_t)regs[3] << 4) | (regs[4] >> 4);
+  uint32_t adc_temp = ((uint32_t)regs[5] << 12) | ((uint32_t)regs[6] << 4) | (regs[7] >> 4);
+  uint16_t adc_hum = ((uint16_t)regs[8] << 8) | regs[9];
+  const uint8_t* gas = (variant == 0x01) ? &regs[15] : &regs[13];
+  uint16_t adc_gas = ((uint16_t)gas[0] << 2) | (gas[1] >> 6);
+  uint8_t gas_range = gas[1] & 0x0F;
+
+  out.temperature = bosch_calc_temperature(adc_temp, c);
+  out.pressure = bosch_calc_pressure(adc_pres, c);
+  out.humidity = bosch_calc_humidity(adc_hum, c);
+  out.gas_resistance = (variant == 0x01) ? bosch_calc_gas_resistance_high(adc_gas, gas_range)
+                                         : bosch_calc_gas_resistance_low(adc_gas, gas_range, c);
+  out.heat_stable = (gas[1] & 0x10) != 0;
+  out.gas_valid = (gas[1] & 0x20) != 0;
+}
+
+// ===== Golden values =====
+
+// Coefficients the synthetic dumps were built from (register_dumps.h)
+struct ExpectedCalib {
+  const char* dump;
+  BoschCalib cal;
+};
+
+static const ExpectedCalib expected_calib[] = {
+  { "bme680_low", { 26163, 26300, 3, 35921, -10275, 88, 7100, -48, 30, 35, -2226, -2384, 30,
+                    776, 1014, 0, 45, 20, 120, -100, -30, -12998, 18, 1, 41, -1, 0 } },
+  { "bme680_high", { 25936, 26479, 3, 36440, -10426, 88, 6934, -139, 30, 40, -1489, -3239, 30,
+                     812, 1005, 0, 45, 20, 120, -100, -33, -12418, 18, 2, 49, 1, 0 } },
+};
+
+// Readings from the Bosch reference for each conversion of a dump
+// (regenerate with --golden after adding a dump)
+struct GoldenReading {
+  const char* dump;
+  uint8_t conversion;
+  int16_t temperature;      // centi-degC
+  uint32_t pressure;        // Pa
+  uint32_t humidity;        // milli-%RH
+  uint32_t gas_resistance;  // Ohms
+  bool heat_stable;
+  bool gas_valid;
+};
+
+static const GoldenReading golden[] = {
+  { "bme680_low", 0, 2150, 101325, 44999, 270801, false, true },
+  { "bme680_low", 1, 2310, 100801, 52001, 277911, true, true },
+  { "bme680_low", 2, 1980, 98500, 37999, 440736, true, true },
+  { "bme680_low", 3, 2188, 101288, 59072, 170629, true, true },
+  { "bme680_high", 0, 2279, 100447, 41263, 994100, false, true },
+  { "bme680_high", 1, 2440, 99945, 48066, 933000, true, true },
+  { "bme680_high", 2, 2108, 97653, 34470, 2127700, true, true },
+  { "bme680_high", 3, 2317, 100414, 54935, 396100, true, true },
+};
+
+#define GOLDEN_COUNT (sizeof(golden) / sizeof(golden[0]))
+
+// Heater set-point checked after the golden readings
+#define GOLDEN_HEATER_TEMP     320  // degC
+#define GOLDEN_HEATER_DURATION 150  // ms
+
+static void print_golden() {
+  for (uint8_t d = 0; d < REGISTER_DUMP_COUNT; d++) {
+    const RegisterDump& dump = register_dumps[d];
+    BoschCalib c;
+    reference_calib(dump.image, c);
+    for (uint8_t i = 0; i < dump.field_count; i++) {
+      SensorDataFixed r;
+      reference_reading(dump.fields[i], dump.image[CHIP_VARIANT_ADDR], c, r);
+      printf("  { \"%s\", %u, %d, %u, %u, %u, %s, %s },\n", dump.name, i, r.temperature, r.pressure,
+             r.humidity, r.gas_resistance, r.heat_stable ? "true" : "false", r.gas_valid ? "true" : "false");
+    }
+  }
+}
+
+static bool same_reading(const SensorDataFixed& a, const SensorDataFixed& b) {
+  return a.temperature == b.temperature && a.pressure == b.pressure && a.humidity == b.humidity &&
+         a.gas_resistance == b.gas_resistance && a.heat_stable == b.heat_stable && a.gas_valid == b.gas_valid;
+}
+
+static void print_reading(const char* label, const SensorDataFixed& r) {
+  printf("    %s: T %d  P %u  H %u  gas %u  stable %d  valid %d\n", label, r.temperature, r.pressure,
+         r.humidity, r.gas_resistance, r.heat_stable, r.gas_valid);
+}
+
+static void test_dumps() {
+  CheckGroup calib = begin_group("coefficients");
+  CheckGroup golden_group = begin_group("golden readings");
+  CheckGroup reference = begin_group("dump vs reference");
+  CheckGroup heater = begin_group("heater set-point");
+
+  for (uint8_t d = 0; d < REGISTER_DUMP_COUNT; d++) {
+    const RegisterDump& dump = register_dumps[d];
+    FakeBME680 chip(dump);
+    Wire.attach(SENSOR_ADDR, &chip);
+    BME680_Custom sensor(SENSOR_ADDR);
+
+    if (!sensor.begin()) {
+      check(calib, false);
+      printf("  %s: begin() failed\n", dump.name);
+      Wire.detach(SENSOR_ADDR);
+      continue;
+    }
+
+    // Driver parse against the SensorAPI parse, and the known values
+    BoschCalib ref;
+    BoschCalib got;
+    reference_calib(dump.image, ref);
+    driver_calib(sensor, got);
+    if (!check(calib, same_calib(H::cal(sensor), ref))) {
+      printf("  %s: coefficients differ\n", dump.name);
+      print_calib("driver", got);
+      print_calib("bosch ", ref);
+    }
+    for (uint8_t e = 0; e < sizeof(expected_calib) / sizeof(expected_calib[0]); e++) {
+      if (strcmp(expected_calib[e].dump, dump.name) == 0 && !check(calib, same_calib(H::cal(sensor), expected_calib[e].cal))) {
+        printf("  %s: coefficients differ from the values the dump was built from\n", dump.name);
+        print_calib("driver  ", got);
+        print_calib("expected", expected_calib[e].cal);
+      }
+    }
+
+    // begin() took conversion 0; the rest through the blocking read
+    for (uint8_t i = 0; i < dump.field_count; i++) {
+      if (i > 0 && !check(reference, sensor.get_sensor_data())) {
+        printf("  %s: get_sensor_data() failed at conversion %u\n", dump.name, i);
+        break;
+      }
+
+      SensorDataFixed expect;
+      reference_reading(dump.fields[i], dump.image[CHIP_VARIANT_ADDR], ref, expect);
+      if (!check(reference, same_reading(sensor.data_fixed, expect))) {
+        printf("  %s conversion %u:\n", dump.name, i);
+        print_reading("driver", sensor.data_fixed);
+        print_reading("bosch ", expect);
+      }
+
+      bool float_ok = sensor.data.temperature == sensor.data_fixed.temperature / 100.0f &&
+                      sensor.data.pressure == sensor.data_fixed.pressure / 100.0f &&
+                      sensor.data.humidity == sensor.data_fixed.humidity / 1000.0f &&
+                      sensor.data.gas_resistance == (float)sensor.data_fixed.gas_resistance;
+      if (!check(reference, float_ok)) {
+        printf("  %s conversion %u: float data doesn't match data_fixed\n", dump.name, i);
+      }
+
+      for (uint8_t g = 0; g < GOLDEN_COUNT; g++) {
+        if (strcmp(golden[g].dump, dump.name) != 0 || golden[g].conversion != i) {
+          continue;
+        }
+        SensorDataFixed want = { golden[g].pressure, golden[g].humidity, golden[g].gas_resistance,
+                                 golden[g].temperature, golden[g].heat_stable, golden[g].gas_valid };
+        if (!check(golden_group, same_reading(sensor.data_fixed, want))) {
+          printf("  %s conversion %u:\n", dump.name, i);
+          print_reading("driver", sensor.data_fixed);
+          print_reading("golden", want);
+        }
+      }
+    }
+
+    // Heater registers written with the next trigger, from the last
+    // temperature read
+    int8_t ambient = sensor.data_fixed.temperature / 100;
+    sensor.set_gas_heater_temperature(GOLDEN_HEATER_TEMP);
+    sensor.set_gas_heater_duration(GOLDEN_HEATER_DURATION);
+    sensor.get_sensor_data();
+    uint8_t want_res = bosch_calc_heater_res(GOLDEN_HEATER_TEMP, ambient, ref);
+    uint8_t want_dur = bosch_calc_heater_dur(GOLDEN_HEATER_DURATION);
+    if (!check(heater, chip.reg(RES_HEAT0_ADDR) == want_res && chip.reg(GAS_WAIT0_ADDR) == want_dur)) {
+      printf("  %s: res_heat_0 0x%02x gas_wait_0 0x%02x, bosch 0x%02x 0x%02x\n", dump.name,
+             chip.reg(RES_HEAT0_ADDR), chip.reg(GAS_WAIT0_ADDR), want_res, want_dur);
+    }
+
+    Wire.detach(SENSOR_ADDR);
+  }
+
+  // Every dump with golden values must exist
+  for (uint8_t g = 0; g < GOLDEN_COUNT; g++) {
+    bool found = false;
+    for (uint8_t d = 0; d < REGISTER_DUMP_COUNT; d++) {
+      found = found || strcmp(golden[g].dump, register_dumps[d].name) == 0;
+    }
+    if (!check(golden_group, found)) {
+      printf("  golden row for unknown dump %s\n", golden[g].dump);
+    }
+  }
+
+  end_group(calib);
+  end_group(golden_group);
+  end_group(reference);
+  end_group(heater);
+}
+
+// ===== Differential sweep =====
+
+static void test_sweep() {
+  CheckGroup parse = begin_group("sweep: coefficients");
+  CheckGroup temp = begin_group("sweep: temperature");
+  CheckGroup pres = begin_group("sweep: pressure");
+  CheckGroup hum = begin_group("sweep: humidity");
+  CheckGroup gas_low = begin_group("sweep: gas (low variant)");
+  CheckGroup gas_high = begin_group("sweep: gas (high variant)");
+  CheckGroup heat_res = begin_group("sweep: heater resistance");
+  CheckGroup heat_dur = begin_group("sweep: heater duration");
+  CheckGroup batch = begin_group("sweep: compensate_batch");
+
+  RegisterDump dump = register_dumps[0];
+  FakeBME680 chip(dump);
+  Wire.attach(SENSOR_ADDR, &chip);
+
+  for (uint16_t set = 0; set < SWEEP_COEFF_SETS; set++) {
+    // Random coefficient bytes, parsed by the driver through begin()
+    for (uint8_t i = 0; i < COEFF_ADDR1_LEN; i++) {
+      dump.image[COEFF_ADDR1 + i] = rng();
+    }
+    for (uint8_t i = 0; i < COEFF_ADDR2_LEN - 1; i++) {
+      dump.image[COEFF_ADDR2 + i] = rng();
+    }
+    dump.image[ADDR_RES_HEAT_VAL_ADDR] = rng();
+    dump.image[ADDR_RES_HEAT_RANGE_ADDR] = rng();
+    dump.image[ADDR_RANGE_SW_ERR_ADDR] = rng();
+    uint8_t variant = rng() & 1;
+    dump.image[CHIP_VARIANT_ADDR] = variant;
+    chip.load(dump);
+
+    BME680_Custom sensor(SENSOR_ADDR);
+    sensor.begin();
+
+    BoschCalib ref;
+    reference_calib(dump.image, ref);
+    if (!check(parse, same_calib(H::cal(sensor), ref))) {
+      BoschCalib got;
+      driver_calib(sensor, got);
+      printf("  set %u:\n", set);
+      print_calib("driver", got);
+      print_calib("bosch ", ref);
+    }
+    H::set_cal(sensor, ref, variant);
+
+    // Batch against fetch()'s per-frame path, with a partial last block;
+    // the static form with the exported coefficients must agree too
+    {
+      static uint8_t frames[SWEEP_BATCH_FRAMES][FIELD_LENGTH];
+      static SensorDataFixed out[SWEEP_BATCH_FRAMES];
+      static SensorDataFixed out_static[SWEEP_BATCH_FRAMES];
+      for (uint16_t i = 0; i < SWEEP_BATCH_FRAMES; i++) {
+        for (uint8_t b = 0; b < FIELD_LENGTH; b++) {
+          frames[i][b] = rng();
+        }
+      }
+      sensor.compensate_batch(&frames[0][0], SWEEP_BATCH_FRAMES, out);
+      BME680State state;
+      sensor.export_state(state);
+      BME680_Custom::compensate_batch(state.cal, state.variant, &frames[0][0], SWEEP_BATCH_FRAMES, out_static);
+      for (uint16_t i = 0; i < SWEEP_BATCH_FRAMES; i++) {
+        H::parse_field(sensor, frames[i]);
+        if (!check(batch, same_reading(out[i], sensor.data_fixed) && same_reading(out_static[i], out[i]))) {
+          printf("  set %u frame %u:\n", set, i);
+          print_reading("batch ", out[i]);
+          print_reading("static", out_static[i]);
+          print_reading("fetch ", sensor.data_fixed);
+        }
+      }
+    }
+
+    // Full ADC ranges, so intermediate widths are exercised beyond the
+    // values a sensor produces
+    for (uint16_t i = 0; i < SWEEP_ADC_SAMPLES; i++) {
+      uint32_t adc_temp = rng() & 0xFFFFF;
+      uint32_t adc_pres = rng() & 0xFFFFF;
+      uint16_t adc_hum = rng();
+
+      int32_t t = H::temperature(sensor, adc_temp);
+      int16_t t_ref = bosch_calc_temperature(adc_temp, ref);
+      if (!check(temp, (int16_t)t == t_ref && H::t_fine(sensor) == ref.t_fine)) {
+        printf("  set %u adc %u: %d (t_fine %d), bosch %d (t_fine %d)\n", set, adc_temp, t,
+               H::t_fine(sensor), t_ref, ref.t_fine);
+      }
+
+      uint32_t p = H::pressure(sensor, adc_pres);
+      uint32_t p_ref = bosch_calc_pressure(adc_pres, ref);
+      if (!check(pres, p == p_ref)) {
+        printf("  set %u t_fine %d adc %u: %u, bosch %u\n", set, ref.t_fine, adc_pres, p, p_ref);
+      }
+
+      uint32_t h = H::humidity(sensor, adc_hum);
+      uint32_t h_ref = bosch_calc_humidity(adc_hum, ref);
+      if (!check(hum, h == h_ref)) {
+        printf("  set %u t_fine %d adc %u: %u, bosch %u\n", set, ref.t_fine, adc_hum, h, h_ref);
+      }
+    }
+
+    // Every gas ADC value and range; only range_sw_err varies per set
+    H::set_cal(sensor, ref, 0x00);
+    for (uint16_t adc = 0; adc < 1024; adc++) {
+      for (uint8_t range = 0; range < 16; range++) {
+        uint32_t g = H::gas(sensor, adc, range);
+        uint32_t g_ref = bosch_calc_gas_resistance_low(adc, range, ref);
+        if (!check(gas_low, g == g_ref)) {
+          printf("  set %u sw_err %d adc %u range %u: %u, bosch %u\n", set, ref.range_sw_err, adc, range,
+                 g, g_ref);
+        }
+      }
+    }
+
+    // Driver range of set-points; ambient as a sensor reports it
+    for (uint16_t target = 200; target <= 400; target++) {
+      int8_t ambient = (int8_t)((int32_t)(rng() % 126) - 40);
+      H::set_ambient(sensor, ambient);
+      uint8_t r = H::heater_res(sensor, target);
+      uint8_t r_ref = bosch_calc_heater_res(target, ambient, ref);
+      if (!check(heat_res, r == r_ref)) {
+        printf("  set %u %u degC ambient %d: %u, bosch %u\n", set, target, ambient, r, r_ref);
+      }
+    }
+  }
+
+  // The high variant has no coefficients
+  {
+    BME680_Custom sensor(SENSOR_ADDR);
+    BoschCalib ref;
+    reference_calib(register_dumps[0].image, ref);
+    H::set_cal(sensor, ref, 0x01);
+    for (uint16_t adc = 0; adc < 1024; adc++) {
+      for (uint8_t range = 0; range < 16; range++) {
+        uint32_t g = H::gas(sensor, adc, range);
+        uint32_t g_ref = bosch_calc_gas_resistance_high(adc, range);
+        if (!check(gas_high, g == g_ref)) {
+          printf("  adc %u range %u: %u, bosch %u\n", adc, range, g, g_ref);
+        }
+      }
+    }
+
+    for (uint32_t dur = 0; dur <= 0xFFFF; dur++) {
+      uint8_t v = H::heater_dur(sensor, dur);
+      uint8_t v_ref = bosch_calc_heater_dur(dur);
+      if (!check(heat_dur, v == v_ref)) {
+        printf("  %u ms: 0x%02x, bosch 0x%02x\n", dur, v, v_ref);
+      }
+    }
+  }
+
+  Wire.detach(SENSOR_ADDR);
+
+  end_group(parse);
+  end_group(temp);
+  end_group(pres);
+  end_group(hum);
+  end_group(gas_low);
+  end_group(gas_high);
+  end_group(heat_res);
+  end_group(heat_dur);
+  end_group(batch);
+}
+
+// ===== Compile-time variant =====
+
+// BME680<Variant> on each dump: begin() only on its own variant, then the
+// same readings and batch results as BME680_Custom
+template <uint8_t Variant>
+static void check_fixed_variant(CheckGroup& g, const RegisterDump& dump) {
+  FakeBME680 chip(dump);
+  Wire.attach(SENSOR_ADDR, &chip);
+  BME680<Variant> sensor(SENSOR_ADDR);
+  bool own = dump.image[CHIP_VARIANT_ADDR] == Variant;
+
+  if (!check(g, sensor.begin() == own)) {
+    printf("  BME680<%u> on %s: begin() %s\n", Variant, dump.name, own ? "failed" : "accepted the other variant");
+  }
+  if (!own) {
+    Wire.detach(SENSOR_ADDR);
+    return;
+  }
+
+  BoschCalib ref;
+  reference_calib(dump.image, ref);
+  for (uint8_t i = 0; i < dump.field_count; i++) {
+    if (i > 0 && !check(g, sensor.get_sensor_data())) {
+      printf("  BME680<%u> on %s: get_sensor_data() failed at conversion %u\n", Variant, dump.name, i);
+      break;
+    }
+    SensorDataFixed expect;
+    reference_reading(dump.fields[i], Variant, ref, expect);
+    if (!check(g, same_reading(sensor.data_fixed, expect))) {
+      printf("  BME680<%u> on %s conversion %u:\n", Variant, dump.name, i);
+      print_reading("driver", sensor.data_fixed);
+      print_reading("bosch ", expect);
+    }
+  }
+
+  // Random frames, against the run-time batch through the base class
+  uint8_t frames[SWEEP_BATCH_FRAMES][FIELD_LENGTH];
+  for (uint8_t i = 0; i < SWEEP_BATCH_FRAMES; i++) {
+    for (uint8_t b = 0; b < FIELD_LENGTH; b++) {
+      frames[i][b] = rng();
+    }
+  }
+  SensorDataFixed fixed[SWEEP_BATCH_FRAMES];
+  SensorDataFixed runtime[SWEEP_BATCH_FRAMES];
+  sensor.compensate_batch(&frames[0][0], SWEEP_BATCH_FRAMES, fixed);
+  static_cast<BME680_Custom&>(sensor).compensate_batch(&frames[0][0], SWEEP_BATCH_FRAMES, runtime);
+  for (uint8_t i = 0; i < SWEEP_BATCH_FRAMES; i++) {
+    if (!check(g, same_reading(fixed[i], runtime[i]))) {
+      printf("  BME680<%u> on %s batch frame %u:\n", Variant, dump.name, i);
+      print_reading("fixed  ", fixed[i]);
+      print_reading("runtime", runtime[i]);
+    }
+  }
+
+  Wire.detach(SENSOR_ADDR);
+}
+
+static void test_variants() {
+  CheckGroup g = begin_group("BME680<Variant>");
+  for (uint8_t d = 0; d < REGISTER_DUMP_COUNT; d++) {
+    check_fixed_variant<BME680_VARIANT_GAS_LOW>(g, register_dumps[d]);
+    check_fixed_variant<BME680_VARIANT_GAS_HIGH>(g, register_dumps[d]);
+  }
+  end_group(g);
+}
+
+// ===== Continuous mode =====
+
+// A setting changed while continuous mode runs goes out with the next
+// trigger, and the conversion time follows it
+static void test_continuous() {
+  CheckGroup g = begin_group("continuous: settings");
+  FakeBME680 chip(register_dumps[0]);
+  Wire.attach(SENSOR_ADDR, &chip);
+  BME680_Custom sensor(SENSOR_ADDR);
+  sensor.begin();
+
+  check(g, sensor.start_continuous(1));
+  uint16_t before = sensor.get_measurement_duration();
+  sensor.set_filter(FILTER_SIZE_7);
+  sensor.set_temperature_oversample(OS_16X);
+  host_advance_ms(before);
+  check(g, sensor.poll_continuous() == MEAS_READY);
+
+  uint8_t filt = (chip.reg(CONF_ODR_FILT_ADDR) & FILTER_MSK) >> FILTER_POS;
+  uint8_t os_t = (chip.reg(CONF_T_P_MODE_ADDR) & OST_MSK) >> OST_POS;
+  if (!check(g, filt == FILTER_SIZE_7 && os_t == OS_16X)) {
+    printf("  filter %u, temperature oversampling %u after the next trigger\n", filt, os_t);
+  }
+  if (!check(g, sensor.get_time_until_ready() > before)) {
+    printf("  conversion time %u ms, was %u ms\n", sensor.get_time_until_ready(), before);
+  }
+
+  sensor.stop_continuous();
+  Wire.detach(SENSOR_ADDR);
+  end_group(g);
+}
+
+// ===== Window statistics =====
+
+// SlidingStats<N> min/max after every add(), against a scan of the last
+// N values
+template <uint16_t N>
+static void check_sliding(CheckGroup& g, const char* name, const int32_t* values, uint16_t n) {
+  SlidingStats<N> stats;
+  for (uint16_t i = 0; i < n; i++) {
+    stats.add(values[i]);
+    uint16_t first = i + 1 > N ? i + 1 - N : 0;
+    int32_t lo = values[first];
+    int32_t hi = values[first];
+    for (uint16_t j = first; j <= i; j++) {
+      lo = values[j] < lo ? values[j] : lo;
+      hi = values[j] > hi ? values[j] : hi;
+    }
+    if (!check(g, stats.min() == lo && stats.max() == hi && stats.count() == i + 1 - first)) {
+      printf("  SlidingStats<%u> %s, sample %u: min %d max %d, window min %d max %d\n", N, name, i,
+             stats.min(), stats.max(), lo, hi);
+    }
+  }
+}
+
+#define WINDOW_RUN 200
+
+static void test_window_stats() {
+  CheckGroup g = begin_group("SlidingStats min/max");
+  static int32_t values[WINDOW_RUN];
+
+  for (uint16_t i = 0; i < WINDOW_RUN; i++) values[i] = i;
+  check_sliding<4>(g, "rising", values, WINDOW_RUN);
+  check_sliding<60>(g, "rising", values, WINDOW_RUN);
+
+  for (uint16_t i = 0; i < WINDOW_RUN; i++) values[i] = WINDOW_RUN - i;
+  check_sliding<4>(g, "falling", values, WINDOW_RUN);
+  check_sliding<60>(g, "falling", values, WINDOW_RUN);
+
+  // Rising and falling runs with repeats, then noise
+  for (uint16_t i = 0; i < WINDOW_RUN; i++) values[i] = (i % 50 < 25) ? i % 50 / 2 : (50 - i % 50) / 2;
+  check_sliding<4>(g, "runs", values, WINDOW_RUN);
+  check_sliding<7>(g, "runs", values, WINDOW_RUN);
+  for (uint16_t i = 0; i < WINDOW_RUN; i++) values[i] = (int32_t)(rng() % 2001) - 1000;
+  check_sliding<4>(g, "random", values, WINDOW_RUN);
+  check_sliding<16>(g, "random", values, WINDOW_RUN);
+
+  end_group(g);
+}
+
+// ===== Benchmarks =====
+
+#define BENCH_INPUTS     1024
+#define BENCH_ITERATIONS 4000000UL
+
+static volatile uint32_t bench_sink;
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double elapsed_ns(BenchClock::time_point start) {
+  return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+}
+
+static void print_bench(const char* name, double ns, unsigned long n) {
+  printf("%-28s %8.2f ns\n", name, ns / n);
+}
+
+static void print_traffic(const char* name, const WireCounters& c, uint32_t samples) {
+  printf("%-28s %3u tx %5u B (w %4u, r %4u)  %7.1f us @100k  %6.1f us @400k\n", name,
+         c.transactions / samples, c.bus_bytes() / samples, c.bytes_written / samples, c.bytes_read / samples,
+         c.bus_us(100000) / samples, c.bus_us(400000) / samples);
+}
+
+static void bench() {
+  const RegisterDump& dump = register_dumps[0];
+  FakeBME680 chip(dump);
+  Wire.attach(SENSOR_ADDR, &chip);
+  BME680_Custom sensor(SENSOR_ADDR);
+  sensor.begin();
+
+  // Inputs around the dump's readings, so the kernels take their usual paths
+  static uint32_t adc_temp[BENCH_INPUTS];
+  static uint32_t adc_pres[BENCH_INPUTS];
+  static uint16_t adc_hum[BENCH_INPUTS];
+  static uint16_t adc_gas[BENCH_INPUTS];
+  static uint8_t gas_range[BENCH_INPUTS];
+  static uint8_t fields[BENCH_INPUTS][FIELD_LENGTH];
+  for (uint16_t i = 0; i < BENCH_INPUTS; i++) {
+    adc_temp[i] = 480000 + rng() % 16000;
+    adc_pres[i] = 345000 + rng() % 20000;
+    adc_hum[i] = 19000 + rng() % 6000;
+    adc_gas[i] = rng() % 1024;
+    gas_range[i] = rng() % 16;
+    memcpy(fields[i], dump.fields[i % dump.field_count], FIELD_LENGTH);
+    fields[i][6] ^= rng() & 0xFF;
+    fields[i][3] ^= rng() & 0xFF;
+  }
+
+  printf("Compensation (%lu calls each)\n", BENCH_ITERATIONS);
+  uint32_t sink = 0;
+  BenchClock::time_point start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    sink += H::temperature(sensor, adc_temp[n % BENCH_INPUTS]);
+  }
+  print_bench("_calc_temperature", elapsed_ns(start), BENCH_ITERATIONS);
+
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    sink += H::pressure(sensor, adc_pres[n % BENCH_INPUTS]);
+  }
+  print_bench("_calc_pressure", elapsed_ns(start), BENCH_ITERATIONS);
+
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    sink += H::humidity(sensor, adc_hum[n % BENCH_INPUTS]);
+  }
+  print_bench("_calc_humidity", elapsed_ns(start), BENCH_ITERATIONS);
+
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    sink += H::gas(sensor, adc_gas[n % BENCH_INPUTS], gas_range[n % BENCH_INPUTS]);
+  }
+  print_bench("_calc_gas_resistance (low)", elapsed_ns(start), BENCH_ITERATIONS);
+
+  BoschCalib ref;
+  reference_calib(dump.image, ref);
+  H::set_cal(sensor, ref, 0x01);
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    sink += H::gas(sensor, adc_gas[n % BENCH_INPUTS], gas_range[n % BENCH_INPUTS]);
+  }
+  print_bench("_calc_gas_resistance (high)", elapsed_ns(start), BENCH_ITERATIONS);
+  H::set_cal(sensor, ref, dump.image[CHIP_VARIANT_ADDR]);
+
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    sink += H::heater_res(sensor, 200 + n % 201);
+  }
+  print_bench("_calc_heater_resistance", elapsed_ns(start), BENCH_ITERATIONS);
+
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    H::parse_field(sensor, fields[n % BENCH_INPUTS]);
+    sink += sensor.data_fixed.pressure;
+  }
+  print_bench("_parse_field_data (all four)", elapsed_ns(start), BENCH_ITERATIONS);
+
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < BENCH_ITERATIONS; n++) {
+    H::parse_field<BME680_VARIANT_GAS_LOW>(sensor, fields[n % BENCH_INPUTS]);
+    sink += sensor.data_fixed.pressure;
+  }
+  print_bench("  BME680<GAS_LOW>", elapsed_ns(start), BENCH_ITERATIONS);
+
+  // Same frames through the batch path, per frame
+  static SensorDataFixed batch_out[BENCH_INPUTS];
+  unsigned long batches = BENCH_ITERATIONS / BENCH_INPUTS;
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < batches; n++) {
+    sensor.compensate_batch(&fields[0][0], BENCH_INPUTS, batch_out);
+    sink += batch_out[n % BENCH_INPUTS].pressure;
+  }
+  double batch_ns = elapsed_ns(start);
+  print_bench("compensate_batch() per frame", batch_ns, batches * BENCH_INPUTS);
+  printf("%-28s %8.1f MB/s of frames\n", "", batches * BENCH_INPUTS * FIELD_LENGTH * 1e3 / batch_ns);
+
+  // fetch(): the field read through I2CBus and the Wire mock, then the
+  // compensation; the mock's cost is part of it
+  unsigned long fetches = BENCH_ITERATIONS / 4;
+  start = BenchClock::now();
+  for (unsigned long n = 0; n < fetches; n++) {
+    H::fetch(sensor);
+    sink += sensor.data_fixed.pressure;
+  }
+  print_bench("fetch()", elapsed_ns(start), fetches);
+  bench_sink = sink;
+
+  // Bus traffic, per call
+  printf("\nI2C traffic (address bytes included)\n");
+  const uint32_t samples = 16;
+  BME680_Custom fresh(SENSOR_ADDR);
+  Wire.reset_counters();
+  fresh.begin();
+  print_traffic("begin()", Wire.counters, 1);
+
+  Wire.reset_counters();
+  for (uint32_t i = 0; i < samples; i++) {
+    fresh.get_sensor_data();
+  }
+  print_traffic("get_sensor_data()", Wire.counters, samples);
+
+  Wire.reset_counters();
+  for (uint32_t i = 0; i < samples; i++) {
+    fresh.set_gas_heater_temperature(300 + (i & 1) * 20);
+    fresh.get_sensor_data();
+  }
+  print_traffic("  with a heater change", Wire.counters, samples);
+
+  Wire.reset_counters();
+  for (uint32_t i = 0; i < samples; i++) {
+    H::fetch(fresh);
+  }
+  print_traffic("fetch()", Wire.counters, samples);
+
+  // Continuous mode: one result read and one re-trigger per conversion
+  fresh.start_continuous(samples);
+  Wire.reset_counters();
+  for (uint32_t i = 0; i < samples; i++) {
+    host_advance_ms(fresh.get_measurement_duration());
+    fresh.poll_continuous();
+  }
+  print_traffic("poll_continuous() per conv", Wire.counters, samples);
+  fresh.stop_continuous();
+
+  Wire.detach(SENSOR_ADDR);
+}
+
+// ===== Main =====
+
+int main(int argc, char** argv) {
+  bool run_bench = false;
+  bool run_golden = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench") == 0) {
+      run_bench = true;
+    } else if (strcmp(argv[i], "--golden") == 0) {
+      run_golden = true;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      rng_state = strtoul(argv[++i], nullptr, 0);
+      if (rng_state == 0) rng_state = 1;
+    } else {
+      fprintf(stderr, "usage: %s [--bench | --golden] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (run_golden) {
+    print_golden();
+    return 0;
+  }
+  if (run_bench) {
+    bench();
+    return 0;
+  }
+
+  test_dumps();
+  test_sweep();
+  test_variants();
+  test_continuous();
+  test_window_stats();
+
+  printf("\n%u checks, %u failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
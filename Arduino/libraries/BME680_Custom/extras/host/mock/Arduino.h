@@ -0,0 +1,60 @@
+/*
+ * Host stand-in for the parts of the Arduino core the library uses
+ *
+ * The clock is simulated: delay() advances millis() instantly, so a
+ * blocking read runs at host speed. ARDUINO_ARCH_ESP32 is not defined,
+ * which compiles out NVS, the bus lock and the timing sites.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+using std::min;
+using std::max;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Moves the simulated clock without a delay() call
+void host_advance_ms(unsigned long ms);
+
+// Serial output is dropped unless echo is set
+class HostSerial {
+public:
+  bool echo = false;
+
+  void print(const char* s) { if (echo) fputs(s, stdout); }
+  void print(char c) { if (echo) fputc(c, stdout); }
+  void print(int v) { if (echo) printf("%d", v); }
+  void print(unsigned int v) { if (echo) printf("%u", v); }
+  void print(long v) { if (echo) printf("%ld", v); }
+  void print(unsigned long v) { if (echo) printf("%lu", v); }
+  void print(double v, int digits = 2) { if (echo) printf("%.*f", digits, v); }
+
+  template <typename T>
+  void println(T v) {
+    print(v);
+    print('\n');
+  }
+  void println() { print('\n'); }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Host stand-in for TwoWire
+ *
+ * Transactions are handed to the I2CDevice attached at the address; with
+ * none attached the address is NACKed. Counters record the traffic the
+ * driver puts on the bus, address bytes included.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+#define I2C_BUFFER_LENGTH 128
+
+class I2CDevice {
+public:
+  virtual ~I2CDevice() {}
+
+  // One write transaction (register pointer, then data)
+  virtual void write(const uint8_t* data, size_t len) = 0;
+
+  // One read transaction; returns the bytes supplied
+  virtual size_t read(uint8_t* data, size_t len) = 0;
+};
+
+struct WireCounters {
+  uint32_t transactions;  // Starts and repeated starts
+  uint32_t bytes_written; // Payload bytes to the device
+  uint32_t bytes_read;    // Payload bytes from the device
+
+  // Bytes on the wire: payload plus one address byte per start
+  uint32_t bus_bytes() const { return transactions + bytes_written + bytes_read; }
+
+  // Bus time in us: 9 clocks per byte plus start and stop
+  float bus_us(uint32_t clock_hz) const { return (bus_bytes() * 9.0f + transactions * 2.0f) * 1e6f / clock_hz; }
+};
+
+class TwoWire {
+public:
+  TwoWire();
+
+  void begin() {}
+  void setClock(uint32_t) {}
+
+  void attach(uint8_t addr, I2CDevice* device) { _devices[addr & 0x7F] = device; }
+  void detach(uint8_t addr) { _devices[addr & 0x7F] = nullptr; }
+
+  void beginTransmission(uint8_t addr);
+  size_t write(uint8_t value);
+  size_t write(const uint8_t* data, size_t len);
+  uint8_t endTransmission(bool stop = true);
+
+  uint8_t requestFrom(uint8_t addr, uint8_t len);
+  int available() { return _rx_len - _rx_pos; }
+  int read() { return _rx_pos < _rx_len ? _rx_buf[_rx_pos++] : -1; }
+
+  WireCounters counters;
+  void reset_counters() { memset(&counters, 0, sizeof(counters)); }
+
+private:
+  I2CDevice* _devices[128];
+  uint8_t _tx_addr;
+  uint8_t _tx_buf[I2C_BUFFER_LENGTH];
+  size_t _tx_len;
+  uint8_t _rx_buf[I2C_BUFFER_LENGTH];
+  size_t _rx_len;
+  size_t _rx_pos;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Host stand-ins: simulated clock, Serial and Wire
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+
+static unsigned long sim_us = 0;
+
+unsigned long millis() { return sim_us / 1000; }
+unsigned long micros() { return sim_us; }
+void delay(unsigned long ms) { sim_us += ms * 1000; }
+void delayMicroseconds(unsigned int us) { sim_us += us; }
+void host_advance_ms(unsigned long ms) { sim_us += ms * 1000; }
+
+HostSerial Serial;
+TwoWire Wire;
+
+TwoWire::TwoWire() {
+  for (uint8_t i = 0; i < 128; i++) {
+    _devices[i] = nullptr;
+  }
+  _tx_addr = 0;
+  _tx_len = 0;
+  _rx_len = 0;
+  _rx_pos = 0;
+  reset_counters();
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  _tx_addr = addr & 0x7F;
+  _tx_len = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (_tx_len >= I2C_BUFFER_LENGTH) {
+    return 0;
+  }
+  _tx_buf[_tx_len++] = value;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t len) {
+  size_t n = 0;
+  while (n < len && write(data[n])) {
+    n++;
+  }
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+  counters.transactions++;
+  I2CDevice* device = _devices[_tx_addr];
+  if (!device) {
+    return 2;  // Address NACK
+  }
+  counters.bytes_written += _tx_len;
+  if (_tx_len > 0) {
+    device->write(_tx_buf, _tx_len);
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len) {
+  counters.transactions++;
+  _rx_len = 0;
+  _rx_pos = 0;
+  I2CDevice* device = _devices[addr & 0x7F];
+  if (!device) {
+    return 0;
+  }
+  if (len > I2C_BUFFER_LENGTH) {
+    len = I2C_BUFFER_LENGTH;
+  }
+  _rx_len = device->read(_rx_buf, len);
+  counters.bytes_read += _rx_len;
+  return _rx_len;
+}
@@ -0,0 +1,105 @@
+/*
+ * Register dumps replayed by FakeBME680
+ *
+ * Each dump is the chip's full register map (what `i2cdump -y <bus> 0x76 b`
+ * prints, rows 00-f0) plus the field block 0x1D-0x2D read after each
+ * forced conversion, in order. To add a capture from real hardware, dump
+ * the map once after power-up, log the 17 field bytes of a few
+ * conversions, and add an entry below; the harness checks every dump
+ * against the Bosch reference, and golden values can be added for it in
+ * harness.cpp.
+ *
+ * The two dumps here are synthetic: typical coefficients encoded in the
+ * coefficient blocks at 0x89 and 0xE1, with ADC values chosen for indoor
+ * readings. Bytes the driver never reads are zero.
+ */
+
+#ifndef REGISTER_DUMPS_H
+#define REGISTER_DUMPS_H
+
+#include <stdint.h>
+#include "BME680_Custom.h"
+
+struct RegisterDump {
+  const char* name;
+  uint8_t image[256];
+  uint8_t field_count;
+  const uint8_t (*fields)[FIELD_LENGTH];
+};
+
+// Low gas variant (BME680): gas result in 0x2A/0x2B
+// Coefficients: t1 26163, t2 26300, t3 3, p1 35921, p2 -10275, p3 88,
+// p4 7100, p5 -48, p6 30, p7 35, p8 -2226, p9 -2384, p10 30, h1 776,
+// h2 1014, h3 0, h4 45, h5 20, h6 120, h7 -100, gh1 -30, gh2 -12998,
+// gh3 18; res_heat_val 41, res_heat_range 1, range_sw_err -1
+static const uint8_t bme680_low_fields[][FIELD_LENGTH] = {
+  { 0x80, 0x00, 0x55, 0x57, 0x60, 0x76, 0xf0, 0x00, 0x53, 0x18, 0x00, 0x00, 0x00, 0x64, 0xa5, 0x00, 0x00 },
+  { 0x80, 0x01, 0x56, 0x6d, 0x60, 0x78, 0x2e, 0x80, 0x57, 0x69, 0x00, 0x00, 0x00, 0x5c, 0xf5, 0x00, 0x00 },
+  { 0x80, 0x02, 0x58, 0xec, 0xb0, 0x75, 0x9d, 0x00, 0x4e, 0x93, 0x00, 0x00, 0x00, 0xac, 0xb4, 0x00, 0x00 },
+  { 0x80, 0x03, 0x55, 0x7a, 0x00, 0x77, 0x3c, 0x70, 0x5b, 0xd3, 0x00, 0x00, 0x00, 0x26, 0xf6, 0x00, 0x00 },
+};
+
+// High gas variant (variant id 0x01): gas result in 0x2C/0x2D
+// Coefficients: t1 25936, t2 26479, t3 3, p1 36440, p2 -10426, p3 88,
+// p4 6934, p5 -139, p6 30, p7 40, p8 -1489, p9 -3239, p10 30, h1 812,
+// h2 1005, h3 0, h4 45, h5 20, h6 120, h7 -100, gh1 -33, gh2 -12418,
+// gh3 18; res_heat_val 49, res_heat_range 2, range_sw_err 1
+static const uint8_t bme680_high_fields[][FIELD_LENGTH] = {
+  { 0x80, 0x00, 0x55, 0x57, 0x60, 0x76, 0xf0, 0x00, 0x53, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x26 },
+  { 0x80, 0x01, 0x56, 0x6d, 0x60, 0x78, 0x2e, 0x80, 0x57, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x98, 0xb6 },
+  { 0x80, 0x02, 0x58, 0xec, 0xb0, 0x75, 0x9d, 0x00, 0x4e, 0x93, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6b, 0xb5 },
+  { 0x80, 0x03, 0x55, 0x7a, 0x00, 0x77, 0x3c, 0x70, 0x5b, 0xd3, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd9, 0xb7 },
+};
+
+static const RegisterDump register_dumps[] = {
+  {
+    "bme680_low",
+    {
+      0x29, 0x00, 0x16, 0x00, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 00
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 10
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 20
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 30
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 40
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 50
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 60
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 70
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbc, 0x66, 0x03, 0x00, 0x51, 0x8c,  // 80
+      0xdd, 0xd7, 0x58, 0x00, 0xbc, 0x1b, 0xd0, 0xff, 0x23, 0x1e, 0x00, 0x00, 0x4e, 0xf7, 0xb0, 0xf6,  // 90
+      0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // a0
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // b0
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // c0
+      0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // d0
+      0x00, 0x3f, 0x68, 0x30, 0x00, 0x2d, 0x14, 0x78, 0x9c, 0x33, 0x66, 0x3a, 0xcd, 0xe2, 0x12, 0x00,  // e0
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00   // f0
+    },
+    sizeof(bme680_low_fields) / FIELD_LENGTH,
+    bme680_low_fields,
+  },
+  {
+    "bme680_high",
+    {
+      0x31, 0x00, 0x26, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 00
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 10
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 20
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 30
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 40
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 50
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 60
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // 70
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6f, 0x67, 0x03, 0x00, 0x58, 0x8e,  // 80
+      0x46, 0xd7, 0x58, 0x00, 0x16, 0x1b, 0x75, 0xff, 0x28, 0x1e, 0x00, 0x00, 0x2f, 0xfa, 0x59, 0xf3,  // 90
+      0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // a0
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // b0
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // c0
+      0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // d0
+      0x00, 0x3e, 0xdc, 0x32, 0x00, 0x2d, 0x14, 0x78, 0x9c, 0x50, 0x65, 0x7e, 0xcf, 0xdf, 0x12, 0x00,  // e0
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00   // f0
+    },
+    sizeof(bme680_high_fields) / FIELD_LENGTH,
+    bme680_high_fields,
+  },
+};
+
+#define REGISTER_DUMP_COUNT (sizeof(register_dumps) / sizeof(register_dumps[0]))
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * WiFi/MQTT connection manager implementation
+ */
+
+#include "ConnectionManager.h"
+#include <Preferences.h>
+
+ConnectionManager::ConnectionManager(PubSubClient* mqtt) {
+  _mqtt = mqtt;
+  _ssid = nullptr;
+  _password = nullptr;
+  _client_id = nullptr;
+  _will_topic = nullptr;
+  _will_message = nullptr;
+  _on_connect = nullptr;
+  
+  _state = CONN_IDLE;
+  _use_static_ip = true;
+  memset(&_cache, 0, sizeof(_cache));
+  
+  _fast_join = false;
+  _join_start = 0;
+  _next_attempt = 0;
+  _wifi_delay = CONN_RETRY_MIN_MS;
+  _mqtt_delay = CONN_RETRY_MIN_MS;
+  _mqtt_failures = 0;
+  
+  _was_online = false;
+  _outage_start = 0;
+  _reconnects = 0;
+  _last_outage_ms = 0;
+}
+
+void ConnectionManager::begin(const char* ssid, const char* password, const char* client_id) {
+  _ssid = ssid;
+  _password = password;
+  _client_id = client_id;
+  
+  // The state machine does the reconnecting; the driver must not race it
+  // or rewrite the credentials in flash on every join
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  
+  if (_mqtt) {
+    _mqtt->setSocketTimeout(CONN_MQTT_SOCKET_TIMEOUT);
+  }
+  
+  _load_cache();
+  _outage_start = millis();
+  _start_join(_cache.valid);
+}
+
+void ConnectionManager::loop() {
+  unsigned long now = millis();
+  
+  switch (_state) {
+    case CONN_WIFI_JOINING: {
+      wl_status_t status = WiFi.status();
+      if (status == WL_CONNECTED) {
+        _wifi_up();
+      } else if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL ||
+                 now - _join_start >= (_fast_join ? CONN_FAST_JOIN_TIMEOUT : CONN_JOIN_TIMEOUT)) {
+        _join_failed();
+      }
+      break;
+    }
+    
+    case CONN_WIFI_BACKOFF:
+      if ((long)(now - _next_attempt) >= 0) {
+        _start_join(_cache.valid);
+      }
+      break;
+    
+    case CONN_MQTT_BACKOFF:
+      if (WiFi.status() != WL_CONNECTED) {
+        _wifi_lost();
+      } else if ((long)(now - _next_attempt) >= 0) {
+        _connect_mqtt();
+      }
+      break;
+    
+    case CONN_ONLINE:
+      if (WiFi.status() != WL_CONNECTED) {
+        _set_offline();
+        _wifi_lost();
+      } else if (_mqtt && !_mqtt->loop()) {
+        // Broker dropped us; WiFi is still fine
+        _set_offline();
+        _mqtt_backoff();
+      }
+      break;
+    
+    default:
+      break;
+  }
+}
+
+void ConnectionManager::forget() {
+  memset(&_cache, 0, sizeof(_cache));
+  
+  Preferences prefs;
+  if (prefs.begin(CONN_NVS_NAMESPACE, false)) {
+    prefs.remove("cache");
+    prefs.end();
+  }
+}
+
+// ============================================================================
+// WIFI
+// ============================================================================
+
+void ConnectionManager::_start_join(bool use_cache) {
+  _fast_join = use_cache;
+  _join_start = millis();
+  
+  if (use_cache) {
+    // Straight to the known AP: no scan, and no DHCP with the cached lease
+    if (_use_static_ip) {
+      WiFi.config(IPAddress(_cache.ip), IPAddress(_cache.gateway),
+                  IPAddress(_cache.subnet), IPAddress(_cache.dns));
+    }
+    WiFi.begin(_ssid, _password, _cache.channel, _cache.bssid);
+  } else {
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+    WiFi.begin(_ssid, _password);
+  }
+  
+  _state = CONN_WIFI_JOINING;
+}
+
+void ConnectionManager::_join_failed() {
+  WiFi.disconnect();
+  
+  // The AP may have moved channel or been replaced: scan right away
+  if (_fast_join) {
+    _start_join(false);
+    return;
+  }
+  
+  // Full join failed too (AP down): back off, then try the cache again
+  _next_attempt = millis() + _jitter(_wifi_delay);
+  _wifi_delay = _next_delay(_wifi_delay);
+  _state = CONN_WIFI_BACKOFF;
+}
+
+void ConnectionManager::_wifi_up() {
+  _wifi_delay = CONN_RETRY_MIN_MS;
+  _mqtt_failures = 0;
+  _save_cache();
+  
+  if (!_mqtt) {
+    _set_online();
+    return;
+  }
+  
+  // First broker attempt right away
+  _mqtt_delay = CONN_RETRY_MIN_MS;
+  _next_attempt = millis();
+  _state = CONN_MQTT_BACKOFF;
+}
+
+void ConnectionManager::_wifi_lost() {
+  WiFi.disconnect();
+  _start_join(_cache.valid);
+}
+
+// ============================================================================
+// MQTT
+// ============================================================================
+
+void ConnectionManager::_connect_mqtt() {
+  bool connected = _will_topic
+    ? _mqtt->connect(_client_id, _will_topic, 0, true, _will_message)
+    : _mqtt->connect(_client_id);
+  
+  if (connected) {
+    _mqtt_delay = CONN_RETRY_MIN_MS;
+    _mqtt_failures = 0;
+    _set_online();
+    if (_on_connect) {
+      _on_connect();
+    }
+    return;
+  }
+  
+  // With a reused lease, a TCP connect that keeps failing may mean the
+  // address now belongs to another host: get a fresh one from DHCP once.
+  // A CONNACK refusal or timeout means the path works and only the broker
+  // is unhappy, so WiFi stays up.
+  if (_mqtt->state() != MQTT_CONNECT_FAILED) {
+    _mqtt_failures = 0;
+  } else if (++_mqtt_failures >= CONN_STATIC_MQTT_FAILS && _fast_join && _use_static_ip) {
+    WiFi.disconnect();
+    _start_join(false);
+    return;
+  }
+  
+  _mqtt_backoff();
+}
+
+void ConnectionManager::_mqtt_backoff() {
+  _next_attempt = millis() + _jitter(_mqtt_delay);
+  _mqtt_delay = _next_delay(_mqtt_delay);
+  _state = CONN_MQTT_BACKOFF;
+}
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+void ConnectionManager::_set_online() {
+  if (_was_online) {
+    _reconnects++;
+    _last_outage_ms = millis() - _outage_start;
+  }
+  _was_online = true;
+  _state = CONN_ONLINE;
+}
+
+void ConnectionManager::_set_offline() {
+  _outage_start = millis();
+}
+
+void ConnectionManager::_load_cache() {
+  Preferences prefs;
+  if (!prefs.begin(CONN_NVS_NAMESPACE, true)) {
+    return;
+  }
+  if (prefs.getBytes("cache", &_cache, sizeof(_cache)) != sizeof(_cache)) {
+    memset(&_cache, 0, sizeof(_cache));
+  }
+  prefs.end();
+}
+
+void ConnectionManager::_save_cache() {
+  ConnectionCache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.valid = 1;
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid) {
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  }
+  cache.channel = WiFi.channel();
+  cache.ip = WiFi.localIP();
+  cache.gateway = WiFi.gatewayIP();
+  cache.subnet = WiFi.subnetMask();
+  cache.dns = WiFi.dnsIP();
+  
+  // Flash is only written when the AP or the lease changed
+  if (!bssid || memcmp(&cache, &_cache, sizeof(cache)) == 0) {
+    return;
+  }
+  _cache = cache;
+  
+  Preferences prefs;
+  if (prefs.begin(CONN_NVS_NAMESPACE, false)) {
+    prefs.putBytes("cache", &_cache, sizeof(_cache));
+    prefs.end();
+  }
+}
+
+uint32_t ConnectionManager::_jitter(uint32_t delay_ms) {
+  uint32_t span = delay_ms * CONN_JITTER_PCT / 100;
+  return delay_ms - span + random(2 * span + 1);
+}
+
+uint32_t ConnectionManager::_next_delay(uint32_t delay_ms) {
+  return (delay_ms * 2 < CONN_RETRY_MAX_MS) ? delay_ms * 2 : CONN_RETRY_MAX_MS;
+}
@@ -0,0 +1,128 @@
+/*
+ * WiFi/MQTT connection manager
+ *
+ * Brings the link up from a state machine driven by loop(), so a missing
+ * AP or broker never blocks the caller:
+ * - Rejoin with the cached BSSID and channel (no scan) and the last DHCP
+ *   lease as a static address (no DHCP). The cache is kept in NVS and
+ *   rewritten only when the AP or lease changes.
+ * - A failed fast join falls back to a full scan with DHCP
+ * - Failed attempts back off exponentially with random jitter, so nodes
+ *   that lost the same router don't retry in lockstep
+ * - MQTT connects once WiFi is up; on_connect() is the place to
+ *   subscribe and announce
+ *
+ * The only blocking call is PubSubClient::connect(): a DNS lookup if the
+ * broker is a host name (lwIP's own timeout), the TCP connect (WiFiClient's
+ * connect timeout, 3 s by default on arduino-esp32) and then up to
+ * CONN_MQTT_SOCKET_TIMEOUT for the CONNACK. Not thread safe: use it from
+ * one task. state() may be read from anywhere.
+ */
+
+#ifndef CONNECTION_MANAGER_H
+#define CONNECTION_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+
+// Connection states
+#define CONN_IDLE          0  // begin() not called
+#define CONN_WIFI_JOINING  1
+#define CONN_WIFI_BACKOFF  2  // Waiting to retry the join
+#define CONN_MQTT_BACKOFF  3  // WiFi up, waiting to retry the broker
+#define CONN_ONLINE        4  // WiFi up, MQTT connected (or WiFi up without MQTT)
+
+// Retry timing
+#define CONN_RETRY_MIN_MS        500
+#define CONN_RETRY_MAX_MS        30000
+#define CONN_JITTER_PCT          25     // Each delay is randomized by +/- this much
+#define CONN_FAST_JOIN_TIMEOUT   3000   // Cached BSSID/channel/address
+#define CONN_JOIN_TIMEOUT        15000  // Scan, association and DHCP
+#define CONN_MQTT_SOCKET_TIMEOUT 3      // s, bounds one connect() call
+#define CONN_STATIC_MQTT_FAILS   3      // TCP connect failures before the cached lease is dropped
+
+#define CONN_NVS_NAMESPACE "conn"
+
+// Last successful association
+struct ConnectionCache {
+  uint8_t valid;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+class ConnectionManager {
+public:
+  // mqtt nullptr manages WiFi only
+  ConnectionManager(PubSubClient* mqtt = nullptr);
+
+  // Loads the cache and starts the first join. client_id is only used
+  // with an MQTT client.
+  void begin(const char* ssid, const char* password, const char* client_id = nullptr);
+
+  // Call often. Runs the state machine and mqtt->loop().
+  void loop();
+
+  // Caching the lease as a static address skips DHCP (on by default).
+  // Turn it off on networks that hand out short leases.
+  void set_static_ip(bool enabled) { _use_static_ip = enabled; }
+  void set_last_will(const char* topic, const char* message) { _will_topic = topic; _will_message = message; }
+  void set_on_connect(void (*callback)()) { _on_connect = callback; }
+
+  // Drops the cache (e.g. after moving the node to another network)
+  void forget();
+
+  uint8_t state() const { return _state; }
+  bool wifi_connected() const { return _state >= CONN_MQTT_BACKOFF; }
+  bool online() const { return _state == CONN_ONLINE; }
+
+  // Statistics
+  uint32_t get_reconnects() const { return _reconnects; }
+  uint32_t get_last_outage_ms() const { return _last_outage_ms; }  // Link lost to back online
+  bool get_fast_join() const { return _fast_join; }                // Current link used the cache
+
+private:
+  PubSubClient* _mqtt;
+  const char* _ssid;
+  const char* _password;
+  const char* _client_id;
+  const char* _will_topic;
+  const char* _will_message;
+  void (*_on_connect)();
+
+  volatile uint8_t _state;
+  bool _use_static_ip;
+  ConnectionCache _cache;
+
+  bool _fast_join;             // Current/last join used the cache
+  unsigned long _join_start;
+  unsigned long _next_attempt;
+  uint32_t _wifi_delay;
+  uint32_t _mqtt_delay;
+  uint8_t _mqtt_failures;      // Consecutive TCP connect failures
+
+  bool _was_online;            // Reached CONN_ONLINE at least once
+  unsigned long _outage_start;
+  uint32_t _reconnects;
+  uint32_t _last_outage_ms;
+
+  void _start_join(bool use_cache);
+  void _join_failed();
+  void _wifi_up();
+  void _wifi_lost();
+  void _mqtt_backoff();
+  void _connect_mqtt();
+  void _set_online();
+  void _set_offline();
+
+  void _load_cache();
+  void _save_cache();
+  static uint32_t _jitter(uint32_t delay_ms);
+  static uint32_t _next_delay(uint32_t delay_ms);
+};
+
+#endif
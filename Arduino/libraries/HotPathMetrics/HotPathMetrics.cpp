@@ -0,0 +1,81 @@
+/*
+ * Hot-path timing metrics implementation
+ */
+
+#include "HotPathMetrics.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+MetricSite* MetricSite::_first = nullptr;
+MetricSite* MetricSite::_last = nullptr;
+
+// Sites are globals: constructed one at a time before setup()
+MetricSite::MetricSite(const char* name) : _name(name), _next(nullptr) {
+  for (uint8_t i = 0; i < METRIC_BUCKETS; i++) {
+    _buckets[i].store(0, std::memory_order_relaxed);
+  }
+  _max.store(0, std::memory_order_relaxed);
+
+  if (_last) {
+    _last->_next = this;
+  } else {
+    _first = this;
+  }
+  _last = this;
+}
+
+void MetricSite::reset() {
+  for (uint8_t i = 0; i < METRIC_BUCKETS; i++) {
+    _buckets[i].store(0, std::memory_order_relaxed);
+  }
+  _max.store(0, std::memory_order_relaxed);
+}
+
+void MetricSite::reset_all() {
+  for (MetricSite* site = _first; site; site = site->_next) {
+    site->reset();
+  }
+}
+
+// Value of the sample at rank (1-based), interpolated within its bucket
+static float bucket_percentile(const uint32_t* counts, uint32_t rank, uint32_t max) {
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < METRIC_BUCKETS; b++) {
+    if (seen + counts[b] < rank) {
+      seen += counts[b];
+      continue;
+    }
+    float lo = MetricSite::bucket_low(b);
+    float hi = lo + MetricSite::bucket_width(b);
+    if (hi > max) hi = max;
+    if (lo > hi) lo = hi;
+    return lo + (hi - lo) * (float)(rank - seen) / counts[b];
+  }
+  return max;
+}
+
+void MetricSite::summary(MetricSummary& s) const {
+  // One snapshot, so the count and the percentiles agree
+  uint32_t counts[METRIC_BUCKETS];
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < METRIC_BUCKETS; i++) {
+    counts[i] = _buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  uint32_t max = _max.load(std::memory_order_relaxed);
+  float cycles_per_us = getCpuFrequencyMhz();
+
+  s.count = total;
+  if (total == 0) {
+    s.p50_us = s.p99_us = s.max_us = 0.0f;
+    return;
+  }
+
+  uint32_t rank50 = (total + 1) / 2;
+  uint32_t rank99 = total - total / 100;
+  s.p50_us = bucket_percentile(counts, rank50, max) / cycles_per_us;
+  s.p99_us = bucket_percentile(counts, rank99, max) / cycles_per_us;
+  s.max_us = max / cycles_per_us;
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Hot-path timing metrics
+ *
+ * Times code sites with the CPU cycle counter into a log-linear histogram
+ * per site (about 500 bytes, static storage), to see where time goes on
+ * the device:
+ * - METRIC_SITE(var, "name") defines a site at file scope. Sites link
+ *   themselves into one list at start-up, so a report finds them all
+ *   without knowing where they are.
+ * - METRIC_SCOPE(var) times the rest of the enclosing block
+ * - summary() gives count, p50/p99 and max in microseconds. Percentiles
+ *   come from the histogram: each power of two is split into four
+ *   buckets, and the value is interpolated within its bucket, so it is
+ *   off by less than a quarter.
+ *
+ * Recording is one atomic add and a compare for the max, safe from any
+ * task. Times come from the cycle counter of the core the code runs on,
+ * so a timed block must not move to the other core (the sketches pin
+ * their tasks); the counter wraps after 2^32 cycles (about 18 s at
+ * 240 MHz). Blocked time (delays, lock waits) inside the block counts.
+ *
+ * Build with -DHOT_PATH_METRICS=0 to compile the sites out. On other
+ * architectures they are always compiled out.
+ */
+
+#ifndef HOT_PATH_METRICS_H
+#define HOT_PATH_METRICS_H
+
+#include <Arduino.h>
+
+#if !defined(ARDUINO_ARCH_ESP32)
+#undef HOT_PATH_METRICS
+#define HOT_PATH_METRICS 0
+#elif !defined(HOT_PATH_METRICS)
+#define HOT_PATH_METRICS 1
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <atomic>
+#include <esp_cpu.h>
+
+// Cycles 0-3 have a bucket each; from there every power of two has four
+#define METRIC_BUCKETS 124
+
+struct MetricSummary {
+  uint32_t count;
+  float p50_us;
+  float p99_us;
+  float max_us;
+};
+
+static inline uint32_t metric_cycles() {
+  return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+class MetricSite {
+public:
+  MetricSite(const char* name);
+
+  void record(uint32_t cycles) {
+    _buckets[bucket_index(cycles)].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t max = _max.load(std::memory_order_relaxed);
+    while (cycles > max && !_max.compare_exchange_weak(max, cycles, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Samples recorded during a reset may land in either period
+  void reset();
+  void summary(MetricSummary& s) const;
+
+  const char* name() const { return _name; }
+
+  static uint8_t bucket_index(uint32_t cycles) {
+    if (cycles < 4) return cycles;
+    uint8_t msb = 31 - __builtin_clz(cycles);
+    return (msb - 1) * 4 + ((cycles >> (msb - 2)) & 3);
+  }
+
+  // Lowest cycle count in the bucket, and the bucket width
+  static uint32_t bucket_low(uint8_t i) { return i < 4 ? i : (4UL + (i & 3)) << (i / 4 - 1); }
+  static uint32_t bucket_width(uint8_t i) { return i < 4 ? 1 : 1UL << (i / 4 - 1); }
+
+  // All sites, in start-up order
+  static MetricSite* first() { return _first; }
+  MetricSite* next() const { return _next; }
+  static void reset_all();
+
+private:
+  const char* _name;
+  MetricSite* _next;
+  std::atomic<uint32_t> _buckets[METRIC_BUCKETS];
+  std::atomic<uint32_t> _max;
+
+  static MetricSite* _first;
+  static MetricSite* _last;
+};
+
+// Records the cycles from construction to destruction
+class MetricTimer {
+public:
+  MetricTimer(MetricSite& site) : _site(site), _start(metric_cycles()) {}
+  ~MetricTimer() { _site.record(metric_cycles() - _start); }
+
+private:
+  MetricSite& _site;
+  uint32_t _start;
+};
+
+#endif
+
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+
+#if HOT_PATH_METRICS
+#define METRIC_SITE(var, name) static MetricSite var(name)
+#define METRIC_SCOPE(var) MetricTimer METRIC_CONCAT(_metric_timer_, __LINE__)(var)
+#else
+#define METRIC_SITE(var, name)
+#define METRIC_SCOPE(var)
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * LED strip outputs
+ */
+
+#include "LedOutput.h"
+#include "LedTables.h"
+
+LedOutput::LedOutput() {
+  set_levels(255, false);
+}
+
+void LedOutput::set_levels(uint8_t brightness, bool gamma) {
+  for (uint16_t v = 0; v < 256; v++) {
+    _levels[v] = led_scale8(gamma ? led_gamma8(v) : v, brightness);
+  }
+}
+
+bool NeoPixelOutput::show(const uint32_t* pixels, uint16_t count) {
+  if (count > _strip.numPixels()) {
+    count = _strip.numPixels();
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t c = pixels[i];
+    _strip.setPixelColor(i, _levels[(c >> 16) & 0xFF], _levels[(c >> 8) & 0xFF],
+                         _levels[c & 0xFF], _levels[c >> 24]);
+  }
+  _strip.show();
+  return true;
+}
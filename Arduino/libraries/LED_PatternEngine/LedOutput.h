@@ -0,0 +1,51 @@
+/*
+ * LED strip outputs
+ *
+ * The pattern engine hands finished frames of packed 0xWWRRGGBB pixels to
+ * an LedOutput. Brightness and gamma are folded into one 256-entry channel
+ * table, so applying them costs one lookup per channel.
+ *
+ * - NeoPixelOutput: wraps Adafruit_NeoPixel; show() blocks until sent
+ * - RmtLedOutput:   RMT + DMA, double buffered; show() returns at once
+ *                   (see RmtLedOutput.h)
+ */
+
+#ifndef LED_OUTPUT_H
+#define LED_OUTPUT_H
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+class LedOutput {
+public:
+  LedOutput();
+  virtual ~LedOutput() {}
+
+  virtual bool begin() { return true; }
+  virtual uint16_t count() = 0;
+
+  // Sends one frame. The pixels may be reused as soon as this returns.
+  virtual bool show(const uint32_t* pixels, uint16_t count) = 0;
+
+  // Blocks until every queued frame is on the strip
+  virtual void wait() {}
+
+  // Rebuilds the channel table; takes effect from the next show()
+  void set_levels(uint8_t brightness, bool gamma);
+
+protected:
+  uint8_t _levels[256];  // channel value -> value sent to the strip
+};
+
+class NeoPixelOutput : public LedOutput {
+public:
+  NeoPixelOutput(Adafruit_NeoPixel& strip) : _strip(strip) {}
+
+  uint16_t count() override { return _strip.numPixels(); }
+  bool show(const uint32_t* pixels, uint16_t count) override;
+
+private:
+  Adafruit_NeoPixel& _strip;
+};
+
+#endif
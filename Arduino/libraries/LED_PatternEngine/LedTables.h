@@ -0,0 +1,112 @@
+/*
+ * LED lookup tables
+ *
+ * 256-entry sine, color wheel and gamma tables generated at compile time,
+ * so pattern kernels are integer table lookups with no float math or
+ * branching per pixel. The tables live in flash (.rodata).
+ *
+ * Angles are in 1/256 turns: led_sin8(64) is the peak, led_sin8(192) the
+ * trough. Wheel colors are packed 0x00RRGGBB like Adafruit_NeoPixel::Color().
+ */
+
+#ifndef LED_TABLES_H
+#define LED_TABLES_H
+
+#include <Arduino.h>
+
+// Gamma applied by led_gamma8() (2.5 keeps the generator to a square root)
+#define LED_GAMMA 2.5
+
+namespace led_tables {
+
+// ============================================================================
+// CONSTEXPR GENERATORS (C++11: single-expression, recursive)
+// ============================================================================
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Taylor series, accurate to well under 1/255 over [-pi, pi]
+constexpr double sin_term(double x2, double term, int n) {
+  return n > 21 ? term : term + sin_term(x2, -term * x2 / ((n + 1) * (n + 2)), n + 2);
+}
+constexpr double sin_rad(double x) {
+  return sin_term(x * x, x, 1);
+}
+
+// Newton iteration for square roots of [0, 1]
+constexpr double sqrt_iter(double x, double guess, int n) {
+  return n == 0 ? guess : sqrt_iter(x, 0.5 * (guess + x / guess), n - 1);
+}
+constexpr double sqrt01(double x) {
+  return x <= 0.0 ? 0.0 : sqrt_iter(x, 1.0, 20);
+}
+
+constexpr uint8_t round8(double v) {
+  return v <= 0.0 ? 0 : v >= 255.0 ? 255 : (uint8_t)(v + 0.5);
+}
+
+// Index i of 256 -> angle in [-pi, pi) so the series stays accurate
+constexpr uint8_t sin8_entry(int i) {
+  return round8((sin_rad(((i + 128) % 256 - 128) * 2.0 * kPi / 256.0) + 1.0) * 127.5);
+}
+
+constexpr uint32_t rgb(int r, int g, int b) {
+  return ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+}
+
+// Same ramps as the classic Adafruit Wheel()
+constexpr uint32_t wheel_entry(int i) {
+  return (255 - i) < 85  ? rgb(255 - (255 - i) * 3, 0, (255 - i) * 3) :
+         (255 - i) < 170 ? rgb(0, (170 - i) * 3, 255 - (170 - i) * 3) :
+                           rgb((85 - i) * 3, 255 - (85 - i) * 3, 0);
+}
+
+constexpr uint8_t gamma_entry(int i) {
+  return round8((i / 255.0) * (i / 255.0) * sqrt01(i / 255.0) * 255.0);
+}
+
+// Minimal integer sequence (std::make_index_sequence is C++14)
+template <int... I> struct seq {};
+template <int N, int... I> struct make_seq : make_seq<N - 1, N - 1, I...> {};
+template <int... I> struct make_seq<0, I...> { typedef seq<I...> type; };
+
+template <typename S> struct tables;
+template <int... I> struct tables<seq<I...>> {
+  static constexpr uint8_t sin8[256] = { sin8_entry(I)... };
+  static constexpr uint32_t wheel[256] = { wheel_entry(I)... };
+  static constexpr uint8_t gamma8[256] = { gamma_entry(I)... };
+};
+
+template <int... I> constexpr uint8_t tables<seq<I...>>::sin8[256];
+template <int... I> constexpr uint32_t tables<seq<I...>>::wheel[256];
+template <int... I> constexpr uint8_t tables<seq<I...>>::gamma8[256];
+
+typedef tables<make_seq<256>::type> lut;
+
+}  // namespace led_tables
+
+// ============================================================================
+// LOOKUPS
+// ============================================================================
+
+// (sin(angle) + 1) * 127.5 for angle in 1/256 turns
+static inline uint8_t led_sin8(uint8_t angle) {
+  return led_tables::lut::sin8[angle];
+}
+
+// Red -> green -> blue -> red as pos goes 0 -> 255
+static inline uint32_t led_wheel(uint8_t pos) {
+  return led_tables::lut::wheel[pos];
+}
+
+// Perceptual brightness correction
+static inline uint8_t led_gamma8(uint8_t value) {
+  return led_tables::lut::gamma8[value];
+}
+
+// value * scale / 256, for 8-bit channel scaling
+static inline uint8_t led_scale8(uint8_t value, uint8_t scale) {
+  return ((uint16_t)value * (scale + 1)) >> 8;
+}
+
+#endif
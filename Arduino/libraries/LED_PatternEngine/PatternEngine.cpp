@@ -0,0 +1,499 @@
+/*
+ * LED Pattern Engine Implementation
+ */
+
+#include "PatternEngine.h"
+#include "Patterns.h"
+
+PatternEngine::PatternEngine()
+  : _num_channels(0), _num_leds(0), _num_segments(0),
+    _frame(nullptr), _shown(nullptr), _brightness(255),
+    _gamma(false), _fps(PATTERN_DEFAULT_FPS), _timer(nullptr),
+    _task(nullptr), _lock(nullptr), _frames_rendered(0), _frames_shown(0) {
+  for (uint8_t i = 0; i < PATTERN_MAX_ID; i++) {
+    _patterns[i] = nullptr;
+  }
+  memset(_channels, 0, sizeof(_channels));
+  memset(_segments, 0, sizeof(_segments));
+}
+
+PatternEngine::PatternEngine(LedOutput& output) : PatternEngine() {
+  int8_t channel = add_channel(output);
+  if (channel >= 0) {
+    add_segment("main", channel, 0);
+  }
+}
+
+PatternEngine::~PatternEngine() {
+  end();
+  free(_frame);
+  free(_shown);
+}
+
+bool PatternEngine::begin(uint16_t fps) {
+  if (_task) {
+    return true;
+  }
+  if (fps == 0 || fps > PATTERN_MAX_FPS) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < _num_channels; i++) {
+    if (!_channels[i].output->begin()) {
+      return false;
+    }
+  }
+
+  _fps = fps;
+
+  _lock = xSemaphoreCreateMutex();
+  if (!_lock) {
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(_task_entry, "led_engine", PATTERN_TASK_STACK, this,
+                              PATTERN_TASK_PRIORITY, &_task, PATTERN_TASK_CORE) != pdPASS) {
+    vSemaphoreDelete(_lock);
+    _lock = nullptr;
+    _task = nullptr;
+    return false;
+  }
+
+  esp_timer_create_args_t args = {};
+  args.callback = _on_timer;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "led_frame";
+  args.skip_unhandled_events = true;  // Drop frames rather than bursting
+
+  if (esp_timer_create(&args, &_timer) != ESP_OK) {
+    end();
+    return false;
+  }
+
+  // Push the current frame so the strip matches the engine's state
+  _lock_state();
+  _refresh_all();
+  _unlock_state();
+  _request_frame();
+
+  return true;
+}
+
+void PatternEngine::end() {
+  if (_timer) {
+    esp_timer_stop(_timer);
+    esp_timer_delete(_timer);
+    _timer = nullptr;
+  }
+  if (_task) {
+    vTaskDelete(_task);
+    _task = nullptr;
+  }
+  if (_lock) {
+    vSemaphoreDelete(_lock);
+    _lock = nullptr;
+  }
+}
+
+// ============================================================================
+// LAYOUT
+// ============================================================================
+
+int8_t PatternEngine::add_channel(LedOutput& output) {
+  uint16_t count = output.count();
+  if (_task || _num_channels >= PATTERN_MAX_CHANNELS ||
+      count == 0 || count > UINT16_MAX - _num_leds) {
+    return -1;
+  }
+
+  // Grow both buffers to the new total; nothing renders before begin()
+  size_t size = ((size_t)_num_leds + count) * sizeof(uint32_t);
+  uint32_t* frame = (uint32_t*)realloc(_frame, size);
+  if (!frame) {
+    return -1;
+  }
+  _frame = frame;
+  uint32_t* shown = (uint32_t*)realloc(_shown, size);
+  if (!shown) {
+    return -1;
+  }
+  _shown = shown;
+  memset(_frame + _num_leds, 0, count * sizeof(uint32_t));
+  memset(_shown + _num_leds, 0, count * sizeof(uint32_t));
+
+  LedChannel& ch = _channels[_num_channels];
+  ch.output = &output;
+  ch.offset = _num_leds;
+  ch.count = count;
+  ch.brightness = _brightness;
+  ch.refresh = false;
+  _num_leds += count;
+  return _num_channels++;
+}
+
+int8_t PatternEngine::add_segment(const char* name, uint8_t channel, uint16_t start, uint16_t count) {
+  if (_task || _num_segments >= PATTERN_MAX_SEGMENTS || channel >= _num_channels) {
+    return SEGMENT_NONE;
+  }
+  uint16_t size = _channels[channel].count;
+  if (start >= size) {
+    return SEGMENT_NONE;
+  }
+  if (count == 0) {
+    count = size - start;
+  }
+  if (count > size - start) {
+    return SEGMENT_NONE;
+  }
+
+  LedSegment& seg = _segments[_num_segments];
+  seg.name = name;
+  seg.channel = channel;
+  seg.start = start;
+  seg.count = count;
+  seg.pattern = nullptr;
+  seg.pattern_id = PATTERN_NONE;
+  seg.speed = PATTERN_SPEED_NORMAL;
+  seg.pattern_start = 0;
+  seg.dirty = false;
+  return _num_segments++;
+}
+
+int8_t PatternEngine::find_segment(const char* name) {
+  if (!name) {
+    return SEGMENT_NONE;
+  }
+  for (uint8_t i = 0; i < _num_segments; i++) {
+    if (_segments[i].name && strcmp(_segments[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return SEGMENT_NONE;
+}
+
+uint16_t PatternEngine::segment_size(int8_t segment) {
+  LedSegment* seg = _segment(segment);
+  return seg ? seg->count : 0;
+}
+
+LedSegment* PatternEngine::_segment(int8_t segment) {
+  return (segment >= 0 && segment < _num_segments) ? &_segments[segment] : nullptr;
+}
+
+// ============================================================================
+// PATTERN REGISTRY
+// ============================================================================
+
+bool PatternEngine::register_pattern(uint8_t id, Pattern* pattern) {
+  if (id == PATTERN_NONE || id >= PATTERN_MAX_ID) {
+    return false;
+  }
+  _patterns[id] = pattern;
+  return true;
+}
+
+void PatternEngine::register_builtin_patterns() {
+  static RainbowPattern rainbow;
+  static ChasePattern chase;
+  static FadePattern fade;
+  static WavePattern wave;
+  static SparklePattern sparkle;
+
+  register_pattern(PATTERN_RAINBOW, &rainbow);
+  register_pattern(PATTERN_CHASE, &chase);
+  register_pattern(PATTERN_FADE, &fade);
+  register_pattern(PATTERN_WAVE, &wave);
+  register_pattern(PATTERN_SPARKLE, &sparkle);
+}
+
+Pattern* PatternEngine::get_pattern(uint8_t id) {
+  return id < PATTERN_MAX_ID ? _patterns[id] : nullptr;
+}
+
+uint8_t PatternEngine::find_pattern(const char* name) {
+  if (!name) {
+    return PATTERN_NONE;
+  }
+  for (uint8_t i = 1; i < PATTERN_MAX_ID; i++) {
+    if (_patterns[i] && strcmp(_patterns[i]->name, name) == 0) {
+      return i;
+    }
+  }
+  return PATTERN_NONE;
+}
+
+// ============================================================================
+// PLAYBACK
+// ============================================================================
+
+bool PatternEngine::segment_start(int8_t segment, uint8_t id, uint8_t speed) {
+  LedSegment* seg = _segment(segment);
+  Pattern* pattern = get_pattern(id);
+  if (!seg || !pattern || speed == 0) {
+    return false;
+  }
+
+  _lock_state();
+  seg->pattern = pattern;
+  seg->pattern_id = id;
+  seg->speed = speed;
+  seg->pattern_start = millis();
+  pattern->reset();
+  _unlock_state();
+
+  _timer_start();
+  _request_frame();
+  return true;
+}
+
+void PatternEngine::segment_stop(int8_t segment) {
+  LedSegment* seg = _segment(segment);
+  if (!seg) {
+    return;
+  }
+
+  _lock_state();
+  seg->pattern = nullptr;
+  seg->pattern_id = PATTERN_NONE;
+  bool idle = !_any_running();
+  _unlock_state();
+
+  if (idle) {
+    _timer_stop();
+  }
+}
+
+uint8_t PatternEngine::segment_pattern(int8_t segment) {
+  LedSegment* seg = _segment(segment);
+  return seg ? seg->pattern_id : PATTERN_NONE;
+}
+
+bool PatternEngine::running() {
+  return _any_running();
+}
+
+void PatternEngine::_refresh_all() {
+  for (uint8_t i = 0; i < _num_channels; i++) {
+    _channels[i].refresh = true;
+  }
+}
+
+bool PatternEngine::_any_running() {
+  for (uint8_t i = 0; i < _num_segments; i++) {
+    if (_segments[i].pattern) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PatternEngine::segment_fill(int8_t segment, uint32_t color) {
+  LedSegment* seg = _segment(segment);
+  if (!seg) {
+    return;
+  }
+  segment_stop(segment);
+
+  _lock_state();
+  uint32_t* pixels = _segment_pixels(*seg);
+  for (uint16_t i = 0; i < seg->count; i++) {
+    pixels[i] = color;
+  }
+  seg->dirty = true;
+  _unlock_state();
+
+  _request_frame();
+}
+
+void PatternEngine::segment_clear(int8_t segment) {
+  segment_fill(segment, (uint32_t)0);
+}
+
+void PatternEngine::segment_set_pixel(int8_t segment, uint16_t index, uint32_t color) {
+  LedSegment* seg = _segment(segment);
+  if (!seg || index >= seg->count) {
+    return;
+  }
+  segment_stop(segment);
+
+  _lock_state();
+  _segment_pixels(*seg)[index] = color;
+  seg->dirty = true;
+  _unlock_state();
+
+  _request_frame();
+}
+
+// Copies up to the segment's size; pixels past count are left as they are
+void PatternEngine::segment_write(int8_t segment, const uint32_t* pixels, uint16_t count) {
+  LedSegment* seg = _segment(segment);
+  if (!seg || !pixels) {
+    return;
+  }
+  segment_stop(segment);
+
+  _lock_state();
+  memcpy(_segment_pixels(*seg), pixels, min(count, seg->count) * sizeof(uint32_t));
+  seg->dirty = true;
+  _unlock_state();
+
+  _request_frame();
+}
+
+void PatternEngine::fill(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+  fill(Adafruit_NeoPixel::Color(r, g, b, w));
+}
+
+void PatternEngine::set_brightness(uint8_t brightness) {
+  _lock_state();
+  _brightness = brightness;
+  for (uint8_t i = 0; i < _num_channels; i++) {
+    if (_channels[i].brightness != brightness) {
+      _channels[i].brightness = brightness;
+      _channels[i].refresh = true;
+    }
+  }
+  _unlock_state();
+
+  _request_frame();
+}
+
+bool PatternEngine::set_channel_brightness(uint8_t channel, uint8_t brightness) {
+  if (channel >= _num_channels) {
+    return false;
+  }
+
+  _lock_state();
+  if (_channels[channel].brightness != brightness) {
+    _channels[channel].brightness = brightness;
+    _channels[channel].refresh = true;
+  }
+  _unlock_state();
+
+  _request_frame();
+  return true;
+}
+
+uint8_t PatternEngine::get_brightness() {
+  return _brightness;
+}
+
+void PatternEngine::set_gamma(bool enabled) {
+  _lock_state();
+  if (enabled != _gamma) {
+    _gamma = enabled;
+    _refresh_all();
+  }
+  _unlock_state();
+
+  _request_frame();
+}
+
+bool PatternEngine::set_fps(uint16_t fps) {
+  if (fps == 0 || fps > PATTERN_MAX_FPS) {
+    return false;
+  }
+  _fps = fps;
+
+  // Restart the timer with the new period
+  if (running()) {
+    _timer_stop();
+    _timer_start();
+  }
+  return true;
+}
+
+uint16_t PatternEngine::get_fps() {
+  return _fps;
+}
+
+uint32_t PatternEngine::get_frames_rendered() {
+  return _frames_rendered;
+}
+
+uint32_t PatternEngine::get_frames_shown() {
+  return _frames_shown;
+}
+
+// ============================================================================
+// RENDERING
+// ============================================================================
+
+void PatternEngine::_request_frame() {
+  if (_task) {
+    xTaskNotifyGive(_task);
+  }
+}
+
+void PatternEngine::_timer_start() {
+  if (_timer && !esp_timer_is_active(_timer)) {
+    esp_timer_start_periodic(_timer, 1000000ULL / _fps);
+  }
+}
+
+void PatternEngine::_timer_stop() {
+  if (_timer && esp_timer_is_active(_timer)) {
+    esp_timer_stop(_timer);
+  }
+}
+
+void PatternEngine::_render_frame() {
+  bool changed[PATTERN_MAX_CHANNELS] = {};
+  unsigned long now = millis();
+
+  _lock_state();
+
+  for (uint8_t i = 0; i < _num_segments; i++) {
+    LedSegment& seg = _segments[i];
+    if (seg.pattern) {
+      uint32_t elapsed = (uint64_t)(now - seg.pattern_start) * seg.speed / PATTERN_SPEED_NORMAL;
+      seg.pattern->render(_segment_pixels(seg), seg.count, elapsed);
+      _frames_rendered++;
+    } else if (!seg.dirty) {
+      continue;  // Static and untouched since the last frame
+    }
+    seg.dirty = false;
+
+    // Repeated frames cost one memcmp instead of a channel transfer
+    uint16_t at = _channels[seg.channel].offset + seg.start;
+    if (memcmp(_frame + at, _shown + at, seg.count * sizeof(uint32_t)) != 0) {
+      changed[seg.channel] = true;
+    }
+  }
+
+  for (uint8_t c = 0; c < _num_channels; c++) {
+    LedChannel& ch = _channels[c];
+    if (ch.refresh) {
+      ch.output->set_levels(ch.brightness, _gamma);
+      ch.refresh = false;
+      changed[c] = true;
+    }
+    if (changed[c]) {
+      memcpy(_shown + ch.offset, _frame + ch.offset, ch.count * sizeof(uint32_t));
+    }
+  }
+
+  _unlock_state();
+
+  // Only this task touches _shown and the outputs, so show() runs unlocked.
+  // With RmtLedOutput it returns once the frame is queued.
+  for (uint8_t c = 0; c < _num_channels; c++) {
+    LedChannel& ch = _channels[c];
+    if (changed[c] && ch.output->show(_shown + ch.offset, ch.count)) {
+      _frames_shown++;
+    }
+  }
+}
+
+void PatternEngine::_on_timer(void* arg) {
+  static_cast<PatternEngine*>(arg)->_request_frame();
+}
+
+void PatternEngine::_task_entry(void* arg) {
+  PatternEngine* engine = static_cast<PatternEngine*>(arg);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    engine->_render_frame();
+  }
+}
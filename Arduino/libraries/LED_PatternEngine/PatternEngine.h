@@ -0,0 +1,199 @@
+/*
+ * LED Pattern Engine
+ *
+ * Renders LED strip animations at a fixed frame rate:
+ * - Pattern objects registered and selected by numeric ID
+ * - Frames driven by an esp_timer, independent of loop() and network load
+ * - show() skipped when a frame is identical to the one on the strip
+ * - Output through an LedOutput; with RmtLedOutput the next frame is
+ *   rendered while the previous one is still being clocked out
+ * - Several outputs (channels), split into named segments that each run
+ *   their own pattern or static colors
+ *
+ * Only segments with a running pattern are rendered each frame, static
+ * segments are redrawn only after a change, and a channel is sent only
+ * when one of its segments changed.
+ *
+ * The engine owns the strips once begin() has been called. Set colors,
+ * brightness and patterns through the engine, not the strips.
+ */
+
+#ifndef PATTERN_ENGINE_H
+#define PATTERN_ENGINE_H
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <esp_timer.h>
+#include "LedOutput.h"
+
+// Channels (outputs) and segments
+#define PATTERN_MAX_CHANNELS 4
+#define PATTERN_MAX_SEGMENTS 8
+#define SEGMENT_NONE         -1
+
+// Pattern IDs (0 = none)
+#define PATTERN_NONE     0
+#define PATTERN_RAINBOW  1
+#define PATTERN_CHASE    2
+#define PATTERN_FADE     3
+#define PATTERN_WAVE     4
+#define PATTERN_SPARKLE  5
+#define PATTERN_MAX_ID   16
+
+// Frame timing
+#define PATTERN_DEFAULT_FPS  50
+#define PATTERN_MAX_FPS      200
+#define PATTERN_SPEED_NORMAL 50   // speed value that plays a pattern at 1x
+
+// Render task
+#define PATTERN_TASK_STACK    3072
+#define PATTERN_TASK_PRIORITY 2
+#define PATTERN_TASK_CORE     1
+
+// Base class for animations
+// render() writes one frame of packed 0xWWRRGGBB pixels for the given
+// time since the pattern started. It runs in the render task. Keep it a
+// function of elapsed_ms only, so one instance can drive several segments.
+class Pattern {
+public:
+  Pattern(const char* name) : name(name) {}
+  virtual ~Pattern() {}
+
+  // Called when the pattern is started
+  virtual void reset() {}
+  virtual void render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) = 0;
+
+  const char* const name;
+};
+
+// A range of LEDs on one channel
+struct LedSegment {
+  const char* name;
+  uint8_t channel;
+  uint16_t start;          // First LED on the channel
+  uint16_t count;
+  Pattern* pattern;        // nullptr for static colors
+  uint8_t pattern_id;
+  uint8_t speed;
+  unsigned long pattern_start;
+  bool dirty;              // Static pixels changed since the last frame
+};
+
+struct LedChannel {
+  LedOutput* output;
+  uint16_t offset;         // Start of this channel in the frame buffers
+  uint16_t count;
+  uint8_t brightness;
+  bool refresh;            // Levels changed: resend even if pixels didn't
+};
+
+class PatternEngine {
+public:
+  // Add outputs with add_channel() and ranges with add_segment()
+  PatternEngine();
+
+  // Single strip: channel 0 with segment 0 ("main") covering all of it.
+  // Use NeoPixelOutput to drive an Adafruit_NeoPixel strip.
+  PatternEngine(LedOutput& output);
+  ~PatternEngine();
+
+  // Starts the outputs, render task and frame timer. Adafruit_NeoPixel
+  // strips must already be begun.
+  bool begin(uint16_t fps = PATTERN_DEFAULT_FPS);
+  void end();
+
+  // Layout (before begin()). Return the new index, or SEGMENT_NONE / -1
+  // if the limits or the channel size are exceeded. count 0 = rest of channel.
+  // add_channel() grows the frame buffers, so it can also fail on memory.
+  int8_t add_channel(LedOutput& output);
+  int8_t add_segment(const char* name, uint8_t channel, uint16_t start, uint16_t count = 0);
+  int8_t find_segment(const char* name);
+  uint16_t segment_size(int8_t segment);
+
+  // Pattern registry
+  bool register_pattern(uint8_t id, Pattern* pattern);
+  void register_builtin_patterns();
+  Pattern* get_pattern(uint8_t id);
+  uint8_t find_pattern(const char* name);  // PATTERN_NONE if not registered
+
+  // Per-segment playback
+  bool segment_start(int8_t segment, uint8_t id, uint8_t speed = PATTERN_SPEED_NORMAL);
+  void segment_stop(int8_t segment);  // Keeps the last frame on the strip
+  uint8_t segment_pattern(int8_t segment);
+
+  // Per-segment static pixels (stop the segment's pattern)
+  void segment_fill(int8_t segment, uint32_t color);
+  void segment_clear(int8_t segment);
+  void segment_set_pixel(int8_t segment, uint16_t index, uint32_t color);
+  void segment_write(int8_t segment, const uint32_t* pixels, uint16_t count);
+
+  // Segment 0 shorthands
+  bool start(uint8_t id, uint8_t speed = PATTERN_SPEED_NORMAL) { return segment_start(0, id, speed); }
+  void stop() { segment_stop(0); }
+  uint8_t current_pattern() { return segment_pattern(0); }
+  void fill(uint32_t color) { segment_fill(0, color); }
+  void fill(uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0);
+  void clear() { segment_clear(0); }
+
+  bool running();  // Any segment animating
+
+  // set_brightness() sets every channel; per-channel values override it
+  void set_brightness(uint8_t brightness);
+  uint8_t get_brightness();
+  bool set_channel_brightness(uint8_t channel, uint8_t brightness);
+
+  // Gamma-correct every channel on output (off by default)
+  void set_gamma(bool enabled);
+
+  bool set_fps(uint16_t fps);
+  uint16_t get_fps();
+
+  // Statistics
+  uint32_t get_frames_rendered();  // Segment renders
+  uint32_t get_frames_shown();     // Channel transfers
+
+private:
+  LedChannel _channels[PATTERN_MAX_CHANNELS];
+  uint8_t _num_channels;
+  uint16_t _num_leds;
+  LedSegment _segments[PATTERN_MAX_SEGMENTS];
+  uint8_t _num_segments;
+
+  Pattern* _patterns[PATTERN_MAX_ID];
+
+  // _frame is rendered into, _shown is what is on the strips. Channels
+  // are laid out back to back; both hold _num_leds pixels.
+  uint32_t* _frame;
+  uint32_t* _shown;
+  uint8_t _brightness;
+  bool _gamma;
+
+  uint16_t _fps;
+  esp_timer_handle_t _timer;
+  TaskHandle_t _task;
+  SemaphoreHandle_t _lock;
+
+  volatile uint32_t _frames_rendered;
+  volatile uint32_t _frames_shown;
+
+  // No-ops before begin(), when nothing else can be rendering
+  void _lock_state() { if (_lock) xSemaphoreTake(_lock, portMAX_DELAY); }
+  void _unlock_state() { if (_lock) xSemaphoreGive(_lock); }
+
+  LedSegment* _segment(int8_t segment);
+  uint32_t* _segment_pixels(const LedSegment& seg) {
+    return _frame + _channels[seg.channel].offset + seg.start;
+  }
+  bool _any_running();
+  void _refresh_all();
+
+  void _request_frame();
+  void _timer_start();
+  void _timer_stop();
+  void _render_frame();
+
+  static void _on_timer(void* arg);
+  static void _task_entry(void* arg);
+};
+
+#endif
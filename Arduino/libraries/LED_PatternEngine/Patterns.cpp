@@ -0,0 +1,70 @@
+/*
+ * Built-in LED patterns
+ */
+
+#include "Patterns.h"
+#include "LedTables.h"
+
+// Phases below are 8.8 fixed point in 1/256 turns, so only the low 16 bits
+// matter and elapsed_ms can wrap freely.
+//   wave:  elapsed / 20 rad -> 521/256 per ms, 0.5 rad per LED -> 5215/256
+//   fade:  elapsed / 50 rad -> 209/256 per ms
+#define WAVE_PHASE_PER_MS   521
+#define WAVE_PHASE_PER_LED  5215
+#define FADE_PHASE_PER_MS   209
+
+void RainbowPattern::render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) {
+  // Hue in 8.8 fixed point: one full wheel across the strip
+  uint32_t hue = (elapsed_ms / 10) << 8;
+  uint32_t step = 65536 / count;
+  for (uint16_t i = 0; i < count; i++) {
+    pixels[i] = led_wheel((hue >> 8) & 0xFF);
+    hue += step;
+  }
+}
+
+void ChasePattern::render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) {
+  memset(pixels, 0, count * sizeof(uint32_t));
+  uint32_t pos = (elapsed_ms / 50) % (count * 2);
+  if (pos < count) {
+    pixels[pos] = Adafruit_NeoPixel::Color(255, 0, 0, 0);  // Red
+  } else {
+    pixels[count * 2 - pos - 1] = Adafruit_NeoPixel::Color(0, 0, 255, 0);  // Blue
+  }
+}
+
+void FadePattern::render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) {
+  uint8_t level = led_sin8((elapsed_ms * FADE_PHASE_PER_MS) >> 8);
+  uint32_t color = Adafruit_NeoPixel::Color(level, level, level, 0);
+  for (uint16_t i = 0; i < count; i++) {
+    pixels[i] = color;
+  }
+}
+
+void WavePattern::render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) {
+  uint32_t phase = elapsed_ms * WAVE_PHASE_PER_MS;
+  for (uint16_t i = 0; i < count; i++) {
+    uint8_t wave = led_sin8(phase >> 8);
+    pixels[i] = Adafruit_NeoPixel::Color(wave, wave >> 1, wave >> 2, 0);
+    phase += WAVE_PHASE_PER_LED;
+  }
+}
+
+// Integer hash (lowbias32), so positions depend only on the 100 ms step
+static uint32_t sparkle_hash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352D;
+  x ^= x >> 15;
+  x *= 0x846CA68B;
+  x ^= x >> 16;
+  return x;
+}
+
+void SparklePattern::render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) {
+  // Same frame for the whole step, so the engine skips show() in between
+  uint32_t seed = elapsed_ms / 100;
+  memset(pixels, 0, count * sizeof(uint32_t));
+  for (uint8_t i = 0; i < 5; i++) {
+    pixels[sparkle_hash(seed * 5 + i) % count] = Adafruit_NeoPixel::Color(255, 255, 255, 0);
+  }
+}
@@ -0,0 +1,48 @@
+/*
+ * Built-in LED patterns
+ *
+ * Registered under PATTERN_RAINBOW ... PATTERN_SPARKLE by
+ * PatternEngine::register_builtin_patterns().
+ */
+
+#ifndef PATTERNS_H
+#define PATTERNS_H
+
+#include "PatternEngine.h"
+
+// Hue cycling along the strip
+class RainbowPattern : public Pattern {
+public:
+  RainbowPattern() : Pattern("rainbow") {}
+  void render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) override;
+};
+
+// Single pixel running out red and back blue
+class ChasePattern : public Pattern {
+public:
+  ChasePattern() : Pattern("chase") {}
+  void render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) override;
+};
+
+// Whole strip breathing white
+class FadePattern : public Pattern {
+public:
+  FadePattern() : Pattern("fade") {}
+  void render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) override;
+};
+
+// Warm sine wave travelling along the strip
+class WavePattern : public Pattern {
+public:
+  WavePattern() : Pattern("wave") {}
+  void render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) override;
+};
+
+// Five random white pixels, redrawn every 100 ms
+class SparklePattern : public Pattern {
+public:
+  SparklePattern() : Pattern("sparkle") {}
+  void render(uint32_t* pixels, uint16_t count, uint32_t elapsed_ms) override;
+};
+
+#endif
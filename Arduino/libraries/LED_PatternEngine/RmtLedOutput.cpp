@@ -0,0 +1,272 @@
+/*
+ * RMT LED output implementation
+ */
+
+#include "RmtLedOutput.h"
+
+#if LED_RMT_AVAILABLE
+
+// ============================================================================
+// STRIP ENCODER (pixel bytes, then the latch low time)
+// ============================================================================
+
+struct LedStripEncoder {
+  rmt_encoder_t base;  // First member, so rmt_encoder_t* casts back
+  rmt_encoder_handle_t bytes_encoder;
+  rmt_encoder_handle_t copy_encoder;
+  int state;
+  rmt_symbol_word_t reset_code;
+};
+
+static size_t led_encoder_encode(rmt_encoder_t* encoder, rmt_channel_handle_t channel,
+                                 const void* data, size_t size, rmt_encode_state_t* ret_state) {
+  LedStripEncoder* led = reinterpret_cast<LedStripEncoder*>(encoder);
+  rmt_encode_state_t session = RMT_ENCODING_RESET;
+  int state = RMT_ENCODING_RESET;
+  size_t encoded = 0;
+
+  if (led->state == 0) {
+    encoded += led->bytes_encoder->encode(led->bytes_encoder, channel, data, size, &session);
+    if (session & RMT_ENCODING_COMPLETE) {
+      led->state = 1;
+    }
+    if (session & RMT_ENCODING_MEM_FULL) {
+      *ret_state = (rmt_encode_state_t)(state | RMT_ENCODING_MEM_FULL);
+      return encoded;
+    }
+  }
+
+  if (led->state == 1) {
+    encoded += led->copy_encoder->encode(led->copy_encoder, channel, &led->reset_code,
+                                         sizeof(led->reset_code), &session);
+    if (session & RMT_ENCODING_COMPLETE) {
+      led->state = 0;
+      state |= RMT_ENCODING_COMPLETE;
+    }
+    if (session & RMT_ENCODING_MEM_FULL) {
+      state |= RMT_ENCODING_MEM_FULL;
+    }
+  }
+
+  *ret_state = (rmt_encode_state_t)state;
+  return encoded;
+}
+
+static esp_err_t led_encoder_reset(rmt_encoder_t* encoder) {
+  LedStripEncoder* led = reinterpret_cast<LedStripEncoder*>(encoder);
+  rmt_encoder_reset(led->bytes_encoder);
+  rmt_encoder_reset(led->copy_encoder);
+  led->state = 0;
+  return ESP_OK;
+}
+
+static esp_err_t led_encoder_del(rmt_encoder_t* encoder) {
+  LedStripEncoder* led = reinterpret_cast<LedStripEncoder*>(encoder);
+  rmt_del_encoder(led->bytes_encoder);
+  rmt_del_encoder(led->copy_encoder);
+  free(led);
+  return ESP_OK;
+}
+
+static esp_err_t led_encoder_new(rmt_encoder_handle_t* ret) {
+  LedStripEncoder* led = (LedStripEncoder*)calloc(1, sizeof(LedStripEncoder));
+  if (!led) {
+    return ESP_ERR_NO_MEM;
+  }
+  led->base.encode = led_encoder_encode;
+  led->base.reset = led_encoder_reset;
+  led->base.del = led_encoder_del;
+
+  rmt_bytes_encoder_config_t bytes_config = {};
+  bytes_config.bit0.level0 = 1;
+  bytes_config.bit0.duration0 = RMT_LED_T0H;
+  bytes_config.bit0.level1 = 0;
+  bytes_config.bit0.duration1 = RMT_LED_T0L;
+  bytes_config.bit1.level0 = 1;
+  bytes_config.bit1.duration0 = RMT_LED_T1H;
+  bytes_config.bit1.level1 = 0;
+  bytes_config.bit1.duration1 = RMT_LED_T1L;
+  bytes_config.flags.msb_first = 1;
+
+  rmt_copy_encoder_config_t copy_config = {};
+
+  if (rmt_new_bytes_encoder(&bytes_config, &led->bytes_encoder) != ESP_OK) {
+    free(led);
+    return ESP_FAIL;
+  }
+  if (rmt_new_copy_encoder(&copy_config, &led->copy_encoder) != ESP_OK) {
+    rmt_del_encoder(led->bytes_encoder);
+    free(led);
+    return ESP_FAIL;
+  }
+
+  led->reset_code.level0 = 0;
+  led->reset_code.duration0 = RMT_LED_RESET_TICKS / 2;
+  led->reset_code.level1 = 0;
+  led->reset_code.duration1 = RMT_LED_RESET_TICKS / 2;
+
+  *ret = &led->base;
+  return ESP_OK;
+}
+
+#endif  // LED_RMT_AVAILABLE
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+RmtLedOutput::RmtLedOutput(uint8_t pin, uint16_t count, uint8_t order)
+  : _pin(pin), _count(count), _order(order),
+    _bytes_per_led(order == LED_ORDER_GRB ? 3 : 4), _next(0),
+    _frames_dropped(0), _free(nullptr) {
+  _buffers[0] = nullptr;
+  _buffers[1] = nullptr;
+#if LED_RMT_AVAILABLE
+  _channel = nullptr;
+  _encoder = nullptr;
+#endif
+}
+
+RmtLedOutput::~RmtLedOutput() {
+  end();
+}
+
+bool RmtLedOutput::begin() {
+#if LED_RMT_AVAILABLE
+  if (_channel) {
+    return true;
+  }
+
+  size_t frame_len = (size_t)_count * _bytes_per_led;
+  _buffers[0] = (uint8_t*)malloc(frame_len);
+  _buffers[1] = (uint8_t*)malloc(frame_len);
+  _free = xSemaphoreCreateCounting(2, 2);
+  if (!_buffers[0] || !_buffers[1] || !_free) {
+    end();
+    return false;
+  }
+
+  rmt_tx_channel_config_t config = {};
+  config.gpio_num = (gpio_num_t)_pin;
+  config.clk_src = RMT_CLK_SRC_DEFAULT;
+  config.resolution_hz = RMT_LED_RESOLUTION_HZ;
+  config.mem_block_symbols = RMT_LED_DMA_SYMBOLS;
+  config.trans_queue_depth = 2;  // One frame on the wire, one queued
+  config.flags.with_dma = 1;
+
+  // The S3 has a single DMA-capable TX channel; further strips fall back
+  // to the channel's own RAM, refilled from the RMT interrupt
+  if (rmt_new_tx_channel(&config, &_channel) != ESP_OK) {
+    config.mem_block_symbols = RMT_LED_MEM_SYMBOLS;
+    config.flags.with_dma = 0;
+    if (rmt_new_tx_channel(&config, &_channel) != ESP_OK) {
+      _channel = nullptr;
+      end();
+      return false;
+    }
+  }
+
+  rmt_tx_event_callbacks_t callbacks = {};
+  callbacks.on_trans_done = _on_done;
+
+  if (led_encoder_new(&_encoder) != ESP_OK ||
+      rmt_tx_register_event_callbacks(_channel, &callbacks, this) != ESP_OK ||
+      rmt_enable(_channel) != ESP_OK) {
+    end();
+    return false;
+  }
+
+  _next = 0;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void RmtLedOutput::end() {
+#if LED_RMT_AVAILABLE
+  if (_channel) {
+    rmt_tx_wait_all_done(_channel, RMT_LED_TIMEOUT_MS);
+    rmt_disable(_channel);
+    rmt_del_channel(_channel);
+    _channel = nullptr;
+  }
+  if (_encoder) {
+    rmt_del_encoder(_encoder);
+    _encoder = nullptr;
+  }
+#endif
+  if (_free) {
+    vSemaphoreDelete(_free);
+    _free = nullptr;
+  }
+  free(_buffers[0]);
+  free(_buffers[1]);
+  _buffers[0] = nullptr;
+  _buffers[1] = nullptr;
+}
+
+bool RmtLedOutput::show(const uint32_t* pixels, uint16_t count) {
+#if LED_RMT_AVAILABLE
+  if (!_channel) {
+    return false;
+  }
+
+  // Wait for the older of the two frames in flight to finish
+  if (xSemaphoreTake(_free, pdMS_TO_TICKS(RMT_LED_TIMEOUT_MS)) != pdTRUE) {
+    _frames_dropped++;
+    return false;
+  }
+
+  if (count > _count) {
+    count = _count;
+  }
+
+  uint8_t* p = _buffers[_next];
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t c = pixels[i];
+    *p++ = _levels[(c >> 8) & 0xFF];   // G
+    *p++ = _levels[(c >> 16) & 0xFF];  // R
+    *p++ = _levels[c & 0xFF];          // B
+    if (_bytes_per_led == 4) {
+      *p++ = _levels[c >> 24];         // W
+    }
+  }
+  // LEDs past count are sent dark
+  memset(p, 0, (size_t)(_count - count) * _bytes_per_led);
+
+  rmt_transmit_config_t tx = {};
+  tx.loop_count = 0;
+
+  if (rmt_transmit(_channel, _encoder, _buffers[_next],
+                   (size_t)_count * _bytes_per_led, &tx) != ESP_OK) {
+    xSemaphoreGive(_free);
+    _frames_dropped++;
+    return false;
+  }
+
+  // Transfers complete in order, so the buffer freed next is this other one
+  _next ^= 1;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void RmtLedOutput::wait() {
+#if LED_RMT_AVAILABLE
+  if (_channel) {
+    rmt_tx_wait_all_done(_channel, RMT_LED_TIMEOUT_MS);
+  }
+#endif
+}
+
+#if LED_RMT_AVAILABLE
+bool RmtLedOutput::_on_done(rmt_channel_handle_t channel,
+                            const rmt_tx_done_event_data_t* event, void* arg) {
+  RmtLedOutput* output = static_cast<RmtLedOutput*>(arg);
+  BaseType_t woken = pdFALSE;
+  xSemaphoreGiveFromISR(output->_free, &woken);
+  return woken == pdTRUE;
+}
+#endif
@@ -0,0 +1,81 @@
+/*
+ * RMT LED output (ESP32-S3)
+ *
+ * Clocks SK6812/WS2812 frames out through the RMT peripheral with DMA
+ * instead of timing bits on the CPU. Frames are double buffered: show()
+ * packs the frame into the free buffer, queues it and returns. It only
+ * waits if two frames are already in flight.
+ *
+ * The first strip begun gets the DMA channel; later ones run from channel
+ * RAM with the same double buffering.
+ *
+ * Requires the ESP-IDF 5 RMT driver (arduino-esp32 3.x). On older cores
+ * begin() fails; use NeoPixelOutput there.
+ */
+
+#ifndef RMT_LED_OUTPUT_H
+#define RMT_LED_OUTPUT_H
+
+#include "LedOutput.h"
+#include <esp_idf_version.h>
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <driver/rmt_tx.h>
+#define LED_RMT_AVAILABLE 1
+#else
+#define LED_RMT_AVAILABLE 0
+#endif
+
+// Strip byte orders
+#define LED_ORDER_GRBW 0  // SK6812 RGBW
+#define LED_ORDER_GRB  1  // WS2812B / SK6812 RGB
+
+// RMT timing (10 MHz resolution, 0.1 us per tick)
+#define RMT_LED_RESOLUTION_HZ 10000000
+#define RMT_LED_T0H  3    // 0.3 us
+#define RMT_LED_T0L  9    // 0.9 us
+#define RMT_LED_T1H  6    // 0.6 us
+#define RMT_LED_T1L  6    // 0.6 us
+#define RMT_LED_RESET_TICKS 800  // 80 us latch
+
+#define RMT_LED_DMA_SYMBOLS 1024  // DMA buffer size in RMT symbols
+#define RMT_LED_MEM_SYMBOLS 48    // Channel RAM when no DMA channel is left
+#define RMT_LED_TIMEOUT_MS  100   // Longest show() waits for a free buffer
+
+class RmtLedOutput : public LedOutput {
+public:
+  RmtLedOutput(uint8_t pin, uint16_t count, uint8_t order = LED_ORDER_GRBW);
+  ~RmtLedOutput();
+
+  bool begin() override;
+  void end();
+
+  uint16_t count() override { return _count; }
+  bool show(const uint32_t* pixels, uint16_t count) override;
+  void wait() override;
+
+  // Frames show() dropped because no buffer freed up in time
+  uint32_t get_frames_dropped() { return _frames_dropped; }
+
+private:
+  uint8_t _pin;
+  uint16_t _count;
+  uint8_t _order;
+  uint8_t _bytes_per_led;
+
+  uint8_t* _buffers[2];
+  uint8_t _next;  // Buffer the next frame is packed into
+  uint32_t _frames_dropped;
+
+  SemaphoreHandle_t _free;  // Buffers not owned by the RMT (0-2)
+
+#if LED_RMT_AVAILABLE
+  rmt_channel_handle_t _channel;
+  rmt_encoder_handle_t _encoder;
+
+  static bool _on_done(rmt_channel_handle_t channel,
+                       const rmt_tx_done_event_data_t* event, void* arg);
+#endif
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * ESP32-S3 High-Rate BME680 Sampler with MQTT (leak detection)
+ *
+ * Features:
+ * - BME680 in continuous T/P/H mode: back-to-back forced conversions at
+ *   1x oversampling, gas heater off (about 90 conversions per second)
+ * - Fixed-point decimation and IIR smoothing on the device; only the
+ *   decimated stream is published
+ * - Achieved conversion rate and lost conversions reported with every
+ *   reading
+ *
+ * Hardware:
+ * - ESP32-S3 (lonely binary GOLD EDITION)
+ * - BME680 on I2C (default 0x76 or 0x77)
+ *
+ * Libraries Required:
+ * - WiFi (built-in)
+ * - Wire (built-in)
+ * - PubSubClient (MQTT)
+ * - ConnectionManager (WiFi/MQTT reconnects, included in Arduino/libraries)
+ * - BME680_Custom and HotPathMetrics (included in Arduino/libraries)
+ */
+
+#include <WiFi.h>
+#include <Wire.h>
+#include <PubSubClient.h>
+#include <ConnectionManager.h>  // Non-blocking WiFi/MQTT state machine
+#include "BME680_Custom.h"      // Custom BME680 library with continuous mode
+#include <ArduinoJson.h>
+
+// ============================================================================
+// CONFIGURATION - Modify these values for your setup
+// ============================================================================
+
+// WiFi Configuration
+const char* ssid = "YOUR_WIFI_SSID";
+const char* password = "YOUR_WIFI_PASSWORD";
+
+// MQTT Configuration
+const char* mqtt_server = "192.168.1.XXX";  // Raspberry Pi IP address
+const int mqtt_port = 1883;
+const char* mqtt_client_id = "esp32-s3-bme680-fast";
+const char* mqtt_topic_readings = "sensors/bme680-fast/readings";
+const char* mqtt_topic_status = "sensors/bme680-fast/status";
+
+// I2C Configuration
+#define I2C_SDA 21  // Default I2C SDA pin
+#define I2C_SCL 22  // Default I2C SCL pin
+#define I2C_CLOCK 400000  // Fast mode: one conversion read is 11 bytes
+
+// BME680 Configuration
+#define BME680_I2C_ADDRESS BME680_I2C_ADDR_SECONDARY  // Use BME680_I2C_ADDR_PRIMARY (0x76) if SDO is connected to GND
+BME680_Custom bme680(BME680_I2C_ADDRESS);
+
+// Decimation
+// DECIMATION conversions are averaged into one output (about 5.6 outputs
+// per second at 16), then smoothed by y += (x - y) >> IIR_SHIFT
+#define DECIMATION 16
+#define IIR_SHIFT  2   // 0 = no smoothing
+
+const unsigned long STATUS_INTERVAL = 60000;
+
+// ============================================================================
+// GLOBAL VARIABLES
+// ============================================================================
+
+WiFiClient wifi_client;
+PubSubClient mqtt_client(wifi_client);
+ConnectionManager connection(&mqtt_client);
+
+bool bme680_found = false;
+uint32_t outputs_published = 0;
+uint32_t outputs_dropped = 0;     // Decimated outputs while offline
+unsigned long last_status = 0;
+
+// ============================================================================
+// SETUP
+// ============================================================================
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  
+  Serial.println("\n\n========================================");
+  Serial.println("ESP32-S3 High-Rate BME680 Sampler");
+  Serial.println("========================================\n");
+  
+  Wire.begin(I2C_SDA, I2C_SCL);
+  Wire.setClock(I2C_CLOCK);
+  
+  bme680_found = bme680.begin() && bme680.start_continuous(DECIMATION, IIR_SHIFT);
+  if (bme680_found) {
+    Serial.printf("✓ BME680 continuous mode: %u ms per conversion, %u per output\n",
+                  bme680.get_measurement_duration(), DECIMATION);
+  } else {
+    Serial.println("✗ BME680 sensor not found!");
+  }
+  
+  mqtt_client.setServer(mqtt_server, mqtt_port);
+  connection.set_on_connect(onMQTTConnected);
+  connection.begin(ssid, password, mqtt_client_id);
+}
+
+// ============================================================================
+// MAIN LOOP
+// ============================================================================
+
+void loop() {
+  connection.loop();
+  
+  if (bme680_found && bme680.poll_continuous() == MEAS_READY) {
+    publishReading();
+  }
+  
+  if (connection.online() && millis() - last_status >= STATUS_INTERVAL) {
+    last_status = millis();
+    publishStatus("online");
+  }
+  
+  // Sleep until the next conversion is due
+  uint16_t wait = bme680_found ? bme680.get_time_until_ready() : 10;
+  delay(wait > 0 ? wait : 1);
+}
+
+// ============================================================================
+// MQTT FUNCTIONS
+// ============================================================================
+
+void onMQTTConnected() {
+  Serial.printf("✓ Connected to MQTT broker %s:%d\n", mqtt_server, mqtt_port);
+  publishStatus("online");
+}
+
+void publishReading() {
+  const ContinuousData& c = bme680.continuous;
+  
+  if (!connection.online()) {
+    outputs_dropped++;
+    return;
+  }
+  
+  StaticJsonDocument<200> doc;
+  doc["temperature"] = c.temperature / 100.0;
+  doc["pressure"] = c.pressure / 100.0;
+  doc["humidity"] = c.humidity / 1000.0;
+  doc["samples"] = c.samples;
+  doc["rate"] = c.rate / 100.0;
+  doc["timestamp"] = millis();
+  
+  char payload[160];
+  serializeJson(doc, payload);
+  if (mqtt_client.publish(mqtt_topic_readings, payload)) {
+    outputs_published++;
+  } else {
+    outputs_dropped++;
+  }
+}
+
+void publishStatus(const char* status) {
+  StaticJsonDocument<256> doc;
+  doc["status"] = status;
+  doc["uptime"] = millis() / 1000;
+  doc["rate"] = bme680.continuous.rate / 100.0;
+  doc["lost"] = bme680.continuous.lost;
+  doc["published"] = outputs_published;
+  doc["dropped"] = outputs_dropped;
+  doc["reconnects"] = connection.get_reconnects();
+  doc["wifi_rssi"] = WiFi.RSSI();
+  
+  char payload[224];
+  serializeJson(doc, payload);
+  mqtt_client.publish(mqtt_topic_status, payload);
+}
@@ -9,6 +9,10 @@
  * - HTTP REST API server (port 80)
  * - Direct WiFi communication (no MQTT broker needed)
  * - Multiple LED patterns and effects
+ * - Responses streamed from flash and a fixed buffer (no String building)
+ * - HTTP served from its own task, so slow clients don't stall patterns
+ * - Server-Sent Events stream (/api/events) of LED state changes
+ * - Hot-path timing histograms (/api/metrics)
  * 
  * Hardware:
  * - ESP32-S3 (lonely binary GOLD EDITION)
@@ -18,12 +22,19 @@
  * - WiFi (built-in)
  * - WebServer (built-in ESP32)
  * - Adafruit NeoPixel (for SK6812)
+ * - LED_PatternEngine (LedTables.h only, included in Arduino/libraries)
+ * - ConnectionManager (WiFi reconnects, included in Arduino/libraries)
+ * - HotPathMetrics (cycle-counter timing, included in Arduino/libraries)
+ * - PubSubClient (dependency of ConnectionManager, not used here)
  * - ArduinoJson (for JSON parsing)
  */
 
 #include <WiFi.h>
 #include <WebServer.h>
 #include <Adafruit_NeoPixel.h>
+#include <LedTables.h>  // Sine/wheel lookup tables for the patterns
+#include <ConnectionManager.h>  // Non-blocking WiFi join with fast rejoin
+#include <HotPathMetrics.h>     // Cycle-counter timing histograms
 #include <ArduinoJson.h>
 
 // ============================================================================
@@ -37,6 +48,26 @@ const char* password = "YOUR_WIFI_PASSWORD";
 // HTTP Server Configuration
 const int http_port = 80;
 
+// Responses are formatted into one preallocated buffer and sent as
+// chunks, so a request doesn't build Strings on the heap
+#define HTTP_RESPONSE_BUFFER 512
+
+// Serve HTTP from a dedicated task. A slow or stalled client then only
+// blocks that task; patterns keep rendering in loop(). Set to false to
+// call handleClient() from loop() as before.
+#define HTTP_SERVER_TASK true
+#define HTTP_TASK_CORE 0
+#define HTTP_TASK_PRIORITY 1
+#define HTTP_TASK_STACK 6144
+
+// Server-Sent Events (/api/events)
+// Each client gets a fixed queue of formatted events. A client that falls
+// SSE_QUEUE_DEPTH events behind is sent one full "state" event instead.
+#define SSE_MAX_CLIENTS 4
+#define SSE_QUEUE_DEPTH 8         // Power of two
+#define SSE_EVENT_SIZE 160        // Longest formatted event
+#define SSE_KEEPALIVE_MS 15000    // Comment line so proxies keep the stream open
+
 // SK6812 LED Strip Configuration
 #define LED_PIN 4        // GPIO pin for LED data line (change as needed)
 #define LED_COUNT 30     // Number of LEDs in strip
@@ -50,11 +81,66 @@ Adafruit_NeoPixel strip(LED_COUNT, LED_PIN, NEO_GRBW + NEO_KHZ800);
 
 WebServer server(http_port);
 
-// LED state
+// WiFi only (no MQTT client). The cached lease also keeps the address the
+// Raspberry Pi sends requests to.
+ConnectionManager connection;
+bool wifi_online = false;  // loop() only
+
+// Pattern renderers (defined under LED PATTERN FUNCTIONS)
+void rainbowPattern(unsigned long elapsed);
+void chasePattern(unsigned long elapsed);
+void fadePattern(unsigned long elapsed);
+void wavePattern(unsigned long elapsed);
+void sparklePattern(unsigned long elapsed);
+
+struct PatternInfo {
+  const char* name;
+  const char* description;
+  void (*render)(unsigned long elapsed);
+};
+
+const PatternInfo pattern_table[] = {
+  { "rainbow", "Rainbow cycle",       rainbowPattern },
+  { "chase",   "Color chase effect",  chasePattern },
+  { "fade",    "Fade in/out",         fadePattern },
+  { "wave",    "Wave effect",         wavePattern },
+  { "sparkle", "Random sparkles",     sparklePattern },
+};
+
+// LED state (guarded by led_lock when HTTP runs in its own task)
 uint8_t current_brightness = LED_BRIGHTNESS;
 bool pattern_running = false;
 unsigned long pattern_start_time = 0;
-String current_pattern = "";
+const PatternInfo* current_pattern = nullptr;
+uint8_t current_speed = 50;
+uint32_t current_color = 0;  // Last solid color set, 0xWWRRGGBB
+SemaphoreHandle_t led_lock = nullptr;
+
+// Timed sites (see HotPathMetrics.h), reported by /api/metrics
+METRIC_SITE(metric_strip_show, "strip_show");
+METRIC_SITE(metric_json, "json");
+
+// Event stream clients (HTTP handlers only, like the response writer)
+struct SseEvent {
+  uint16_t len;
+  char text[SSE_EVENT_SIZE];
+};
+
+struct SseClient {
+  WiFiClient client;
+  bool active;
+  bool resync;           // Queue overflowed or new client: send "state" next
+  uint8_t head;          // Free-running; masked with SSE_QUEUE_DEPTH - 1
+  uint8_t tail;
+  unsigned long last_write;
+  SseEvent queue[SSE_QUEUE_DEPTH];
+};
+
+SseClient sse_clients[SSE_MAX_CLIENTS];
+
+// Response writer state (HTTP handlers only)
+char http_buffer[HTTP_RESPONSE_BUFFER];
+size_t http_buffer_len = 0;
 
 // ============================================================================
 // SETUP
@@ -68,28 +154,33 @@ void setup() {
   Serial.println("ESP32-S3 LED Controller - HTTP API");
   Serial.println("========================================\n");
   
+  led_lock = xSemaphoreCreateMutex();
+  
   // Initialize LED strip
   strip.begin();
   strip.setBrightness(current_brightness);
   strip.clear();
-  strip.show();
+  showStrip();
   Serial.println("✓ SK6812 LED strip initialized");
   
-  // Connect to WiFi
-  connectWiFi();
+  // Join WiFi in the background; loop() reports when the link is up
+  Serial.print("Connecting to WiFi: ");
+  Serial.println(ssid);
+  connection.begin(ssid, password);
   
   // Setup HTTP server routes
   setupHTTPServer();
   
-  // Start HTTP server
+  // Start HTTP server (accepts requests once WiFi is up)
   server.begin();
   Serial.print("✓ HTTP server started on port ");
   Serial.println(http_port);
-  Serial.print("  Access at: http://");
-  Serial.println(WiFi.localIP());
   
-  // Initial status LED indication
-  showStatusLED();
+  // Requests are served from here on
+#if HTTP_SERVER_TASK
+  xTaskCreatePinnedToCore(httpTask, "http", HTTP_TASK_STACK, nullptr,
+                          HTTP_TASK_PRIORITY, nullptr, HTTP_TASK_CORE);
+#endif
   
   Serial.println("\n✓ Setup complete! Ready for HTTP commands...\n");
 }
@@ -99,43 +190,67 @@ void setup() {
 // ============================================================================
 
 void loop() {
+  connection.loop();
+  if (connection.online() != wifi_online) {
+    wifi_online = connection.online();
+    reportWiFiState();
+  }
+  
+#if !HTTP_SERVER_TASK
   server.handleClient();  // Handle HTTP requests (non-blocking)
+  serviceEventClients();
+#endif
   
   // Update running patterns
+  lockLEDs();
   if (pattern_running) {
     updatePattern();
   }
+  unlockLEDs();
   
   delay(10); // Small delay to prevent watchdog issues
 }
 
+#if HTTP_SERVER_TASK
+void httpTask(void* param) {
+  for (;;) {
+    server.handleClient();
+    serviceEventClients();
+    vTaskDelay(pdMS_TO_TICKS(2));
+  }
+}
+#endif
+
+void lockLEDs() {
+  xSemaphoreTake(led_lock, portMAX_DELAY);
+}
+
+void unlockLEDs() {
+  xSemaphoreGive(led_lock);
+}
+
 // ============================================================================
 // WIFI FUNCTIONS
 // ============================================================================
 
-void connectWiFi() {
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(ssid);
-  
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, password);
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
-  }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\n✓ WiFi connected!");
-    Serial.print("  IP address: ");
+void reportWiFiState() {
+  if (wifi_online) {
+    Serial.printf("✓ WiFi connected (%s join", connection.get_fast_join() ? "cached" : "full");
+    if (connection.get_reconnects() > 0) {
+      Serial.printf(", offline %lu ms", (unsigned long)connection.get_last_outage_ms());
+    }
+    Serial.println(")");
+    Serial.print("  Access at: http://");
     Serial.println(WiFi.localIP());
     Serial.print("  MAC address: ");
     Serial.println(WiFi.macAddress());
   } else {
-    Serial.println("\n✗ WiFi connection failed!");
+    Serial.println("✗ WiFi connection lost - reconnecting");
   }
+  
+  lockLEDs();
+  showStatusLED();
+  unlockLEDs();
 }
 
 // ============================================================================
@@ -156,167 +271,482 @@ void setupHTTPServer() {
   // Status endpoint
   server.on("/api/status", HTTP_GET, handleStatus);
   
+  // Timing histograms
+  server.on("/api/metrics", HTTP_GET, handleMetrics);
+  
+  // Live state changes (Server-Sent Events)
+  server.on("/api/events", HTTP_GET, handleEvents);
+  
   // 404 handler
   server.onNotFound(handleNotFound);
 }
 
+// ============================================================================
+// HTTP RESPONSE WRITER
+// ============================================================================
+
+const char ROOT_HTML_HEAD[] PROGMEM =
+  "<!DOCTYPE html><html><head><title>ESP32-S3 LED Controller</title></head><body>"
+  "<h1>ESP32-S3 LED Controller API</h1>"
+  "<h2>Endpoints:</h2>"
+  "<ul>"
+  "<li><b>POST /api/led/color</b> - Set LED color (JSON: {\"r\":255,\"g\":0,\"b\":0,\"w\":0})</li>"
+  "<li><b>POST /api/led/brightness</b> - Set brightness (JSON: {\"value\":128})</li>"
+  "<li><b>POST /api/led/clear</b> - Clear all LEDs</li>"
+  "<li><b>POST /api/led/pattern</b> - Start pattern (JSON: {\"name\":\"rainbow\",\"speed\":50})</li>"
+  "<li><b>POST /api/led/stop</b> - Stop current pattern</li>"
+  "<li><b>GET /api/status</b> - Get device status</li>"
+  "<li><b>GET /api/metrics</b> - Timing per code site (?reset=1 starts a new interval)</li>"
+  "<li><b>GET /api/events</b> - Live LED state changes (Server-Sent Events)</li>"
+  "</ul>"
+  "<h2>Patterns:</h2>"
+  "<ul>";
+
+const char ROOT_HTML_TAIL[] PROGMEM =
+  "</ul>"
+  "</body></html>";
+
+// Starts a chunked response; body follows through writeResponse*()
+void beginResponse(int code, const char* content_type) {
+  http_buffer_len = 0;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(code, content_type, "");
+}
+
+void flushResponse() {
+  if (http_buffer_len > 0) {
+    server.sendContent(http_buffer, http_buffer_len);
+    http_buffer_len = 0;
+  }
+}
+
+// printf into the response buffer, flushing it first if the text won't
+// fit. A single write longer than the buffer is truncated.
+void writeResponse(const char* format, ...) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    size_t space = sizeof(http_buffer) - http_buffer_len;
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(http_buffer + http_buffer_len, space, format, args);
+    va_end(args);
+    
+    if (len < 0) {
+      return;
+    }
+    if ((size_t)len < space) {
+      http_buffer_len += len;
+      return;
+    }
+    if (http_buffer_len == 0) {
+      http_buffer_len = sizeof(http_buffer) - 1;  // Truncated
+      return;
+    }
+    flushResponse();
+  }
+}
+
+// Flash text is sent straight from flash as its own chunk
+void writeResponse_P(PGM_P text) {
+  flushResponse();
+  server.sendContent_P(text);
+}
+
+void endResponse() {
+  flushResponse();
+  server.sendContent("", 0);  // Terminating chunk
+}
+
+// Small fixed-size JSON replies, sent with a Content-Length
+void sendJson(int code, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int len;
+  {
+    METRIC_SCOPE(metric_json);
+    len = vsnprintf(http_buffer, sizeof(http_buffer), format, args);
+  }
+  va_end(args);
+  
+  if (len < 0) {
+    len = 0;
+  } else if ((size_t)len >= sizeof(http_buffer)) {
+    len = sizeof(http_buffer) - 1;
+  }
+  server.send_P(code, "application/json", http_buffer, len);
+}
+
 // ============================================================================
 // HTTP REQUEST HANDLERS
 // ============================================================================
 
 void handleRoot() {
-  String html = "<!DOCTYPE html><html><head><title>ESP32-S3 LED Controller</title></head><body>";
-  html += "<h1>ESP32-S3 LED Controller API</h1>";
-  html += "<h2>Endpoints:</h2>";
-  html += "<ul>";
-  html += "<li><b>POST /api/led/color</b> - Set LED color (JSON: {\"r\":255,\"g\":0,\"b\":0,\"w\":0})</li>";
-  html += "<li><b>POST /api/led/brightness</b> - Set brightness (JSON: {\"value\":128})</li>";
-  html += "<li><b>POST /api/led/clear</b> - Clear all LEDs</li>";
-  html += "<li><b>POST /api/led/pattern</b> - Start pattern (JSON: {\"name\":\"rainbow\",\"speed\":50})</li>";
-  html += "<li><b>POST /api/led/stop</b> - Stop current pattern</li>";
-  html += "<li><b>GET /api/status</b> - Get device status</li>";
-  html += "</ul>";
-  html += "<h2>Patterns:</h2>";
-  html += "<ul>";
-  html += "<li>rainbow - Rainbow cycle</li>";
-  html += "<li>chase - Color chase effect</li>";
-  html += "<li>fade - Fade in/out</li>";
-  html += "<li>wave - Wave effect</li>";
-  html += "<li>sparkle - Random sparkles</li>";
-  html += "</ul>";
-  html += "</body></html>";
-  
-  server.send(200, "text/html", html);
+  beginResponse(200, "text/html");
+  writeResponse_P(ROOT_HTML_HEAD);
+  for (const PatternInfo& pattern : pattern_table) {
+    writeResponse("<li>%s - %s</li>", pattern.name, pattern.description);
+  }
+  writeResponse_P(ROOT_HTML_TAIL);
+  endResponse();
 }
 
 void handleSetColor() {
   if (server.hasArg("plain")) {
-    String body = server.arg("plain");
-    
     StaticJsonDocument<200> doc;
-    DeserializationError error = deserializeJson(doc, body);
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
     
     if (error) {
-      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      sendJson(400, "{\"error\":\"Invalid JSON\"}");
       return;
     }
     
-    // Stop any running pattern
-    pattern_running = false;
-    
     uint8_t r = doc["r"] | 0;
     uint8_t g = doc["g"] | 0;
     uint8_t b = doc["b"] | 0;
     uint8_t w = doc["w"] | 0;
     
+    lockLEDs();
+    bool was_running = pattern_running;
+    pattern_running = false;  // Stop any running pattern
+    current_pattern = nullptr;
+    current_color = Adafruit_NeoPixel::Color(r, g, b, w);
     setLEDColor(r, g, b, w);
+    unlockLEDs();
+    
+    if (was_running) {
+      publishPatternEvent();
+    }
+    publishColorEvent();
     
     Serial.printf("LED color set via HTTP: R=%d G=%d B=%d W=%d\n", r, g, b, w);
     
-    server.send(200, "application/json", "{\"status\":\"ok\",\"color\":{\"r\":" + String(r) + ",\"g\":" + String(g) + ",\"b\":" + String(b) + ",\"w\":" + String(w) + "}}");
+    sendJson(200, "{\"status\":\"ok\",\"color\":{\"r\":%u,\"g\":%u,\"b\":%u,\"w\":%u}}", r, g, b, w);
   } else {
-    server.send(400, "application/json", "{\"error\":\"No data provided\"}");
+    sendJson(400, "{\"error\":\"No data provided\"}");
   }
 }
 
 void handleSetBrightness() {
   if (server.hasArg("plain")) {
-    String body = server.arg("plain");
-    
     StaticJsonDocument<200> doc;
-    DeserializationError error = deserializeJson(doc, body);
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
     
     if (error) {
-      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      sendJson(400, "{\"error\":\"Invalid JSON\"}");
       return;
     }
     
     uint8_t brightness = doc["value"] | current_brightness;
     if (brightness > 255) brightness = 255;
     
+    lockLEDs();
     current_brightness = brightness;
     strip.setBrightness(brightness);
-    strip.show();
+    showStrip();
+    unlockLEDs();
+    
+    publishEvent("brightness", "{\"brightness\":%u}", brightness);
     
     Serial.printf("LED brightness set via HTTP: %d\n", brightness);
     
-    server.send(200, "application/json", "{\"status\":\"ok\",\"brightness\":" + String(brightness) + "}");
+    sendJson(200, "{\"status\":\"ok\",\"brightness\":%u}", brightness);
   } else {
-    server.send(400, "application/json", "{\"error\":\"No data provided\"}");
+    sendJson(400, "{\"error\":\"No data provided\"}");
   }
 }
 
 void handleClear() {
+  lockLEDs();
+  bool was_running = pattern_running;
   pattern_running = false;
+  current_pattern = nullptr;
+  current_color = 0;
   strip.clear();
-  strip.show();
+  showStrip();
+  unlockLEDs();
+  
+  if (was_running) {
+    publishPatternEvent();
+  }
+  publishColorEvent();
   
   Serial.println("LED strip cleared via HTTP");
   
-  server.send(200, "application/json", "{\"status\":\"ok\",\"message\":\"LEDs cleared\"}");
+  sendJson(200, "{\"status\":\"ok\",\"message\":\"LEDs cleared\"}");
 }
 
 void handlePattern() {
   if (server.hasArg("plain")) {
-    String body = server.arg("plain");
-    
     StaticJsonDocument<200> doc;
-    DeserializationError error = deserializeJson(doc, body);
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
     
     if (error) {
-      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      sendJson(400, "{\"error\":\"Invalid JSON\"}");
       return;
     }
     
-    String pattern_name = doc["name"] | "";
+    const char* pattern_name = doc["name"] | "";
     int speed = doc["speed"] | 50;
     
-    if (pattern_name == "") {
-      server.send(400, "application/json", "{\"error\":\"Pattern name required\"}");
+    if (pattern_name[0] == '\0') {
+      sendJson(400, "{\"error\":\"Pattern name required\"}");
+      return;
+    }
+    
+    const PatternInfo* pattern = findPattern(pattern_name);
+    if (!pattern) {
+      sendJson(400, "{\"error\":\"Unknown pattern\"}");
       return;
     }
     
     // Start pattern
+    lockLEDs();
     pattern_running = true;
-    current_pattern = pattern_name;
+    current_pattern = pattern;
+    current_speed = constrain(speed, 0, 255);
     pattern_start_time = millis();
+    unlockLEDs();
+    
+    publishPatternEvent();
     
-    Serial.printf("Pattern started via HTTP: %s (speed: %d)\n", pattern_name.c_str(), speed);
+    Serial.printf("Pattern started via HTTP: %s (speed: %d)\n", pattern->name, speed);
     
-    server.send(200, "application/json", "{\"status\":\"ok\",\"pattern\":\"" + pattern_name + "\",\"speed\":" + String(speed) + "}");
+    sendJson(200, "{\"status\":\"ok\",\"pattern\":\"%s\",\"speed\":%d}", pattern->name, speed);
   } else {
-    server.send(400, "application/json", "{\"error\":\"No data provided\"}");
+    sendJson(400, "{\"error\":\"No data provided\"}");
   }
 }
 
 void handleStopPattern() {
+  lockLEDs();
+  bool was_running = pattern_running;
   pattern_running = false;
-  current_pattern = "";
+  current_pattern = nullptr;
+  unlockLEDs();
+  
+  if (was_running) {
+    publishPatternEvent();
+  }
   
   Serial.println("Pattern stopped via HTTP");
   
-  server.send(200, "application/json", "{\"status\":\"ok\",\"message\":\"Pattern stopped\"}");
+  sendJson(200, "{\"status\":\"ok\",\"message\":\"Pattern stopped\"}");
 }
 
 void handleStatus() {
-  StaticJsonDocument<300> doc;
-  doc["status"] = "online";
-  doc["uptime"] = millis() / 1000;
-  doc["free_heap"] = ESP.getFreeHeap();
-  doc["wifi_rssi"] = WiFi.RSSI();
-  doc["ip_address"] = WiFi.localIP().toString();
-  doc["brightness"] = current_brightness;
-  doc["pattern_running"] = pattern_running;
-  doc["current_pattern"] = current_pattern;
+  IPAddress ip = WiFi.localIP();
   
-  String response;
-  serializeJson(doc, response);
+  sendJson(200,
+           "{\"status\":\"online\",\"uptime\":%lu,\"free_heap\":%u,\"wifi_rssi\":%d,"
+           "\"ip_address\":\"%u.%u.%u.%u\",\"brightness\":%u,\"pattern_running\":%s,"
+           "\"current_pattern\":\"%s\"}",
+           millis() / 1000, (unsigned)ESP.getFreeHeap(), (int)WiFi.RSSI(),
+           ip[0], ip[1], ip[2], ip[3], current_brightness,
+           pattern_running ? "true" : "false",
+           current_pattern ? current_pattern->name : "");
+}
+
+// Per site since boot (or the last ?reset=1), times in microseconds
+void handleMetrics() {
+#if HOT_PATH_METRICS
+  beginResponse(200, "application/json");
+  writeResponse("{\"uptime\":%lu,\"cpu_mhz\":%u,\"sites\":{",
+                millis() / 1000, (unsigned)getCpuFrequencyMhz());
+  bool first = true;
+  for (MetricSite* site = MetricSite::first(); site; site = site->next()) {
+    MetricSummary m;
+    site->summary(m);
+    writeResponse("%s\"%s\":{\"count\":%u,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+                  first ? "" : ",", site->name(), (unsigned)m.count,
+                  m.p50_us, m.p99_us, m.max_us);
+    first = false;
+  }
+  writeResponse("}}");
+  endResponse();
   
-  server.send(200, "application/json", response);
+  if (server.hasArg("reset")) {
+    MetricSite::reset_all();
+  }
+#else
+  sendJson(404, "{\"error\":\"Metrics not compiled in\"}");
+#endif
 }
 
 void handleNotFound() {
-  server.send(404, "application/json", "{\"error\":\"Not found\"}");
+  sendJson(404, "{\"error\":\"Not found\"}");
+}
+
+// ============================================================================
+// EVENT STREAM (Server-Sent Events)
+// ============================================================================
+
+const char SSE_HEADERS[] PROGMEM =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Connection: keep-alive\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "\r\n";
+
+// Keeps the socket open after the handler returns: the slot holds its own
+// reference to the connection, and events are written by serviceEventClients()
+void handleEvents() {
+  SseClient* slot = nullptr;
+  for (SseClient& c : sse_clients) {
+    if (!c.active) {
+      slot = &c;
+      break;
+    }
+  }
+  if (!slot) {
+    sendJson(503, "{\"error\":\"Too many event clients\"}");
+    return;
+  }
+  
+  slot->client = server.client();
+  slot->client.setNoDelay(true);
+  slot->client.write((const uint8_t*)SSE_HEADERS, strlen_P(SSE_HEADERS));
+  slot->active = true;
+  slot->resync = true;  // Start with the full state
+  slot->head = 0;
+  slot->tail = 0;
+  slot->last_write = millis();
+  
+  Serial.printf("Event client connected (%d/%d)\n", eventClientCount(), SSE_MAX_CLIENTS);
+}
+
+int eventClientCount() {
+  int count = 0;
+  for (const SseClient& c : sse_clients) {
+    count += c.active;
+  }
+  return count;
+}
+
+bool vformatEvent(SseEvent& event, const char* name, const char* format, va_list args) {
+  int len = snprintf(event.text, sizeof(event.text), "event: %s\ndata: ", name);
+  if (len < 0 || (size_t)len >= sizeof(event.text)) {
+    return false;
+  }
+  int data = vsnprintf(event.text + len, sizeof(event.text) - len, format, args);
+  if (data < 0 || (size_t)(len + data + 2) >= sizeof(event.text)) {
+    return false;
+  }
+  len += data;
+  event.text[len++] = '\n';
+  event.text[len++] = '\n';
+  event.text[len] = '\0';
+  event.len = len;
+  return true;
+}
+
+bool formatEvent(SseEvent& event, const char* name, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool ok = vformatEvent(event, name, format, args);
+  va_end(args);
+  return ok;
+}
+
+// Queues one event for every connected client. Clients whose queue is
+// full drop their backlog and get a "state" event instead.
+void publishEvent(const char* name, const char* format, ...) {
+  if (eventClientCount() == 0) {
+    return;
+  }
+  
+  SseEvent event;
+  va_list args;
+  va_start(args, format);
+  bool ok = vformatEvent(event, name, format, args);
+  va_end(args);
+  if (!ok) {
+    return;
+  }
+  
+  for (SseClient& c : sse_clients) {
+    if (!c.active || c.resync) {
+      continue;
+    }
+    if ((uint8_t)(c.tail - c.head) >= SSE_QUEUE_DEPTH) {
+      c.head = c.tail;
+      c.resync = true;
+      continue;
+    }
+    c.queue[c.tail & (SSE_QUEUE_DEPTH - 1)] = event;
+    c.tail++;
+  }
+}
+
+void publishColorEvent() {
+  uint32_t c = current_color;
+  publishEvent("color", "{\"r\":%u,\"g\":%u,\"b\":%u,\"w\":%u}",
+               (unsigned)(c >> 16) & 0xFF, (unsigned)(c >> 8) & 0xFF,
+               (unsigned)c & 0xFF, (unsigned)(c >> 24));
+}
+
+void publishPatternEvent() {
+  if (current_pattern) {
+    publishEvent("pattern", "{\"pattern\":\"%s\",\"speed\":%u}", current_pattern->name, current_speed);
+  } else {
+    publishEvent("pattern", "{\"pattern\":null}");
+  }
+}
+
+bool writeEvent(SseClient& c, const char* text, size_t len) {
+  if (c.client.write((const uint8_t*)text, len) != len) {
+    return false;
+  }
+  c.last_write = millis();
+  return true;
+}
+
+void releaseEventClient(SseClient& c) {
+  c.client.stop();
+  c.active = false;
+  Serial.printf("Event client disconnected (%d/%d)\n", eventClientCount(), SSE_MAX_CLIENTS);
+}
+
+void serviceEventClients() {
+  for (SseClient& c : sse_clients) {
+    if (!c.active) {
+      continue;
+    }
+    if (!c.client.connected()) {
+      releaseEventClient(c);
+      continue;
+    }
+    
+    bool ok = true;
+    if (c.resync) {
+      // Snapshot for new clients and for clients that fell behind
+      SseEvent state;
+      uint32_t color = current_color;
+      formatEvent(state, "state",
+                  "{\"brightness\":%u,\"color\":{\"r\":%u,\"g\":%u,\"b\":%u,\"w\":%u},"
+                  "\"pattern\":\"%s\",\"pattern_running\":%s}",
+                  current_brightness,
+                  (unsigned)(color >> 16) & 0xFF, (unsigned)(color >> 8) & 0xFF,
+                  (unsigned)color & 0xFF, (unsigned)(color >> 24),
+                  current_pattern ? current_pattern->name : "",
+                  pattern_running ? "true" : "false");
+      c.head = c.tail;
+      c.resync = false;
+      ok = writeEvent(c, state.text, state.len);
+    }
+    while (ok && c.head != c.tail) {
+      const SseEvent& event = c.queue[c.head & (SSE_QUEUE_DEPTH - 1)];
+      ok = writeEvent(c, event.text, event.len);
+      c.head++;
+    }
+    if (ok && millis() - c.last_write > SSE_KEEPALIVE_MS) {
+      ok = writeEvent(c, ": keepalive\n\n", 13);
+    }
+    
+    // A failed write means the peer is gone or stalled past the socket timeout
+    if (!ok) {
+      releaseEventClient(c);
+    }
+  }
 }
 
 // ============================================================================
@@ -325,7 +755,7 @@ void handleNotFound() {
 
 void showStatusLED() {
   // Show status with LED colors
-  if (WiFi.status() == WL_CONNECTED) {
+  if (wifi_online) {
     setLEDColor(0, 255, 0, 0); // Green
   } else {
     setLEDColor(255, 0, 0, 0); // Red
@@ -333,13 +763,18 @@ void showStatusLED() {
   
   delay(500);
   strip.clear();
-  strip.show();
+  showStrip();
 }
 
 void setLEDColor(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
   for (int i = 0; i < LED_COUNT; i++) {
     strip.setPixelColor(i, strip.Color(r, g, b, w));
   }
+  showStrip();
+}
+
+void showStrip() {
+  METRIC_SCOPE(metric_strip_show);
   strip.show();
 }
 
@@ -353,22 +788,19 @@ void setLEDPixel(int index, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
 // LED PATTERN FUNCTIONS
 // ============================================================================
 
+const PatternInfo* findPattern(const char* name) {
+  for (const PatternInfo& pattern : pattern_table) {
+    if (strcmp(pattern.name, name) == 0) {
+      return &pattern;
+    }
+  }
+  return nullptr;
+}
+
 void updatePattern() {
-  if (!pattern_running) return;
+  if (!pattern_running || !current_pattern) return;
   
-  unsigned long elapsed = millis() - pattern_start_time;
-  
-  if (current_pattern == "rainbow") {
-    rainbowPattern(elapsed);
-  } else if (current_pattern == "chase") {
-    chasePattern(elapsed);
-  } else if (current_pattern == "fade") {
-    fadePattern(elapsed);
-  } else if (current_pattern == "wave") {
-    wavePattern(elapsed);
-  } else if (current_pattern == "sparkle") {
-    sparklePattern(elapsed);
-  }
+  current_pattern->render(millis() - pattern_start_time);
 }
 
 void rainbowPattern(unsigned long elapsed) {
@@ -377,7 +809,7 @@ void rainbowPattern(unsigned long elapsed) {
     uint32_t color = Wheel(hue);
     strip.setPixelColor(i, color);
   }
-  strip.show();
+  showStrip();
 }
 
 void chasePattern(unsigned long elapsed) {
@@ -388,26 +820,27 @@ void chasePattern(unsigned long elapsed) {
   } else {
     setLEDPixel(LED_COUNT * 2 - pos - 1, 0, 0, 255, 0); // Blue
   }
-  strip.show();
+  showStrip();
 }
 
 void fadePattern(unsigned long elapsed) {
-  int brightness = (sin(elapsed / 50.0) + 1.0) * 127.5;
+  // sin(elapsed / 50) from the table: 209/256 table steps per ms
+  int brightness = led_sin8((elapsed * 209) >> 8);
   strip.setBrightness(brightness);
   setLEDColor(255, 255, 255, 0); // White
-  strip.show();
+  showStrip();
   strip.setBrightness(current_brightness); // Restore brightness
 }
 
 void wavePattern(unsigned long elapsed) {
+  // sin(elapsed / 20 + i * 0.5) in 8.8 fixed point table steps
+  uint32_t phase = elapsed * 521;
   for (int i = 0; i < LED_COUNT; i++) {
-    float wave = (sin((elapsed / 20.0) + (i * 0.5)) + 1.0) / 2.0;
-    uint8_t r = wave * 255;
-    uint8_t g = wave * 128;
-    uint8_t b = wave * 64;
-    setLEDPixel(i, r, g, b, 0);
+    uint8_t wave = led_sin8(phase >> 8);
+    setLEDPixel(i, wave, wave >> 1, wave >> 2, 0);
+    phase += 5215;
   }
-  strip.show();
+  showStrip();
 }
 
 void sparklePattern(unsigned long elapsed) {
@@ -418,22 +851,13 @@ void sparklePattern(unsigned long elapsed) {
       int pos = random(LED_COUNT);
       setLEDPixel(pos, 255, 255, 255, 0);
     }
-    strip.show();
+    showStrip();
     last_sparkle = elapsed;
   }
 }
 
 // Helper function for rainbow effect
 uint32_t Wheel(byte WheelPos) {
-  WheelPos = 255 - WheelPos;
-  if (WheelPos < 85) {
-    return strip.Color(255 - WheelPos * 3, 0, WheelPos * 3, 0);
-  }
-  if (WheelPos < 170) {
-    WheelPos -= 85;
-    return strip.Color(0, WheelPos * 3, 255 - WheelPos * 3, 0);
-  }
-  WheelPos -= 170;
-  return strip.Color(WheelPos * 3, 255 - WheelPos * 3, 0, 0);
+  return led_wheel(WheelPos);
 }
 
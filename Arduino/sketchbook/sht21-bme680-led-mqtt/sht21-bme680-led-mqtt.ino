@@ -6,6 +6,8 @@
  * - BME680 Temperature, Humidity, Pressure & Gas sensor (I2C)
  * - SK6812 RGBW LED strip control
  * - MQTT publishing to Raspberry Pi Mosquitto broker
+ * - Sensor, network and LED work in separate FreeRTOS tasks
+ * - Hot-path timing histograms published over MQTT
  * 
  * Hardware:
  * - ESP32-S3 (lonely binary GOLD EDITION)
@@ -17,17 +19,27 @@
  * - WiFi (built-in)
  * - Wire (built-in)
  * - PubSubClient (MQTT)
- * - Adafruit NeoPixel (for SK6812)
- * - SparkFun HTU21D (for SHT21/HTU21)
- * - Adafruit BME680 (for BME680)
+ * - ConnectionManager (WiFi/MQTT reconnects, included in Arduino/libraries)
+ * - LED_PatternEngine (RMT strip output, included in Arduino/libraries)
+ * - BME680_Custom (BME680, SHT21/HTU21 and the shared I2C bus, included in
+ *   Arduino/libraries)
+ * - HotPathMetrics (cycle-counter timing, included in Arduino/libraries)
  */
 
 #include <WiFi.h>
 #include <Wire.h>
 #include <PubSubClient.h>
-#include <Adafruit_NeoPixel.h>
-#include <SparkFunHTU21D.h>
+#include <ConnectionManager.h>  // Non-blocking WiFi/MQTT state machine
+#include <RmtLedOutput.h>     // RMT + DMA SK6812 output
 #include "BME680_Custom.h"  // Custom BME680 library with IAQ support
+#include "HTU21Async.h"     // No-hold SHT21/HTU21 driver
+#include "BME680Array.h"    // Several BME680s in one acquisition pass
+#include "TelemetryBatch.h" // Packed sample ring and binary frames
+#include "SampleQueue.h"    // Wait-free queues between the tasks
+#include "AdaptiveScheduler.h"  // Change-driven sampling and publishing
+#include "WindowStats.h"    // Per-channel window aggregates
+#include "SampleLog.h"      // Flash ring log for outages
+#include <HotPathMetrics.h>   // Cycle-counter timing histograms
 #include <ArduinoJson.h>
 
 // ============================================================================
@@ -45,55 +57,296 @@ const char* mqtt_client_id = "esp32-s3-sensors";
 const char* mqtt_topic_sht21 = "sensors/sht21/readings";
 const char* mqtt_topic_bme680 = "sensors/bme680/readings";
 const char* mqtt_topic_status = "sensors/esp32-s3/status";
+const char* mqtt_topic_batch = "sensors/esp32-s3/batch";
+const char* mqtt_topic_summary = "sensors/esp32-s3/summary";
+const char* mqtt_topic_replay = "sensors/esp32-s3/replay";
+const char* mqtt_topic_metrics = "sensors/esp32-s3/metrics";
+
+// Command topics (matched by hash in mqttCallback())
+#define MQTT_TOPIC_LED_CONTROL      "sensors/esp32-s3/led/control"
+#define MQTT_TOPIC_BME680_CALIBRATE "sensors/esp32-s3/bme680/calibrate"
+#define MQTT_TOPIC_REPLAY_ACK       "sensors/esp32-s3/replay/ack"
+#define MQTT_COMMAND_DOC_SIZE 200  // Pool for one parsed command, on the stack
 
 // I2C Configuration
 #define I2C_SDA 21  // Default I2C SDA pin
 #define I2C_SCL 22  // Default I2C SCL pin
 
 // SHT21/HTU21 Configuration
-HTU21D sht21;
+HTU21Async sht21;
 
 // BME680 Configuration
 #define BME680_I2C_ADDRESS BME680_I2C_ADDR_SECONDARY  // Use BME680_I2C_ADDR_PRIMARY (0x76) if SDO is connected to GND
-BME680_Custom bme680(BME680_I2C_ADDRESS);
+#define BME680_ALT_ADDRESS BME680_I2C_ADDR_PRIMARY    // Second sensor, or where the only one is found
+BME680_Custom bme680_main(BME680_I2C_ADDRESS);
+BME680_Custom bme680_alt(BME680_ALT_ADDRESS);
+BME680Array bme680_array;              // Both triggered together, read in one pass
+BME680_Custom* bme680 = &bme680_main;  // Telemetry and IAQ: the first one found
 
 // SK6812 LED Strip Configuration
 #define LED_PIN 4        // GPIO pin for LED data line (change as needed)
 #define LED_COUNT 30     // Number of LEDs in strip
 #define LED_BRIGHTNESS 50  // 0-255
 
-Adafruit_NeoPixel strip(LED_COUNT, LED_PIN, NEO_GRBW + NEO_KHZ800);
+// Frames are clocked out by the RMT peripheral; show() doesn't block the core
+RmtLedOutput strip(LED_PIN, LED_COUNT, LED_ORDER_GRBW);
+uint32_t led_frame[LED_COUNT];  // Packed 0xWWRRGGBB, owned by loop()
 
 // Sensor Reading Intervals
 const unsigned long SENSOR_READ_INTERVAL = 5000;  // Read sensors every 5 seconds
 const unsigned long MQTT_PUBLISH_INTERVAL = 30000; // Publish to MQTT every 30 seconds
 
+// Adaptive Sampling
+// Readings that don't change stretch the read interval from
+// SENSOR_READ_INTERVAL up to SENSOR_READ_INTERVAL_MAX; fast change or an
+// IAQ threshold crossing returns to SENSOR_READ_INTERVAL. Samples are only
+// published when a value moves past its deadband, with MQTT_PUBLISH_INTERVAL
+// as a heartbeat. Set to false for fixed-rate reading and publishing.
+#define ADAPTIVE_SAMPLING true
+const unsigned long SENSOR_READ_INTERVAL_MAX = 120000;  // Stable: read every 2 minutes
+
+// Deadband (worth publishing) and fast step (return to the fastest rate)
+#define ADAPT_TEMP_DEADBAND     20     // 0.2 degC
+#define ADAPT_TEMP_FAST         100    // 1 degC
+#define ADAPT_HUM_DEADBAND      100    // 1 %RH
+#define ADAPT_HUM_FAST          500    // 5 %RH
+#define ADAPT_PRES_DEADBAND     50     // 0.5 hPa
+#define ADAPT_PRES_FAST         200    // 2 hPa
+#define ADAPT_IAQ_DEADBAND      500    // 5 points
+#define ADAPT_IAQ_FAST          1500   // 15 points
+#define ADAPT_IAQ_THRESHOLD     8000   // safe_to_open level
+
+// Batched Publishing
+// Samples are queued as packed structs and published as one binary frame
+// (see TelemetryBatch.h) every BATCH_MAX_SAMPLES samples or BATCH_FLUSH_INTERVAL.
+// Set BATCH_PUBLISH to false for the per-sensor JSON messages.
+#define BATCH_PUBLISH true
+#define BATCH_CAPACITY 64                           // Samples kept while offline (both modes)
+const uint16_t BATCH_MAX_SAMPLES = 24;              // Flush after 24 samples (2 minutes)
+const unsigned long BATCH_FLUSH_INTERVAL = 300000;  // or when the oldest is 5 minutes old
+
+// Delta frames ('TD' in TelemetryBatch.h) send each sample as varint
+// differences from the previous one, about 11 bytes for slowly changing
+// readings instead of 25. Set to false for the fixed-size 'TB' frames.
+#define BATCH_DELTA true
+
+// Window Summaries
+// Count/min/max/mean/stddev per channel over each SUMMARY_WINDOW, published
+// as one message in place of the per-sample readings (batch frames or JSON).
+// With SUMMARY_SLIDING_SAMPLES > 0 each summary covers the last N samples
+// instead of the samples since the previous summary.
+#define WINDOW_SUMMARIES true
+const unsigned long SUMMARY_WINDOW = 60000;  // One summary a minute
+#define SUMMARY_SLIDING_SAMPLES 0
+
+// Flash Log
+// While the broker is unreachable, samples due for publishing go to a ring
+// log in LittleFS (see SampleLog.h, about 8000 samples) instead of RAM, and
+// survive a reboot. With WINDOW_SUMMARIES, every reading taken while offline
+// is logged, since the summary queue only covers a few minutes. Once back
+// online they are replayed oldest first as batch frames of REPLAY_BATCH
+// samples on mqtt_topic_replay, one every REPLAY_INTERVAL; the frame seq is the log sequence number of its first
+// sample. With REPLAY_ACKS the consumer confirms what it stored by
+// publishing {"seq": N} (last sequence number received) to
+// MQTT_TOPIC_REPLAY_ACK; otherwise a frame counts as delivered once
+// PubSubClient has sent it.
+#define FLASH_LOG true
+#define REPLAY_BATCH 32                          // Samples per replay frame
+const unsigned long REPLAY_INTERVAL = 500;       // ms between replay frames
+#define REPLAY_ACKS false
+#define REPLAY_INFLIGHT 4                        // Unconfirmed frames (REPLAY_ACKS)
+const unsigned long REPLAY_ACK_TIMEOUT = 10000;  // Resend from the last ack after this
+
+// Hot-Path Metrics
+// Time spent in I2C transactions, BME680 reads, IAQ scoring, strip output,
+// JSON serialization and MQTT publishing (see HotPathMetrics.h). Count,
+// p50, p99 and max per site are published every METRICS_INTERVAL, each
+// message covering the interval since the last one.
+#define METRICS_PUBLISH true
+const unsigned long METRICS_INTERVAL = 60000;
+
+// WiFi/MQTT reconnects are handled by ConnectionManager: cached
+// BSSID/channel/lease for a fast rejoin, backoff with jitter (see
+// CONN_RETRY_* in ConnectionManager.h)
+
+// FreeRTOS Tasks
+// The sensor task owns both sensors (through the locked i2c_bus), the network task owns
+// WiFi and MQTT, and loop() renders the LED strip. They only talk through
+// the SPSC queues below, so a stalled broker never delays a reading.
+#define SENSOR_TASK_CORE 1
+#define SENSOR_TASK_PRIORITY 3
+#define SENSOR_TASK_STACK 4096
+#define NETWORK_TASK_CORE 0       // Same core as the WiFi stack
+#define NETWORK_TASK_PRIORITY 2
+#define NETWORK_TASK_STACK 8192
+
 // ============================================================================
 // GLOBAL VARIABLES
 // ============================================================================
 
 WiFiClient espClient;
 PubSubClient mqtt_client(espClient);
+ConnectionManager connection(&mqtt_client);
+
+// Messages between the tasks
+#define SENSOR_CMD_CALIBRATE 1
+
+struct SensorCommand {
+  uint8_t type;
+  uint16_t duration;  // Calibration burn-in in seconds
+};
+
+#define SENSOR_EVENT_CALIBRATION_STARTED  1
+#define SENSOR_EVENT_CALIBRATION_COMPLETE 2
+
+struct SensorEvent {
+  uint8_t type;
+  uint16_t duration;
+  float gas_baseline;
+  float hum_baseline;
+};
+
+#define LED_CMD_SET_COLOR      1
+#define LED_CMD_SET_BRIGHTNESS 2
+#define LED_CMD_CLEAR          3
 
-unsigned long last_sensor_read = 0;
-unsigned long last_mqtt_publish = 0;
-
-// Sensor data storage
-struct SensorData {
-  float sht21_temp = 0.0;
-  float sht21_humidity = 0.0;
-  bool sht21_valid = false;
-  
-  float bme680_temp = 0.0;
-  float bme680_humidity = 0.0;
-  float bme680_pressure = 0.0;
-  float bme680_gas = 0.0;
-  float bme680_iaq_score = 0.0;
-  bool bme680_valid = false;
-  bool bme680_baseline_established = false;
+struct LedCommand {
+  uint8_t type;
+  uint8_t r, g, b, w;  // Brightness is passed in r
 };
 
-SensorData sensor_data;
+// Summarized channels, in TelemetrySample units
+#define SUMMARY_TEMP 0      // SHT21, centi-degC
+#define SUMMARY_HUM  1      // SHT21, centi-%RH
+#define SUMMARY_PRES 2      // BME680, Pa
+#define SUMMARY_GAS  3      // BME680, Ohms
+#define SUMMARY_IAQ  4      // centi-points
+#define SUMMARY_CHANNELS 5
+
+struct WindowReport {
+  uint32_t start;   // ms since boot
+  uint32_t end;
+  WindowSummary channels[SUMMARY_CHANNELS];
+};
+
+// MQTT command dispatch
+// Topics and actions are looked up by FNV-1a hash against tables built at
+// compile time, then confirmed with one strcmp(). Commands are parsed in
+// place from PubSubClient's buffer, so the command path never allocates.
+enum CommandAction : uint8_t {
+  ACTION_UNKNOWN,
+  ACTION_SET_COLOR,
+  ACTION_SET_BRIGHTNESS,
+  ACTION_CLEAR,
+  ACTION_CALIBRATE
+};
+
+constexpr uint32_t fnv1aStep(const char* s, uint32_t hash) {
+  return *s ? fnv1aStep(s + 1, (hash ^ (uint8_t)*s) * 16777619u) : hash;
+}
+
+constexpr uint32_t fnv1a(const char* s) {
+  return fnv1aStep(s, 2166136261u);
+}
+
+struct ActionName {
+  uint32_t hash;
+  const char* name;
+  CommandAction action;
+};
+
+const ActionName command_actions[] = {
+  { fnv1a("set_color"),      "set_color",      ACTION_SET_COLOR },
+  { fnv1a("set_brightness"), "set_brightness", ACTION_SET_BRIGHTNESS },
+  { fnv1a("clear"),          "clear",          ACTION_CLEAR },
+  { fnv1a("calibrate"),      "calibrate",      ACTION_CALIBRATE },
+};
+
+struct TopicRoute {
+  uint32_t hash;
+  const char* topic;
+  void (*handler)(JsonDocument& doc);
+};
+
+// Link state shown by the status LED
+#define LINK_DOWN      0
+#define LINK_WIFI      1
+#define LINK_CONNECTED 2
+
+// sensor task -> network task
+SampleQueue<TelemetrySample, 16> sample_queue;
+SampleQueue<SensorEvent, 4> sensor_event_queue;
+SampleQueue<WindowReport, 8> summary_queue;  // Also the backlog while offline
+// network task -> sensor task
+SampleQueue<SensorCommand, 4> sensor_cmd_queue;
+// network task -> loop()
+SampleQueue<LedCommand, 8> led_queue;
+
+std::atomic<uint8_t> link_state(LINK_DOWN);
+std::atomic<uint32_t> samples_dropped(0);
+std::atomic<uint32_t> summaries_dropped(0);
+
+TaskHandle_t sensor_task_handle = nullptr;
+TaskHandle_t network_task_handle = nullptr;
+
+// Sensor task state
+bool bme680_calibration_pending = false;
+
+// SAMPLE_SIGNIFICANT marks the samples the network task publishes
+#if ADAPTIVE_SAMPLING
+AdaptiveScheduler scheduler(SENSOR_READ_INTERVAL, SENSOR_READ_INTERVAL_MAX, MQTT_PUBLISH_INTERVAL);
+#else
+// Fixed rate: every sample is batched, or one JSON sample per MQTT_PUBLISH_INTERVAL
+AdaptiveScheduler scheduler(SENSOR_READ_INTERVAL, SENSOR_READ_INTERVAL, BATCH_PUBLISH ? 0 : MQTT_PUBLISH_INTERVAL);
+#endif
+int8_t adapt_temp = scheduler.add_channel(ADAPT_TEMP_DEADBAND, ADAPT_TEMP_FAST);
+int8_t adapt_hum = scheduler.add_channel(ADAPT_HUM_DEADBAND, ADAPT_HUM_FAST);
+int8_t adapt_pres = scheduler.add_channel(ADAPT_PRES_DEADBAND, ADAPT_PRES_FAST);
+int8_t adapt_iaq = scheduler.add_channel(ADAPT_IAQ_DEADBAND, ADAPT_IAQ_FAST, ADAPT_IAQ_THRESHOLD);
+
+#if WINDOW_SUMMARIES
+#if SUMMARY_SLIDING_SAMPLES > 0
+typedef SlidingStats<SUMMARY_SLIDING_SAMPLES> ChannelStats;
+#else
+typedef RunningStats ChannelStats;
+#endif
+ChannelStats summary_stats[SUMMARY_CHANNELS];
+bool summary_open = false;
+unsigned long summary_start = 0;
+#endif
+
+// Baselines, as seen by the network task
+float gas_baseline = -1.0;
+float hum_baseline = -1.0;
+
+// Samples waiting to be published (batch frames, or one JSON message
+// each), kept while offline; the frame buffer batches are encoded into
+TelemetryBatch<BATCH_CAPACITY> sample_batch;
+#if BATCH_DELTA
+#define BATCH_FRAME_SIZE(n) TELEMETRY_DELTA_FRAME_MAX(n)
+#else
+#define BATCH_FRAME_SIZE(n) TELEMETRY_FRAME_SIZE(n)
+#endif
+uint8_t batch_frame[BATCH_FRAME_SIZE(BATCH_CAPACITY)];
+uint32_t batch_seq = 0;
+
+#if FLASH_LOG
+static_assert(REPLAY_BATCH <= BATCH_CAPACITY, "replay frames are encoded into batch_frame");
+SampleLog sample_log;
+TelemetryBatch<REPLAY_BATCH> replay_batch;
+TelemetrySample replay_samples[REPLAY_BATCH];
+unsigned long last_replay = 0;
+unsigned long last_replay_ack = 0;
+#endif
+
+// Timed sites in the sketch (the libraries define their own)
+METRIC_SITE(metric_json, "json");
+METRIC_SITE(metric_publish, "mqtt_publish");
+METRIC_SITE(metric_strip_show, "strip_show");
+
+// Status LED (loop() only)
+uint8_t shown_link_state = 0xFF;
+unsigned long status_led_off_at = 0;
 
 // ============================================================================
 // SETUP
@@ -109,6 +362,7 @@ void setup() {
   
   // Initialize I2C
   Wire.begin(I2C_SDA, I2C_SCL);
+  i2c_bus.begin();
   Serial.println("✓ I2C initialized");
   
   // Initialize SHT21/HTU21
@@ -118,103 +372,217 @@ void setup() {
     Serial.println("✗ SHT21/HTU21 sensor not found!");
   }
   
-  // Initialize BME680
-  if (bme680.begin()) {
-    Serial.println("✓ BME680 sensor found");
+  // Initialize BME680s (saved coefficients and baseline skip the burn-in)
+  bme680_array.add(bme680_main);
+  bme680_array.add(bme680_alt);
+  bool bme680_restored = bme680_main.restore_state();
+  bool bme680_alt_restored = bme680_alt.restore_state();
+  bme680_array.begin();
+  
+  for (uint8_t i = 0; i < bme680_array.size(); i++) {
+    if (!bme680_array.is_present(i)) continue;
+    BME680_Custom& sensor = bme680_array.device(i);
+    Serial.printf("✓ BME680 sensor found at 0x%02X\n", sensor.get_i2c_address());
     
     // Configure heater (matching Python implementation)
-    bme680.set_gas_heater_temperature(320);  // 320°C
-    bme680.set_gas_heater_duration(150);     // 150ms
-    bme680.select_gas_heater_profile(0);
-    
-    Serial.println("  Note: Run baseline calibration for accurate IAQ readings");
-    Serial.println("  Use: bme680.set_baselines(300) in setup() or via MQTT");
+    sensor.set_gas_heater_temperature(320);  // 320°C
+    sensor.set_gas_heater_duration(150);     // 150ms
+    sensor.select_gas_heater_profile(0);
+  }
+  
+  if (!bme680_array.is_present(0) && bme680_array.is_present(1)) {
+    bme680 = &bme680_alt;
+    bme680_restored = bme680_alt_restored;
+  }
+  
+  if (bme680_array.is_present(0) || bme680_array.is_present(1)) {
+    if (bme680_restored && bme680->is_baseline_established()) {
+      Serial.println("  IAQ baseline restored from NVS");
+      gas_baseline = bme680->get_gas_baseline();
+      hum_baseline = bme680->get_hum_baseline();
+    } else {
+      // Build the IAQ baseline in the background from the regular readings
+      bme680->set_baselines(300);
+      bme680_calibration_pending = true;
+      Serial.println("  IAQ baseline calibration running (300 s, non-blocking)");
+    }
   } else {
     Serial.println("✗ BME680 sensor not found!");
-    Serial.println("  Trying alternate address 0x76...");
-    BME680_Custom bme680_alt(BME680_I2C_ADDR_PRIMARY);
-    if (bme680_alt.begin()) {
-      Serial.println("✓ BME680 found at 0x76");
-      bme680 = bme680_alt;
-      bme680.set_gas_heater_temperature(320);
-      bme680.set_gas_heater_duration(150);
-      bme680.select_gas_heater_profile(0);
-    }
   }
   
   // Initialize LED strip
-  strip.begin();
-  strip.setBrightness(LED_BRIGHTNESS);
-  strip.clear();
-  strip.show();
-  Serial.println("✓ SK6812 LED strip initialized");
-  
-  // Connect to WiFi
-  connectWiFi();
+  if (strip.begin()) {
+    strip.set_levels(LED_BRIGHTNESS, false);
+    clearLEDs();
+    Serial.println("✓ SK6812 LED strip initialized");
+  } else {
+    Serial.println("✗ SK6812 RMT output failed to start!");
+  }
   
-  // Connect to MQTT
+  // MQTT client (connected by the connection manager in the network task)
   mqtt_client.setServer(mqtt_server, mqtt_port);
   mqtt_client.setCallback(mqttCallback);
-  connectMQTT();
+  mqtt_client.setBufferSize(sizeof(batch_frame) + 64);
+  connection.set_on_connect(onMQTTConnected);
   
-  // Initial status LED indication
-  showStatusLED();
+  // From here on the sensors belong to the sensor task and WiFi/MQTT to
+  // the network task
+  xTaskCreatePinnedToCore(sensorTask, "sensors", SENSOR_TASK_STACK, nullptr,
+                          SENSOR_TASK_PRIORITY, &sensor_task_handle, SENSOR_TASK_CORE);
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr,
+                          NETWORK_TASK_PRIORITY, &network_task_handle, NETWORK_TASK_CORE);
   
-  Serial.println("\n✓ Setup complete! Starting main loop...\n");
+  Serial.println("\n✓ Setup complete! Sensor and network tasks started...\n");
 }
 
 // ============================================================================
-// MAIN LOOP
+// MAIN LOOP (LED rendering)
 // ============================================================================
 
 void loop() {
-  unsigned long current_time = millis();
-  
-  // Maintain MQTT connection
-  if (!mqtt_client.connected()) {
-    connectMQTT();
-  }
-  mqtt_client.loop();
-  
-  // Read sensors at specified interval
-  if (current_time - last_sensor_read >= SENSOR_READ_INTERVAL) {
-    readSensors();
-    last_sensor_read = current_time;
+  LedCommand cmd;
+  while (led_queue.pop(cmd)) {
+    applyLEDCommand(cmd);
   }
   
-  // Publish to MQTT at specified interval
-  if (current_time - last_mqtt_publish >= MQTT_PUBLISH_INTERVAL) {
-    publishSensorData();
-    last_mqtt_publish = current_time;
-  }
+  showStatusLED();
   
-  delay(100); // Small delay to prevent watchdog issues
+  vTaskDelay(pdMS_TO_TICKS(20));
 }
 
 // ============================================================================
-// WIFI FUNCTIONS
+// SENSOR TASK
 // ============================================================================
 
-void connectWiFi() {
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(ssid);
+void sensorTask(void* param) {
+  TickType_t last_read = xTaskGetTickCount() - pdMS_TO_TICKS(SENSOR_READ_INTERVAL);
   
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, password);
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
+  for (;;) {
+    // Sleep until the next reading, or until a command arrives
+    TickType_t elapsed = xTaskGetTickCount() - last_read;
+    TickType_t interval = pdMS_TO_TICKS(scheduler.interval());
+    ulTaskNotifyTake(pdTRUE, elapsed < interval ? interval - elapsed : 0);
+    
+    SensorCommand cmd;
+    while (sensor_cmd_queue.pop(cmd)) {
+      handleSensorCommand(cmd);
+    }
+    
+    if (xTaskGetTickCount() - last_read >= interval) {
+      last_read = xTaskGetTickCount();
+      readSensors();
+    }
   }
+}
+
+void handleSensorCommand(const SensorCommand& cmd) {
+  if (cmd.type == SENSOR_CMD_CALIBRATE) {
+    Serial.print("Starting BME680 baseline calibration for ");
+    Serial.print(cmd.duration);
+    Serial.println(" seconds...");
+    
+    // Baseline is built from the regular readings in the background
+    bme680->set_baselines(cmd.duration, true);
+    bme680_calibration_pending = true;
+    
+    // The baseline needs regular readings
+    scheduler.trigger();
+    
+    SensorEvent event = { SENSOR_EVENT_CALIBRATION_STARTED, cmd.duration, -1.0, -1.0 };
+    sensor_event_queue.push(event);
+  }
+}
+
+// ============================================================================
+// NETWORK TASK
+// ============================================================================
+
+void networkTask(void* param) {
+  connection.begin(ssid, password, mqtt_client_id);
   
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\n✓ WiFi connected!");
-    Serial.print("  IP address: ");
-    Serial.println(WiFi.localIP());
+#if FLASH_LOG
+  if (sample_log.begin()) {
+    Serial.printf("✓ Flash log: %u samples to replay\n", (unsigned)sample_log.pending());
   } else {
-    Serial.println("\n✗ WiFi connection failed!");
+    Serial.println("✗ Flash log unavailable - offline samples are kept in RAM only");
+  }
+#endif
+  
+  for (;;) {
+    // Joins, reconnects and mqtt_client.loop(); returns without waiting
+    connection.loop();
+    
+    link_state.store(connection.online() ? LINK_CONNECTED :
+                     connection.wifi_connected() ? LINK_WIFI : LINK_DOWN,
+                     std::memory_order_relaxed);
+    
+    // Collect samples and events from the sensor task. Only samples the
+    // scheduler marked are published; they queue up while offline (in
+    // flash when the log is available).
+    TelemetrySample sample;
+    while (sample_queue.pop(sample)) {
+      if (!(sample.flags & SAMPLE_SIGNIFICANT)) {
+#if WINDOW_SUMMARIES && FLASH_LOG
+        // Only a few minutes of summaries fit in summary_queue, so while
+        // offline every reading also goes to the log, for the replay
+        if (!connection.online()) {
+          sample_log.append(sample);
+        }
+#endif
+        continue;
+      }
+#if FLASH_LOG
+      if (!connection.online() && sample_log.append(sample)) {
+        continue;
+      }
+#endif
+      sample_batch.push(sample);
+    }
+    
+    SensorEvent event;
+    while (sensor_event_queue.pop(event)) {
+      publishCalibrationStatus(event);
+    }
+    
+#if WINDOW_SUMMARIES
+    // Summaries wait in the queue while offline; one that failed to
+    // publish is retried first
+    static WindowReport report;
+    static bool report_pending = false;
+    while (connection.online() && (report_pending || summary_queue.pop(report))) {
+      report_pending = !publishSummary(report);
+      if (report_pending) break;
+    }
+#endif
+    
+#if BATCH_PUBLISH
+    if (sample_batch.due(millis(), BATCH_MAX_SAMPLES, BATCH_FLUSH_INTERVAL)) {
+      publishBatch();
+    }
+#else
+    // Oldest first, so a reconnect replays what was missed
+    while (connection.online() && sample_batch.size() > 0 &&
+           publishSensorData(sample_batch.oldest())) {
+      sample_batch.drop_oldest();
+    }
+#endif
+    
+#if FLASH_LOG
+    if (connection.online() && sample_log.pending() > 0) {
+      replayLog();
+    }
+#endif
+    
+#if METRICS_PUBLISH && HOT_PATH_METRICS
+    // An interval that failed to publish carries over into the next
+    static unsigned long last_metrics = 0;
+    if (connection.online() && millis() - last_metrics >= METRICS_INTERVAL) {
+      last_metrics = millis();
+      publishMetrics();
+    }
+#endif
+    
+    vTaskDelay(pdMS_TO_TICKS(10));
   }
 }
 
@@ -222,270 +590,661 @@ void connectWiFi() {
 // MQTT FUNCTIONS
 // ============================================================================
 
-void connectMQTT() {
-  while (!mqtt_client.connected()) {
-    Serial.print("Connecting to MQTT broker: ");
-    Serial.print(mqtt_server);
-    Serial.print(":");
-    Serial.println(mqtt_port);
-    
-    if (mqtt_client.connect(mqtt_client_id)) {
-      Serial.println("✓ Connected to MQTT broker");
-      
-      // Subscribe to LED control topic
-      mqtt_client.subscribe("sensors/esp32-s3/led/control");
-      // Subscribe to BME680 calibration topic
-      mqtt_client.subscribe("sensors/esp32-s3/bme680/calibrate");
-      
-      // Publish online status
-      publishStatus("online");
-    } else {
-      Serial.print("✗ MQTT connection failed, rc=");
-      Serial.print(mqtt_client.state());
-      Serial.println(" - retrying in 5 seconds");
-      delay(5000);
+void onMQTTConnected() {
+  Serial.printf("✓ Connected to MQTT broker %s:%d (%s join", mqtt_server, mqtt_port,
+                connection.get_fast_join() ? "cached" : "full");
+  if (connection.get_reconnects() > 0) {
+    Serial.printf(", offline %lu ms", (unsigned long)connection.get_last_outage_ms());
+  }
+  Serial.println(")");
+  
+  // Wall-clock time for the saved BME680 state timestamp
+  static bool time_configured = false;
+  if (!time_configured) {
+    configTime(0, 0, "pool.ntp.org");
+    time_configured = true;
+  }
+  
+  // Subscribe to LED control topic
+  mqtt_client.subscribe(MQTT_TOPIC_LED_CONTROL);
+  // Subscribe to BME680 calibration topic
+  mqtt_client.subscribe(MQTT_TOPIC_BME680_CALIBRATE);
+#if FLASH_LOG
+#if REPLAY_ACKS
+  mqtt_client.subscribe(MQTT_TOPIC_REPLAY_ACK);
+#endif
+  // Frames sent before the link dropped may not have arrived
+  sample_log.rewind();
+  last_replay_ack = millis();
+#endif
+  
+  // Publish online status
+  publishStatus("online");
+}
+
+const TopicRoute command_routes[] = {
+  { fnv1a(MQTT_TOPIC_LED_CONTROL),      MQTT_TOPIC_LED_CONTROL,      handleLEDControl },
+  { fnv1a(MQTT_TOPIC_BME680_CALIBRATE), MQTT_TOPIC_BME680_CALIBRATE, handleBME680Calibration },
+#if FLASH_LOG && REPLAY_ACKS
+  { fnv1a(MQTT_TOPIC_REPLAY_ACK),       MQTT_TOPIC_REPLAY_ACK,       handleReplayAck },
+#endif
+};
+
+const TopicRoute* findRoute(const char* topic) {
+  uint32_t hash = fnv1a(topic);
+  for (const TopicRoute& route : command_routes) {
+    if (route.hash == hash && strcmp(route.topic, topic) == 0) {
+      return &route;
     }
   }
+  return nullptr;
+}
+
+CommandAction parseAction(const char* action) {
+  if (!action) {
+    return ACTION_UNKNOWN;
+  }
+  uint32_t hash = fnv1a(action);
+  for (const ActionName& entry : command_actions) {
+    if (entry.hash == hash && strcmp(entry.name, action) == 0) {
+      return entry.action;
+    }
+  }
+  return ACTION_UNKNOWN;
 }
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
   // Handle incoming MQTT messages (e.g., LED control commands)
-  String message = "";
-  for (int i = 0; i < length; i++) {
-    message += (char)payload[i];
+  Serial.printf("MQTT message received on topic: %s - Message: %.*s\n",
+                topic, (int)length, (const char*)payload);
+  
+  const TopicRoute* route = findRoute(topic);
+  if (!route) {
+    return;
   }
   
-  Serial.print("MQTT message received on topic: ");
-  Serial.print(topic);
-  Serial.print(" - Message: ");
-  Serial.println(message);
+  // Zero-copy parse: strings in doc point into payload, which PubSubClient
+  // keeps valid until this callback returns
+  StaticJsonDocument<MQTT_COMMAND_DOC_SIZE> doc;
+  DeserializationError error = deserializeJson(doc, (char*)payload, length);
   
-  // Parse LED control commands
-  if (String(topic) == "sensors/esp32-s3/led/control") {
-    handleLEDControl(message);
+  if (error) {
+    Serial.print("JSON parse error: ");
+    Serial.println(error.c_str());
+    return;
   }
   
-  // Parse BME680 calibration commands
-  if (String(topic) == "sensors/esp32-s3/bme680/calibrate") {
-    handleBME680Calibration(message);
-  }
+  route->handler(doc);
 }
 
 void publishStatus(const char* status) {
-  StaticJsonDocument<200> doc;
+  StaticJsonDocument<256> doc;
   doc["status"] = status;
   doc["uptime"] = millis() / 1000;
   doc["free_heap"] = ESP.getFreeHeap();
   doc["wifi_rssi"] = WiFi.RSSI();
+  doc["samples_dropped"] = samples_dropped.load(std::memory_order_relaxed);
+#if WINDOW_SUMMARIES
+  doc["summaries_dropped"] = summaries_dropped.load(std::memory_order_relaxed);
+#endif
+#if FLASH_LOG
+  doc["log_pending"] = sample_log.pending();
+  doc["log_dropped"] = sample_log.get_dropped();
+#endif
+  doc["reconnects"] = connection.get_reconnects();
+  doc["last_outage_ms"] = connection.get_last_outage_ms();
+  
+  char payload[256];
+  if (toJson(doc, payload, sizeof(payload)) == 0) {
+    return;
+  }
+  
+  mqttPublish(mqtt_topic_status, payload);
+}
+
+#if METRICS_PUBLISH && HOT_PATH_METRICS
+// Each site is [count, p50, p99, max], times in microseconds
+bool publishMetrics() {
+  StaticJsonDocument<1024> doc;
+  doc["uptime"] = millis() / 1000;
+  doc["cpu_mhz"] = getCpuFrequencyMhz();
+  for (MetricSite* site = MetricSite::first(); site; site = site->next()) {
+    MetricSummary m;
+    site->summary(m);
+    JsonArray a = doc.createNestedArray(site->name());
+    a.add(m.count);
+    a.add(roundf(m.p50_us * 10) / 10);
+    a.add(roundf(m.p99_us * 10) / 10);
+    a.add(roundf(m.max_us * 10) / 10);
+  }
   
-  String payload;
-  serializeJson(doc, payload);
+  char payload[640];
+  size_t len = toJson(doc, payload, sizeof(payload));
+  if (len > 0 && !mqttPublish(mqtt_topic_metrics, (const uint8_t*)payload, len)) {
+    return false;
+  }
   
-  mqtt_client.publish(mqtt_topic_status, payload.c_str());
+  MetricSite::reset_all();
+  return true;
+}
+#endif
+
+// Timed serializeJson(); returns the length written, 0 (and an empty
+// string) if the message doesn't fit, so callers don't publish it cut off
+size_t toJson(const JsonDocument& doc, char* out, size_t size) {
+  METRIC_SCOPE(metric_json);
+  if (measureJson(doc) >= size) {
+    Serial.printf("✗ JSON message doesn't fit %u bytes - not published\n", (unsigned)size);
+    out[0] = '\0';
+    return 0;
+  }
+  return serializeJson(doc, out, size);
+}
+
+// Timed mqtt_client.publish()
+bool mqttPublish(const char* topic, const uint8_t* payload, size_t len) {
+  METRIC_SCOPE(metric_publish);
+  return mqtt_client.publish(topic, payload, len);
 }
 
-void publishSensorData() {
+bool mqttPublish(const char* topic, const char* payload) {
+  return mqttPublish(topic, (const uint8_t*)payload, strlen(payload));
+}
+
+#if WINDOW_SUMMARIES
+// Compact form: each channel is [count, min, max, mean, stddev] in
+// TelemetrySample units; channels without readings are left out
+bool publishSummary(const WindowReport& report) {
+  static const char* const names[SUMMARY_CHANNELS] = {
+    "temperature", "humidity", "pressure", "gas", "iaq"
+  };
+  
+  StaticJsonDocument<512> doc;
+  doc["start"] = report.start;
+  doc["end"] = report.end;
+  for (uint8_t i = 0; i < SUMMARY_CHANNELS; i++) {
+    const WindowSummary& c = report.channels[i];
+    if (c.count == 0) continue;
+    JsonArray a = doc.createNestedArray(names[i]);
+    a.add(c.count);
+    a.add(c.min);
+    a.add(c.max);
+    a.add(c.mean);
+    a.add(c.stddev);
+  }
+  
+  char payload[320];
+  size_t len = toJson(doc, payload, sizeof(payload));
+  if (len == 0) {
+    return true;  // Would never fit; not retried
+  }
+  return mqttPublish(mqtt_topic_summary, (const uint8_t*)payload, len);
+}
+#endif
+
+// Returns false if the broker didn't take the messages
+bool publishSensorData(const TelemetrySample& s) {
+  bool ok = true;
+  
   // Publish SHT21 data
-  if (sensor_data.sht21_valid) {
+  if (s.flags & SAMPLE_SHT21_VALID) {
     StaticJsonDocument<300> doc;
-    doc["temperature"] = sensor_data.sht21_temp;
-    doc["humidity"] = sensor_data.sht21_humidity;
-    doc["timestamp"] = millis() / 1000;
+    doc["temperature"] = s.sht21_temp / 100.0;
+    doc["humidity"] = s.sht21_humidity / 100.0;
+    doc["timestamp"] = s.timestamp / 1000;
     
-    String payload;
-    serializeJson(doc, payload);
-    mqtt_client.publish(mqtt_topic_sht21, payload.c_str());
+    char payload[128];
+    if (toJson(doc, payload, sizeof(payload)) > 0) {
+      ok = mqttPublish(mqtt_topic_sht21, payload) && ok;
+    }
     
     Serial.print("Published SHT21: ");
     Serial.println(payload);
   }
   
   // Publish BME680 data
-  if (sensor_data.bme680_valid) {
+  if (s.flags & SAMPLE_BME680_VALID) {
     StaticJsonDocument<500> doc;
-    doc["temperature"] = sensor_data.bme680_temp;
-    doc["humidity"] = sensor_data.bme680_humidity;
-    doc["pressure"] = sensor_data.bme680_pressure;
-    doc["gas_resistance"] = sensor_data.bme680_gas;
+    doc["temperature"] = s.bme680_temp / 100.0;
+    doc["humidity"] = s.bme680_humidity / 1000.0;
+    doc["pressure"] = s.bme680_pressure / 100.0;      // hPa
+    doc["gas_resistance"] = s.bme680_gas / 1000.0;    // kOhm
     doc["heat_stable"] = true;
-    doc["timestamp"] = millis() / 1000;
+    doc["timestamp"] = s.timestamp / 1000;
     
     // Add IAQ data if baseline is established
-    if (sensor_data.bme680_baseline_established) {
-      doc["iaq_score"] = sensor_data.bme680_iaq_score;
+    if (s.flags & SAMPLE_IAQ_VALID) {
+      doc["iaq_score"] = s.iaq_score / 100.0;
       doc["baseline_established"] = true;
-      doc["gas_baseline"] = bme680.get_gas_baseline();
-      doc["hum_baseline"] = bme680.get_hum_baseline();
-      doc["safe_to_open"] = bme680.check_safe_to_open(80.0);
+      doc["gas_baseline"] = gas_baseline;
+      doc["hum_baseline"] = hum_baseline;
+      doc["safe_to_open"] = s.iaq_score >= 8000;  // 80.0 points
     } else {
       doc["baseline_established"] = false;
     }
     
-    String payload;
-    serializeJson(doc, payload);
-    mqtt_client.publish(mqtt_topic_bme680, payload.c_str());
+    char payload[320];
+    if (toJson(doc, payload, sizeof(payload)) > 0) {
+      ok = mqttPublish(mqtt_topic_bme680, payload) && ok;
+    }
     
     Serial.print("Published BME680: ");
     Serial.println(payload);
   }
+  
+  return ok;
+}
+
+void publishBatch() {
+  if (!mqtt_client.connected()) {
+    return; // Samples stay queued (oldest overwritten when full)
+  }
+  
+#if BATCH_DELTA
+  size_t len = sample_batch.encode_delta(batch_frame, sizeof(batch_frame), batch_seq);
+#else
+  size_t len = sample_batch.encode(batch_frame, sizeof(batch_frame), batch_seq);
+#endif
+  if (len == 0) {
+    return;
+  }
+  
+  if (mqttPublish(mqtt_topic_batch, batch_frame, len)) {
+    Serial.printf("Published batch #%u: %u samples, %u bytes\n",
+                  (unsigned)batch_seq, sample_batch.size(), (unsigned)len);
+    sample_batch.clear();
+    batch_seq++;
+  } else {
+    Serial.println("✗ Batch publish failed - keeping samples queued");
+  }
 }
 
+#if FLASH_LOG
+// One frame per REPLAY_INTERVAL, so a long outage doesn't flood the broker
+void replayLog() {
+  unsigned long now = millis();
+  
+#if REPLAY_ACKS
+  // Frames in flight without an ack for too long are sent again
+  uint32_t in_flight = sample_log.pending() - sample_log.unread();
+  if (in_flight > 0 && now - last_replay_ack >= REPLAY_ACK_TIMEOUT) {
+    Serial.printf("✗ No replay ack for %u samples - resending\n", (unsigned)in_flight);
+    sample_log.rewind();
+    last_replay_ack = now;
+    in_flight = 0;
+  }
+  if (in_flight >= (uint32_t)REPLAY_INFLIGHT * REPLAY_BATCH) {
+    return;
+  }
+  if (in_flight == 0) {
+    last_replay_ack = now;
+  }
+#endif
+  
+  if (sample_log.unread() == 0 || now - last_replay < REPLAY_INTERVAL) {
+    return;
+  }
+  last_replay = now;
+  
+  uint32_t first_seq;
+  uint16_t n = sample_log.read(replay_samples, REPLAY_BATCH, first_seq);
+  if (n == 0) {
+    return;
+  }
+  
+  replay_batch.clear();
+  for (uint16_t i = 0; i < n; i++) {
+    replay_batch.push(replay_samples[i]);
+  }
+#if BATCH_DELTA
+  size_t len = replay_batch.encode_delta(batch_frame, sizeof(batch_frame), first_seq);
+#else
+  size_t len = replay_batch.encode(batch_frame, sizeof(batch_frame), first_seq);
+#endif
+  
+  if (!mqttPublish(mqtt_topic_replay, batch_frame, len)) {
+    // Sent again from the first unconfirmed sample
+    sample_log.rewind();
+    return;
+  }
+  
+#if !REPLAY_ACKS
+  sample_log.ack(first_seq + n - 1);
+#endif
+  Serial.printf("Replayed samples %u-%u, %u still logged\n", (unsigned)first_seq,
+                (unsigned)(first_seq + n - 1), (unsigned)sample_log.pending());
+}
+
+#if REPLAY_ACKS
+void handleReplayAck(JsonDocument& doc) {
+  // Example: {"seq":1234} - every sample up to 1234 is stored
+  if (!doc["seq"].is<uint32_t>()) {
+    return;
+  }
+  sample_log.ack(doc["seq"].as<uint32_t>());
+  last_replay_ack = millis();
+}
+#endif
+#endif
+
 // ============================================================================
-// SENSOR READING FUNCTIONS
+// SENSOR READING FUNCTIONS (sensor task)
 // ============================================================================
 
 void readSensors() {
-  // Read SHT21/HTU21
-  float temp = sht21.readTemperature();
-  float humidity = sht21.readHumidity();
-  
-  if (!isnan(temp) && !isnan(humidity)) {
-    sensor_data.sht21_temp = temp;
-    sensor_data.sht21_humidity = humidity;
-    sensor_data.sht21_valid = true;
+  TelemetrySample sample;
+  sample.timestamp = millis();
+  sample.flags = 0;
+  
+  // All sensors convert at the same time, with the bus free
+  bool bme680_started = bme680_array.start_measurement() > 0;
+  bool sht21_started = sht21.start();
+  uint8_t bme680_state = bme680_started ? MEAS_PENDING : MEAS_ERROR;
+  uint8_t sht21_state = sht21_started ? MEAS_PENDING : MEAS_ERROR;
+  waitForConversions(bme680_state, sht21_state);
+  
+  if (sht21_state == MEAS_READY) {
+    sample.sht21_temp = sht21.get_temperature_fixed();
+    sample.sht21_humidity = sht21.get_humidity_fixed();
+    sample.flags |= SAMPLE_SHT21_VALID;
     
     Serial.print("SHT21 - Temp: ");
-    Serial.print(temp);
+    Serial.print(sht21.get_temperature());
     Serial.print("°C, Humidity: ");
-    Serial.print(humidity);
+    Serial.print(sht21.get_humidity());
     Serial.println("%");
   } else {
-    sensor_data.sht21_valid = false;
+    sample.sht21_temp = 0;
+    sample.sht21_humidity = 0;
     Serial.println("SHT21 - Read failed");
   }
   
-  // Read BME680
-  if (bme680.performReading()) {
-    sensor_data.bme680_temp = bme680.temperature;
-    sensor_data.bme680_humidity = bme680.humidity;
-    sensor_data.bme680_pressure = bme680.pressure / 100.0; // Convert to hPa
-    sensor_data.bme680_gas = bme680.gas_resistance / 1000.0; // Convert to kOhm
-    sensor_data.bme680_valid = true;
+  if (bme680_started) {
+    readBME680(sample, bme680_state);
+  } else {
+    Serial.println("BME680 - No sensor to read");
+  }
+  
+  // data_fixed still holds the last good reading if this one failed
+  if (sample.flags & SAMPLE_BME680_VALID) {
+    sample.bme680_temp = bme680->data_fixed.temperature;
+    sample.bme680_pressure = bme680->data_fixed.pressure;
+    sample.bme680_humidity = bme680->data_fixed.humidity;
+    sample.bme680_gas = bme680->data_fixed.gas_resistance;
+    sample.iaq_score = bme680->calculate_iaq_score_fixed();
+    if (sample.iaq_score >= 0) sample.flags |= SAMPLE_IAQ_VALID;
+  } else {
+    sample.bme680_temp = 0;
+    sample.bme680_pressure = 0;
+    sample.bme680_humidity = 0;
+    sample.bme680_gas = 0;
+    sample.iaq_score = -1;
+  }
+  
+  // Next read interval and whether this sample gets published
+#if ADAPTIVE_SAMPLING
+  if (sample.flags & SAMPLE_SHT21_VALID) {
+    scheduler.update(adapt_temp, sample.sht21_temp);
+    scheduler.update(adapt_hum, sample.sht21_humidity);
+  }
+  if (sample.flags & SAMPLE_BME680_VALID) {
+    scheduler.update(adapt_pres, sample.bme680_pressure);
+  }
+  if (sample.flags & SAMPLE_IAQ_VALID) {
+    scheduler.update(adapt_iaq, sample.iaq_score);
+  }
+  scheduler.end_sample();
+#endif
+#if WINDOW_SUMMARIES
+  updateSummary(sample);
+#else
+  if (scheduler.publish_due(sample.timestamp)) {
+    sample.flags |= SAMPLE_SIGNIFICANT;
+    scheduler.published(sample.timestamp);
+  }
+#endif
+  
+  if (!sample_queue.push(sample)) {
+    samples_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  
+  if (bme680_calibration_pending && bme680->is_baseline_established()) {
+    bme680_calibration_pending = false;
+    
+    // Persist so the next boot reports IAQ without another burn-in
+    if (!bme680->save_state()) {
+      Serial.println("✗ Failed to save BME680 state to NVS");
+    }
+    
+    SensorEvent event = { SENSOR_EVENT_CALIBRATION_COMPLETE, 0,
+                          bme680->get_gas_baseline(), bme680->get_hum_baseline() };
+    sensor_event_queue.push(event);
+  }
+}
+
+#if WINDOW_SUMMARIES
+void updateSummary(const TelemetrySample& s) {
+  if (s.flags & SAMPLE_SHT21_VALID) {
+    summary_stats[SUMMARY_TEMP].add(s.sht21_temp);
+    summary_stats[SUMMARY_HUM].add(s.sht21_humidity);
+  }
+  if (s.flags & SAMPLE_BME680_VALID) {
+    summary_stats[SUMMARY_PRES].add(s.bme680_pressure);
+    summary_stats[SUMMARY_GAS].add(s.bme680_gas);
+  }
+  if (s.flags & SAMPLE_IAQ_VALID) {
+    summary_stats[SUMMARY_IAQ].add(s.iaq_score);
+  }
+  
+  if (!summary_open) {
+    summary_open = true;
+    summary_start = s.timestamp;
+  }
+  if (s.timestamp - summary_start < SUMMARY_WINDOW) {
+    return;
+  }
+  
+  // This sample closes the window
+  WindowReport report;
+  report.start = summary_start;
+  report.end = s.timestamp;
+  for (uint8_t i = 0; i < SUMMARY_CHANNELS; i++) {
+    summary_stats[i].summary(report.channels[i]);
+#if SUMMARY_SLIDING_SAMPLES == 0
+    summary_stats[i].reset();
+#endif
+  }
+  summary_open = false;
+  
+  if (!summary_queue.push(report)) {
+    summaries_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+#endif
+
+void waitForConversions(uint8_t& bme680_state, uint8_t& sht21_state) {
+  // Sleep until whichever conversion step is due first instead of polling the bus
+  while (bme680_state == MEAS_PENDING || sht21_state == MEAS_PENDING) {
+    uint16_t wait = 0xFFFF;
+    if (bme680_state == MEAS_PENDING) wait = min(wait, bme680_array.get_time_until_ready());
+    if (sht21_state == MEAS_PENDING) wait = min(wait, sht21.get_time_until_ready());
+    vTaskDelay(wait > 0 ? pdMS_TO_TICKS(wait) : 1);
     
-    Serial.print("BME680 - Temp: ");
-    Serial.print(sensor_data.bme680_temp);
+    if (bme680_state == MEAS_PENDING) bme680_state = bme680_array.poll();
+    if (sht21_state == MEAS_PENDING) sht21_state = sht21.poll();
+  }
+}
+
+void readBME680(TelemetrySample& sample, uint8_t state) {
+  if (state == MEAS_READY) {
+    bme680_array.fetch();
+  }
+  
+  for (uint8_t i = 0; i < bme680_array.size(); i++) {
+    if (!bme680_array.is_present(i)) continue;
+    BME680_Custom& sensor = bme680_array.device(i);
+    Serial.printf("BME680 0x%02X - ", sensor.get_i2c_address());
+  
+    if (!bme680_array.is_valid(i)) {
+      Serial.println("Read failed (conversion timed out)");
+      continue;
+    }
+    if (!sensor.data.heat_stable) {
+      Serial.println("Read failed (not heat stable)");
+      continue;
+    }
+    if (&sensor == bme680) {
+      sample.flags |= SAMPLE_BME680_VALID | SAMPLE_HEAT_STABLE;
+    }
+  
+    Serial.print("Temp: ");
+    Serial.print(sensor.data.temperature);
     Serial.print("°C, Humidity: ");
-    Serial.print(sensor_data.bme680_humidity);
+    Serial.print(sensor.data.humidity);
     Serial.print("%, Pressure: ");
-    Serial.print(sensor_data.bme680_pressure);
+    Serial.print(sensor.data.pressure);
     Serial.print(" hPa, Gas: ");
-    Serial.print(sensor_data.bme680_gas);
+    Serial.print(sensor.data.gas_resistance / 1000.0);
     Serial.println(" kOhm");
-  } else {
-    sensor_data.bme680_valid = false;
-    Serial.println("BME680 - Read failed (not heat stable)");
   }
 }
 
 // ============================================================================
-// LED CONTROL FUNCTIONS
+// LED CONTROL FUNCTIONS (loop())
 // ============================================================================
 
 void showStatusLED() {
-  // Show status with LED colors
+  // Flash the link state for 500 ms whenever it changes
   // Green = all good, Red = error, Blue = connecting
+  uint8_t state = link_state.load(std::memory_order_relaxed);
   
-  if (WiFi.status() == WL_CONNECTED && mqtt_client.connected()) {
-    // All good - green
-    setLEDColor(0, 255, 0, 0); // Green
-  } else if (WiFi.status() == WL_CONNECTED) {
-    // WiFi OK but MQTT not connected - blue
-    setLEDColor(0, 0, 255, 0); // Blue
-  } else {
-    // Not connected - red
-    setLEDColor(255, 0, 0, 0); // Red
+  if (state != shown_link_state) {
+    shown_link_state = state;
+    if (state == LINK_CONNECTED) {
+      // All good - green
+      setLEDColor(0, 255, 0, 0); // Green
+    } else if (state == LINK_WIFI) {
+      // WiFi OK but MQTT not connected - blue
+      setLEDColor(0, 0, 255, 0); // Blue
+    } else {
+      // Not connected - red
+      setLEDColor(255, 0, 0, 0); // Red
+    }
+    status_led_off_at = millis() + 500;
+  } else if (status_led_off_at && (long)(millis() - status_led_off_at) >= 0) {
+    status_led_off_at = 0;
+    clearLEDs();
   }
-  
-  delay(500);
-  strip.clear();
-  strip.show();
 }
 
 void setLEDColor(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+  uint32_t color = ((uint32_t)w << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
   for (int i = 0; i < LED_COUNT; i++) {
-    strip.setPixelColor(i, strip.Color(r, g, b, w));
+    led_frame[i] = color;
   }
-  strip.show();
+  showStrip();
 }
 
-void handleBME680Calibration(String message) {
-  // Parse JSON calibration commands
-  // Example: {"action":"calibrate","duration":300}
-  
-  StaticJsonDocument<200> doc;
-  DeserializationError error = deserializeJson(doc, message);
+void showStrip() {
+  METRIC_SCOPE(metric_strip_show);
+  strip.show(led_frame, LED_COUNT);
+}
+
+void clearLEDs() {
+  setLEDColor(0, 0, 0, 0);
+}
+
+void applyLEDCommand(const LedCommand& cmd) {
+  // A command overrides a status flash still in progress
+  status_led_off_at = 0;
   
-  if (error) {
-    Serial.print("JSON parse error: ");
-    Serial.println(error.c_str());
-    return;
+  if (cmd.type == LED_CMD_SET_COLOR) {
+    setLEDColor(cmd.r, cmd.g, cmd.b, cmd.w);
+    Serial.printf("LED color set: R=%d G=%d B=%d W=%d\n", cmd.r, cmd.g, cmd.b, cmd.w);
+    
+  } else if (cmd.type == LED_CMD_SET_BRIGHTNESS) {
+    strip.set_levels(cmd.r, false);
+    showStrip();
+    Serial.printf("LED brightness set: %d\n", cmd.r);
+    
+  } else if (cmd.type == LED_CMD_CLEAR) {
+    clearLEDs();
+    Serial.println("LED strip cleared");
   }
+}
+
+// ============================================================================
+// MQTT COMMAND HANDLERS (network task)
+// ============================================================================
+
+void handleBME680Calibration(JsonDocument& doc) {
+  // JSON calibration commands
+  // Example: {"action":"calibrate","duration":300}
   
-  String action = doc["action"];
+  if (parseAction(doc["action"].as<const char*>()) == ACTION_CALIBRATE) {
+    SensorCommand cmd = { SENSOR_CMD_CALIBRATE, (uint16_t)(doc["duration"] | 300) };
+    if (sensor_cmd_queue.push(cmd)) {
+      xTaskNotifyGive(sensor_task_handle);
+    }
+  }
+}
+
+void publishCalibrationStatus(const SensorEvent& event) {
+  StaticJsonDocument<200> status;
   
-  if (action == "calibrate") {
-    uint16_t duration = doc["duration"] | 300;
-    Serial.print("Starting BME680 baseline calibration for ");
-    Serial.print(duration);
-    Serial.println(" seconds...");
+  if (event.type == SENSOR_EVENT_CALIBRATION_STARTED) {
+    status["calibration"] = "started";
+    status["duration"] = event.duration;
     
-    bool success = bme680.set_baselines(duration, true);
-    if (success) {
-      Serial.print("✓ Baseline established - Gas: ");
-      Serial.print(bme680.get_gas_baseline());
-      Serial.print(" Ohms, Hum: ");
-      Serial.print(bme680.get_hum_baseline());
-      Serial.println("%");
-      
-      // Publish calibration status
-      StaticJsonDocument<200> status;
-      status["calibration"] = "complete";
-      status["gas_baseline"] = bme680.get_gas_baseline();
-      status["hum_baseline"] = bme680.get_hum_baseline();
-      String payload;
-      serializeJson(status, payload);
-      mqtt_client.publish("sensors/esp32-s3/bme680/calibration_status", payload.c_str());
-    } else {
-      Serial.println("✗ Baseline calibration failed");
-    }
+  } else if (event.type == SENSOR_EVENT_CALIBRATION_COMPLETE) {
+    gas_baseline = event.gas_baseline;
+    hum_baseline = event.hum_baseline;
+    
+    Serial.print("✓ Baseline established - Gas: ");
+    Serial.print(gas_baseline);
+    Serial.print(" Ohms, Hum: ");
+    Serial.print(hum_baseline);
+    Serial.println("%");
+    
+    status["calibration"] = "complete";
+    status["gas_baseline"] = gas_baseline;
+    status["hum_baseline"] = hum_baseline;
+  }
+  
+  char payload[128];
+  if (toJson(status, payload, sizeof(payload)) > 0) {
+    mqttPublish("sensors/esp32-s3/bme680/calibration_status", payload);
   }
 }
 
-void handleLEDControl(String message) {
-  // Parse JSON LED control commands
+void handleLEDControl(JsonDocument& doc) {
+  // JSON LED control commands
   // Example: {"action":"set_color","r":255,"g":0,"b":0,"w":0}
   // Example: {"action":"set_brightness","value":128}
   // Example: {"action":"clear"}
   
-  StaticJsonDocument<200> doc;
-  DeserializationError error = deserializeJson(doc, message);
+  LedCommand cmd = { 0, 0, 0, 0, 0 };
   
-  if (error) {
-    Serial.print("JSON parse error: ");
-    Serial.println(error.c_str());
-    return;
+  switch (parseAction(doc["action"].as<const char*>())) {
+    case ACTION_SET_COLOR:
+      cmd.type = LED_CMD_SET_COLOR;
+      cmd.r = doc["r"] | 0;
+      cmd.g = doc["g"] | 0;
+      cmd.b = doc["b"] | 0;
+      cmd.w = doc["w"] | 0;
+      break;
+    case ACTION_SET_BRIGHTNESS:
+      cmd.type = LED_CMD_SET_BRIGHTNESS;
+      cmd.r = doc["value"] | 50;
+      break;
+    case ACTION_CLEAR:
+      cmd.type = LED_CMD_CLEAR;
+      break;
+    default:
+      return;
   }
   
-  String action = doc["action"];
-  
-  if (action == "set_color") {
-    uint8_t r = doc["r"] | 0;
-    uint8_t g = doc["g"] | 0;
-    uint8_t b = doc["b"] | 0;
-    uint8_t w = doc["w"] | 0;
-    setLEDColor(r, g, b, w);
-    Serial.printf("LED color set: R=%d G=%d B=%d W=%d\n", r, g, b, w);
-    
-  } else if (action == "set_brightness") {
-    uint8_t brightness = doc["value"] | 50;
-    strip.setBrightness(brightness);
-    strip.show();
-    Serial.printf("LED brightness set: %d\n", brightness);
-    
-  } else if (action == "clear") {
-    strip.clear();
-    strip.show();
-    Serial.println("LED strip cleared");
+  if (!led_queue.push(cmd)) {
+    Serial.println("✗ LED command queue full - command dropped");
   }
 }
-
@@ -0,0 +1,393 @@
+/*
+ * ESP32-S3 Battery Sensor Node with MQTT (deep-sleep duty cycle)
+ *
+ * Features:
+ * - SHT21/HTU21 Temperature & Humidity sensor (I2C)
+ * - BME680 Temperature, Humidity, Pressure & Gas sensor (I2C)
+ * - One forced-mode reading per wake, then deep sleep
+ * - Samples collected in RTC memory and published as one binary batch
+ *   frame per batch window; WiFi stays off on the other wakes
+ * - BME680 calibration, settings and IAQ baseline ring kept in RTC
+ *   memory, so a wake skips the coefficient read and reconfiguration
+ * - WiFi channel, BSSID and IP lease cached for a fast reconnect
+ *
+ * Everything runs in setup(); loop() is never reached.
+ *
+ * Hardware:
+ * - ESP32-S3 (lonely binary GOLD EDITION)
+ * - SHT21/HTU21 on I2C (default 0x40)
+ * - BME680 on I2C (default 0x76 or 0x77)
+ *
+ * Libraries Required:
+ * - WiFi (built-in)
+ * - Wire (built-in)
+ * - PubSubClient (MQTT)
+ * - BME680_Custom (BME680 and SHT21/HTU21) and HotPathMetrics, included in
+ *   Arduino/libraries
+ */
+
+#include <WiFi.h>
+#include <Wire.h>
+#include <PubSubClient.h>
+#include <esp_sleep.h>
+#include "BME680_Custom.h"  // Custom BME680 library with IAQ support
+#include "HTU21Async.h"     // No-hold SHT21/HTU21 driver
+#include "TelemetryBatch.h" // Packed sample ring and binary frames
+#include <ArduinoJson.h>
+
+// ============================================================================
+// CONFIGURATION - Modify these values for your setup
+// ============================================================================
+
+// WiFi Configuration
+const char* ssid = "YOUR_WIFI_SSID";
+const char* password = "YOUR_WIFI_PASSWORD";
+
+// MQTT Configuration
+const char* mqtt_server = "192.168.1.XXX";  // Raspberry Pi IP address
+const int mqtt_port = 1883;
+const char* mqtt_client_id = "esp32-s3-node";
+const char* mqtt_topic_status = "sensors/esp32-s3-node/status";
+const char* mqtt_topic_batch = "sensors/esp32-s3-node/batch";
+
+// I2C Configuration
+#define I2C_SDA 21  // Default I2C SDA pin
+#define I2C_SCL 22  // Default I2C SCL pin
+
+// SHT21/HTU21 Configuration
+HTU21Async sht21;
+
+// BME680 Configuration
+#define BME680_I2C_ADDRESS BME680_I2C_ADDR_SECONDARY  // Use BME680_I2C_ADDR_PRIMARY (0x76) if SDO is connected to GND
+#define BME680_HEATER_TEMP     320   // degC
+#define BME680_HEATER_DURATION 150   // ms
+#define BME680_BURN_IN         300   // s of readings before the IAQ baseline is set
+BME680_Custom bme680(BME680_I2C_ADDRESS);
+
+// Duty Cycle
+// One reading per SAMPLE_INTERVAL (wake time included). The batch is
+// published when its oldest sample is BATCH_WINDOW old, or when the ring
+// is full; samples survive failed publishes until they are overwritten.
+const unsigned long SAMPLE_INTERVAL = 60000;   // Read once a minute
+const unsigned long BATCH_WINDOW = 600000;     // Publish at most every 10 minutes
+#define BATCH_CAPACITY 60                      // Samples kept in RTC memory
+#define MIN_SLEEP_MS 1000                      // Shortest sleep after a long wake
+
+// Delta frames ('TD' in TelemetryBatch.h) send each sample as varint
+// differences from the previous one, about 11 bytes for slowly changing
+// readings instead of 25, so less time with the radio on. Set to false
+// for the fixed-size 'TB' frames.
+#define BATCH_DELTA true
+
+// Connection Timeouts (per wake)
+const unsigned long WIFI_CONNECT_TIMEOUT = 8000;      // Full scan and DHCP
+const unsigned long WIFI_FAST_CONNECT_TIMEOUT = 3000; // Cached channel/BSSID/IP
+const unsigned long MQTT_CONNECT_TIMEOUT = 3000;
+
+// Set to false to skip serial output (saves ~1 s per cold boot)
+#define SERIAL_LOG true
+
+// ============================================================================
+// RTC MEMORY (survives deep sleep and resets, cleared on power-up)
+// ============================================================================
+
+// WiFi association cached from the last successful connect
+struct WiFiCache {
+  bool valid;
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+RTC_DATA_ATTR uint32_t wake_count = 0;
+RTC_DATA_ATTR uint32_t node_clock = 0;     // ms at the start of this wake (sample timestamps)
+RTC_DATA_ATTR uint32_t last_sleep_ms = 0;
+RTC_DATA_ATTR BME680SleepState bme680_sleep;
+RTC_DATA_ATTR TelemetryBatch<BATCH_CAPACITY> sample_batch;
+RTC_DATA_ATTR uint32_t batch_seq = 0;
+RTC_DATA_ATTR uint32_t publish_failures = 0;
+RTC_DATA_ATTR WiFiCache wifi_cache;
+
+// ============================================================================
+// GLOBAL VARIABLES
+// ============================================================================
+
+WiFiClient espClient;
+PubSubClient mqtt_client(espClient);
+
+#if BATCH_DELTA
+#define BATCH_FRAME_SIZE(n) TELEMETRY_DELTA_FRAME_MAX(n)
+#else
+#define BATCH_FRAME_SIZE(n) TELEMETRY_FRAME_SIZE(n)
+#endif
+uint8_t batch_frame[BATCH_FRAME_SIZE(BATCH_CAPACITY)];
+
+#if SERIAL_LOG
+#define LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+
+// ============================================================================
+// SETUP (one duty cycle)
+// ============================================================================
+
+void setup() {
+#if SERIAL_LOG
+  Serial.begin(115200);
+#endif
+  
+  bool woke_from_sleep = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+  if (!woke_from_sleep) {
+#if SERIAL_LOG
+    delay(1000);
+#endif
+    LOG("\n\nESP32-S3 Battery Sensor Node\n");
+  }
+  wake_count++;
+  
+  Wire.begin(I2C_SDA, I2C_SCL);
+  // The SHT21 stays powered and configured while the ESP32-S3 sleeps
+  bool sht21_found = woke_from_sleep || sht21.begin();
+  bool bme680_found = initBME680(woke_from_sleep);
+  
+  if (!woke_from_sleep) {
+    LOG("%s SHT21/HTU21 sensor %s\n", sht21_found ? "✓" : "✗", sht21_found ? "found" : "not found!");
+    LOG("%s BME680 sensor %s\n", bme680_found ? "✓" : "✗", bme680_found ? "found" : "not found!");
+  }
+  
+  TelemetrySample sample;
+  readSensors(sample, bme680_found);
+  sample_batch.push(sample);
+  
+  if (sample_batch.due(nodeTime(), BATCH_CAPACITY, BATCH_WINDOW)) {
+    publishBatch();
+  }
+  
+  goToSleep();
+}
+
+void loop() {
+  // Not reached: setup() ends in deep sleep
+}
+
+// ============================================================================
+// SENSORS
+// ============================================================================
+
+uint32_t nodeTime() {
+  return node_clock + millis();
+}
+
+bool initBME680(bool woke_from_sleep) {
+  // After a timer wake the sensor still holds its settings; only the
+  // driver state needs to come back from RTC memory
+  if (woke_from_sleep && bme680.resume(bme680_sleep, last_sleep_ms)) {
+    return true;
+  }
+  
+  // Cold start: coefficients and baseline from NVS if they were saved
+  bool restored = bme680.restore_state();
+  if (!bme680.begin()) {
+    bme680_sleep.magic = 0;
+    return false;
+  }
+  
+  bme680.set_gas_heater_temperature(BME680_HEATER_TEMP);
+  bme680.set_gas_heater_duration(BME680_HEATER_DURATION);
+  bme680.select_gas_heater_profile(0);
+  
+  if (restored && bme680.is_baseline_established()) {
+    LOG("  IAQ baseline restored from NVS\n");
+  } else {
+    // Built from one reading per wake, across sleeps
+    bme680.set_baselines(BME680_BURN_IN);
+    LOG("  IAQ baseline calibration running (%d s)\n", BME680_BURN_IN);
+  }
+  return true;
+}
+
+void readSensors(TelemetrySample& sample, bool bme680_found) {
+  sample.timestamp = nodeTime();
+  sample.flags = 0;
+  
+  // Both sensors convert at the same time, so the wake is only as long
+  // as the slower of the two
+  bool calibrating = bme680.is_calibrating();
+  uint8_t bme680_state = bme680_found && bme680.start_measurement() ? MEAS_PENDING : MEAS_ERROR;
+  uint8_t sht21_state = sht21.start() ? MEAS_PENDING : MEAS_ERROR;
+  
+  while (bme680_state == MEAS_PENDING || sht21_state == MEAS_PENDING) {
+    uint16_t wait = 0xFFFF;
+    if (bme680_state == MEAS_PENDING) wait = min(wait, bme680.get_time_until_ready());
+    if (sht21_state == MEAS_PENDING) wait = min(wait, sht21.get_time_until_ready());
+    delay(wait > 0 ? wait : 1);
+    
+    if (bme680_state == MEAS_PENDING) bme680_state = bme680.poll();
+    if (sht21_state == MEAS_PENDING) sht21_state = sht21.poll();
+  }
+  
+  if (sht21_state == MEAS_READY) {
+    sample.sht21_temp = sht21.get_temperature_fixed();
+    sample.sht21_humidity = sht21.get_humidity_fixed();
+    sample.flags |= SAMPLE_SHT21_VALID;
+  } else {
+    sample.sht21_temp = 0;
+    sample.sht21_humidity = 0;
+  }
+  
+  // An unstable gas reading would give a bogus IAQ score
+  if (bme680_state == MEAS_READY && bme680.fetch() && bme680.data_fixed.heat_stable) {
+    sample.bme680_temp = bme680.data_fixed.temperature;
+    sample.bme680_pressure = bme680.data_fixed.pressure;
+    sample.bme680_humidity = bme680.data_fixed.humidity;
+    sample.bme680_gas = bme680.data_fixed.gas_resistance;
+    sample.flags |= SAMPLE_BME680_VALID | SAMPLE_HEAT_STABLE;
+    sample.iaq_score = bme680.calculate_iaq_score_fixed();
+    if (sample.iaq_score >= 0) sample.flags |= SAMPLE_IAQ_VALID;
+  } else {
+    sample.bme680_temp = 0;
+    sample.bme680_pressure = 0;
+    sample.bme680_humidity = 0;
+    sample.bme680_gas = 0;
+    sample.iaq_score = -1;
+  }
+  
+  // A finished baseline also goes to NVS so a power cycle keeps it
+  if (calibrating && bme680.is_baseline_established()) {
+    LOG("✓ Baseline established - Gas: %u Ohms\n", (unsigned)bme680.get_gas_baseline_fixed());
+    bme680.save_state();
+  }
+  
+  LOG("#%u SHT21 %d/%u BME680 %d/%u/%u/%u IAQ %d flags 0x%02x\n",
+      (unsigned)wake_count, sample.sht21_temp, sample.sht21_humidity,
+      sample.bme680_temp, (unsigned)sample.bme680_pressure,
+      (unsigned)sample.bme680_humidity, (unsigned)sample.bme680_gas,
+      sample.iaq_score, sample.flags);
+}
+
+// ============================================================================
+// NETWORK (only on publishing wakes)
+// ============================================================================
+
+bool waitForWiFi(unsigned long timeout) {
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= timeout) {
+      return false;
+    }
+    delay(10);
+  }
+  return true;
+}
+
+bool connectWiFi() {
+  WiFi.persistent(false);  // Don't rewrite the credentials in flash every wake
+  WiFi.mode(WIFI_STA);
+  
+  // Known channel, BSSID and address: no scan and no DHCP
+  if (wifi_cache.valid) {
+    WiFi.config(IPAddress(wifi_cache.ip), IPAddress(wifi_cache.gateway),
+                IPAddress(wifi_cache.subnet), IPAddress(wifi_cache.dns));
+    WiFi.begin(ssid, password, wifi_cache.channel, wifi_cache.bssid);
+    if (waitForWiFi(WIFI_FAST_CONNECT_TIMEOUT)) {
+      return true;
+    }
+  
+    // AP moved or lease changed: fall back to a full connect
+    LOG("✗ Cached WiFi association failed - rescanning\n");
+    wifi_cache.valid = false;
+    WiFi.disconnect();
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+  }
+  
+  WiFi.begin(ssid, password);
+  if (!waitForWiFi(WIFI_CONNECT_TIMEOUT)) {
+    return false;
+  }
+  
+  memcpy(wifi_cache.bssid, WiFi.BSSID(), sizeof(wifi_cache.bssid));
+  wifi_cache.channel = WiFi.channel();
+  wifi_cache.ip = WiFi.localIP();
+  wifi_cache.gateway = WiFi.gatewayIP();
+  wifi_cache.subnet = WiFi.subnetMask();
+  wifi_cache.dns = WiFi.dnsIP();
+  wifi_cache.valid = true;
+  return true;
+}
+
+bool connectMQTT() {
+  mqtt_client.setServer(mqtt_server, mqtt_port);
+  mqtt_client.setBufferSize(sizeof(batch_frame) + 64);
+  mqtt_client.setSocketTimeout(MQTT_CONNECT_TIMEOUT / 1000);
+  return mqtt_client.connect(mqtt_client_id);
+}
+
+void publishStatus(unsigned long wake_ms) {
+  StaticJsonDocument<200> doc;
+  doc["status"] = "sleeping";
+  doc["wakes"] = wake_count;
+  doc["wake_ms"] = wake_ms;
+  doc["wifi_rssi"] = WiFi.RSSI();
+  doc["publish_failures"] = publish_failures;
+  
+  char payload[160];
+  serializeJson(doc, payload);
+  mqtt_client.publish(mqtt_topic_status, payload);
+}
+
+void publishBatch() {
+  unsigned long start = millis();
+  bool sent = false;
+  
+  if (connectWiFi() && connectMQTT()) {
+#if BATCH_DELTA
+    size_t len = sample_batch.encode_delta(batch_frame, sizeof(batch_frame), batch_seq, nodeTime());
+#else
+    size_t len = sample_batch.encode(batch_frame, sizeof(batch_frame), batch_seq, nodeTime());
+#endif
+    if (len > 0 && mqtt_client.publish(mqtt_topic_batch, batch_frame, len)) {
+      LOG("Published batch #%u: %u samples, %u bytes\n",
+          (unsigned)batch_seq, sample_batch.size(), (unsigned)len);
+      sample_batch.clear();
+      batch_seq++;
+      sent = true;
+    }
+    publishStatus(millis());
+    mqtt_client.disconnect();
+  }
+  
+  if (!sent) {
+    // Samples stay in RTC memory for the next window
+    publish_failures++;
+    LOG("✗ Batch publish failed - %u samples kept\n", sample_batch.size());
+  }
+  LOG("  Network: %lu ms\n", millis() - start);
+  
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+}
+
+// ============================================================================
+// DEEP SLEEP
+// ============================================================================
+
+void goToSleep() {
+  bme680.export_sleep_state(bme680_sleep);
+  
+  // Keep the sample rate steady: sleep for what is left of the interval
+  unsigned long awake = millis();
+  last_sleep_ms = (awake + MIN_SLEEP_MS < SAMPLE_INTERVAL) ? SAMPLE_INTERVAL - awake : MIN_SLEEP_MS;
+  node_clock += awake + last_sleep_ms;
+  
+  LOG("Awake %lu ms, sleeping %lu ms\n", awake, (unsigned long)last_sleep_ms);
+#if SERIAL_LOG
+  Serial.flush();
+#endif
+  
+  esp_sleep_enable_timer_wakeup((uint64_t)last_sleep_ms * 1000ULL);
+  esp_deep_sleep_start();
+}
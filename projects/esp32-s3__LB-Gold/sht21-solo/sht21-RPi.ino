@@ -14,12 +14,14 @@
  * - MQTT_RPi_Client (for MQTT connection to Raspberry Pi)
  * - SparkFun HTU21D (for SHT21/HTU21)
  * - ArduinoJson (for JSON messages)
+ * - AdaptiveScheduler (Arduino/libraries in this repo)
  */
 
 #include <Wire.h>
 #include <MQTT_RPi_Client.h>
 #include <SparkFunHTU21D.h>
 #include <ArduinoJson.h>
+#include <AdaptiveScheduler.h>
 
 // ============================================================================
 // CONFIGURATION - Modify these values for your setup
@@ -44,6 +46,18 @@ HTU21D sht21;
 const unsigned long SENSOR_READ_INTERVAL = 5000;   // Read sensor every 5 seconds
 const unsigned long MQTT_PUBLISH_INTERVAL = 5000;  // Publish to MQTT every 30 seconds
 
+// Adaptive sampling: stable readings stretch the read interval up to
+// SENSOR_READ_INTERVAL_MAX, and readings are published only when they move
+// past the deadband (or after SENSOR_HEARTBEAT_INTERVAL). Set to false for
+// the fixed intervals above.
+#define ADAPTIVE_SAMPLING true
+const unsigned long SENSOR_READ_INTERVAL_MAX = 60000;    // Stable: read every minute
+const unsigned long SENSOR_HEARTBEAT_INTERVAL = 300000;  // Publish at least every 5 minutes
+#define ADAPT_TEMP_DEADBAND  20    // 0.2 degC (centi-degC)
+#define ADAPT_TEMP_FAST      100   // 1 degC
+#define ADAPT_HUM_DEADBAND   100   // 1 %RH (centi-%RH)
+#define ADAPT_HUM_FAST       500   // 5 %RH
+
 // ============================================================================
 // GLOBAL VARIABLES
 // ============================================================================
@@ -58,6 +72,12 @@ float current_temp = 0.0;
 float current_humidity = 0.0;
 bool sensor_valid = false;
 
+#if ADAPTIVE_SAMPLING
+AdaptiveScheduler scheduler(SENSOR_READ_INTERVAL, SENSOR_READ_INTERVAL_MAX, SENSOR_HEARTBEAT_INTERVAL);
+int8_t adapt_temp = scheduler.add_channel(ADAPT_TEMP_DEADBAND, ADAPT_TEMP_FAST);
+int8_t adapt_hum = scheduler.add_channel(ADAPT_HUM_DEADBAND, ADAPT_HUM_FAST);
+#endif
+
 // ============================================================================
 // SETUP
 // ============================================================================
@@ -137,6 +157,27 @@ void loop() {
   // Maintain MQTT connection (library handles reconnection automatically)
   mqtt.loop();
   
+#if ADAPTIVE_SAMPLING
+  // Read at the scheduler's interval and publish only what changed
+  if (current_time - last_sensor_read >= scheduler.interval()) {
+    readSensor();
+    last_sensor_read = current_time;
+    
+    if (sensor_valid) {
+      scheduler.update(adapt_temp, lroundf(current_temp * 100.0f));
+      scheduler.update(adapt_hum, lroundf(current_humidity * 100.0f));
+    }
+    scheduler.end_sample();
+    
+    if (scheduler.publish_due(current_time)) {
+      if (sensor_valid) {
+        publishSensorData();
+      }
+      publishStatus();
+      scheduler.published(current_time);
+    }
+  }
+#else
   // Read sensor at specified interval
   if (current_time - last_sensor_read >= SENSOR_READ_INTERVAL) {
     readSensor();
@@ -153,6 +194,7 @@ void loop() {
     publishStatus();
     last_mqtt_publish = current_time;
   }
+#endif
   
   delay(100); // Small delay to prevent watchdog issues
 }
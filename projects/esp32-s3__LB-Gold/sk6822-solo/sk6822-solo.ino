@@ -8,7 +8,7 @@
  * - SK6812 RGBW LED strip control
  * - MQTT pub/sub for commands and status
  * - Home Assistant compatible
- * - Multiple LED patterns and effects
+ * - Multiple LED patterns and effects (fixed frame rate, see LED_PatternEngine)
  * 
  * Hardware:
  * - ESP32-S3 (lonely binary GOLD EDITION)
@@ -17,11 +17,14 @@
  * Libraries Required:
  * - MQTT_Win_Client (included in libraries folder)
  * - Adafruit NeoPixel (for SK6812)
+ * - LED_PatternEngine (included in Arduino/libraries)
  * - ArduinoJson (for JSON parsing)
  */
 
 #include <MQTT_Win_Client.h>
 #include <Adafruit_NeoPixel.h>
+#include <PatternEngine.h>
+#include <RmtLedOutput.h>
 #include <ArduinoJson.h>
 
 // ============================================================================
@@ -66,25 +69,22 @@ const char* mqtt_topic_command = "controller/esp32-s3-led/command";  // Subscrib
 const char* mqtt_topic_state = "controller/esp32-s3-led/state";      // Publish state
 const char* mqtt_topic_status = "controller/esp32-s3-led/status";    // Publish status
 
-// SK6812 LED Strip Configuration
-
-#define COMMAND_PIN 12        // GPIO pin for LED data line (change as needed)
-#define COMMAND_COUNT 31     // Number of LEDs in strip
-#define COMMAND_BRIGHTNESS 50  // 0-255 (default brightness)
-
-#define STATUS_PIN 17        // GPIO pin for LED data line (change as needed)
-#define STATUS_COUNT 30     // Number of LEDs in strip
-#define STATUS_BRIGHTNESS 50  // 0-255 (default brightness)
-
-
-
-
-
-
+// SK6812 LED Strip Configuration (pins and counts defined above)
+#define PATTERN_FPS 50  // Pattern frame rate, independent of loop() timing
 
+// Both strips go through RMT, so show() doesn't hold the core during a
+// frame. The command strip is begun first and gets the DMA channel.
+RmtLedOutput strip(COMMAND_PIN, COMMAND_COUNT, LED_ORDER_GRBW);
+RmtLedOutput stateStrip(STATUS_PIN, STATUS_COUNT, LED_ORDER_GRBW);
 
-Adafruit_NeoPixel strip(LED_COUNT, LED_PIN, NEO_GRBW + NEO_KHZ800);
-Adafruit_NeoPixel stateStrip(STATE_LED_COUNT, STATE_LED_PIN, NEO_GRBW + NEO_KHZ800);
+// Renders both strips from its own timer. Each strip is one segment, so a
+// progress update only resends the status strip and a pattern only
+// resends the command strip.
+PatternEngine engine;
+int8_t command_channel = -1;
+int8_t status_channel = -1;
+int8_t command_segment = SEGMENT_NONE;
+int8_t status_segment = SEGMENT_NONE;
 
 // ============================================================================
 // GLOBAL VARIABLES
@@ -93,10 +93,7 @@ Adafruit_NeoPixel stateStrip(STATE_LED_COUNT, STATE_LED_PIN, NEO_GRBW + NEO_KHZ8
 MQTT_Win_Client mqtt;
 
 // LED state
-uint8_t current_brightness = LED_BRIGHTNESS;
-bool pattern_running = false;
-unsigned long pattern_start_time = 0;
-String current_pattern = "";
+uint8_t current_brightness = COMMAND_BRIGHTNESS;
 
 // State tracking
 struct LEDState {
@@ -104,7 +101,7 @@ struct LEDState {
   uint8_t g = 0;
   uint8_t b = 0;
   uint8_t w = 0;
-  uint8_t brightness = LED_BRIGHTNESS;
+  uint8_t brightness = COMMAND_BRIGHTNESS;
   String pattern = "";
   bool pattern_active = false;
 };
@@ -123,19 +120,23 @@ void setup() {
   Serial.println("ESP32-S3 LED Controller - MQTT");
   Serial.println("========================================\n");
   
-  // Initialize LED strip
-  strip.begin();
-  strip.setBrightness(current_brightness);
-  strip.clear();
-  strip.show();
-  Serial.println("✓ SK6812 LED strip initialized");
-  
-  // Initialize state LED strip
-  stateStrip.begin();
-  stateStrip.setBrightness(STATE_LED_BRIGHTNESS);
-  stateStrip.clear();
-  stateStrip.show();
-  Serial.println("✓ State LED strip initialized");
+  // Initialize LED strips (started and driven by the pattern engine).
+  // The command segment is added first so it is segment 0, which
+  // fill()/start()/stop() act on.
+  command_channel = engine.add_channel(strip);
+  status_channel = engine.add_channel(stateStrip);
+  command_segment = engine.add_segment("command", command_channel, 0);
+  status_segment = engine.add_segment("status", status_channel, 0);
+  engine.register_builtin_patterns();
+  engine.set_channel_brightness(command_channel, current_brightness);
+  engine.set_channel_brightness(status_channel, STATUS_BRIGHTNESS);
+  engine.clear();
+  engine.segment_clear(status_segment);
+  if (engine.begin(PATTERN_FPS)) {
+    Serial.println("✓ SK6812 LED strips initialized");
+  } else {
+    Serial.println("✗ LED pattern engine failed to start!");
+  }
   
   // Initialize MQTT client
   // Pass nullptr for parameters to use library defaults
@@ -180,11 +181,6 @@ void loop() {
   }
   last_connected = now_connected;
   
-  // Update running patterns
-  if (pattern_running) {
-    updatePattern();
-  }
-  
   delay(10); // Small delay to prevent watchdog issues
 }
 
@@ -244,10 +240,9 @@ void handleCommand(String action, JsonDocument& doc) {
       if (intensity_percent > 100) intensity_percent = 100;
       // Convert percentage to brightness value (0-255)
       current_brightness = (intensity_percent * 255) / 100;
-      strip.setBrightness(current_brightness);
+      engine.set_channel_brightness(command_channel, current_brightness);
     }
     
-    pattern_running = false;
     setLEDColor(r, g, b, w);
     
     // Update state
@@ -267,16 +262,13 @@ void handleCommand(String action, JsonDocument& doc) {
     
     current_brightness = brightness;
     led_state.brightness = brightness;
-    strip.setBrightness(brightness);
-    strip.show();
+    engine.set_channel_brightness(command_channel, brightness);
     
     publishState();
     Serial.printf("LED brightness set: %d\n", brightness);
     
   } else if (action == "clear") {
-    pattern_running = false;
-    strip.clear();
-    strip.show();
+    engine.clear();
     
     led_state.r = 0;
     led_state.g = 0;
@@ -297,10 +289,13 @@ void handleCommand(String action, JsonDocument& doc) {
       return;
     }
     
-    // Start pattern
-    pattern_running = true;
-    current_pattern = pattern_name;
-    pattern_start_time = millis();
+    // Resolve the name once; the engine dispatches by ID from then on
+    uint8_t pattern_id = engine.find_pattern(pattern_name.c_str());
+    if (!engine.start(pattern_id, constrain(speed, 1, 255))) {
+      Serial.print("Unknown pattern: ");
+      Serial.println(pattern_name);
+      return;
+    }
     
     led_state.pattern = pattern_name;
     led_state.pattern_active = true;
@@ -309,8 +304,7 @@ void handleCommand(String action, JsonDocument& doc) {
     Serial.printf("Pattern started: %s (speed: %d)\n", pattern_name.c_str(), speed);
     
   } else if (action == "stop") {
-    pattern_running = false;
-    current_pattern = "";
+    engine.stop();
     
     led_state.pattern = "";
     led_state.pattern_active = false;
@@ -403,21 +397,12 @@ void showStatusLED() {
   }
   
   delay(500);
-  strip.clear();
-  strip.show();
+  engine.clear();
 }
 
 void setLEDColor(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
-  for (int i = 0; i < LED_COUNT; i++) {
-    strip.setPixelColor(i, strip.Color(r, g, b, w));
-  }
-  strip.show();
-}
-
-void setLEDPixel(int index, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
-  if (index >= 0 && index < LED_COUNT) {
-    strip.setPixelColor(index, strip.Color(r, g, b, w));
-  }
+  // Stops any running pattern
+  engine.fill(r, g, b, w);
 }
 
 void setProgress(uint8_t percent, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
@@ -425,106 +410,16 @@ void setProgress(uint8_t percent, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
   if (percent > 100) percent = 100;
   
   // Calculate how many LEDs should be lit
-  int ledsToLight = (percent * STATE_LED_COUNT) / 100;
+  int ledsToLight = (percent * STATUS_COUNT) / 100;
   
-  // Clear the strip first
-  stateStrip.clear();
-  
-  // Light up the calculated number of LEDs
-  for (int i = 0; i < ledsToLight; i++) {
-    stateStrip.setPixelColor(i, stateStrip.Color(r, g, b, w));
+  // Build the bar and hand it to the engine; only the status strip is resent
+  uint32_t bar[STATUS_COUNT];
+  uint32_t color = Adafruit_NeoPixel::Color(r, g, b, w);
+  for (int i = 0; i < STATUS_COUNT; i++) {
+    bar[i] = i < ledsToLight ? color : 0;
   }
   
-  stateStrip.show();
+  engine.segment_write(status_segment, bar, STATUS_COUNT);
   
-  Serial.printf("Progress set: %d%% (%d/%d LEDs)\n", percent, ledsToLight, STATE_LED_COUNT);
+  Serial.printf("Progress set: %d%% (%d/%d LEDs)\n", percent, ledsToLight, STATUS_COUNT);
 }
-
-// ============================================================================
-// LED PATTERN FUNCTIONS
-// ============================================================================
-
-void updatePattern() {
-  if (!pattern_running) return;
-  
-  unsigned long elapsed = millis() - pattern_start_time;
-  
-  if (current_pattern == "rainbow") {
-    rainbowPattern(elapsed);
-  } else if (current_pattern == "chase") {
-    chasePattern(elapsed);
-  } else if (current_pattern == "fade") {
-    fadePattern(elapsed);
-  } else if (current_pattern == "wave") {
-    wavePattern(elapsed);
-  } else if (current_pattern == "sparkle") {
-    sparklePattern(elapsed);
-  }
-}
-
-void rainbowPattern(unsigned long elapsed) {
-  for (int i = 0; i < LED_COUNT; i++) {
-    int hue = (elapsed / 10 + i * 256 / LED_COUNT) % 256;
-    uint32_t color = Wheel(hue);
-    strip.setPixelColor(i, color);
-  }
-  strip.show();
-}
-
-void chasePattern(unsigned long elapsed) {
-  strip.clear();
-  int pos = (elapsed / 50) % (LED_COUNT * 2);
-  if (pos < LED_COUNT) {
-    setLEDPixel(pos, 255, 0, 0, 0); // Red
-  } else {
-    setLEDPixel(LED_COUNT * 2 - pos - 1, 0, 0, 255, 0); // Blue
-  }
-  strip.show();
-}
-
-void fadePattern(unsigned long elapsed) {
-  int brightness = (sin(elapsed / 50.0) + 1.0) * 127.5;
-  strip.setBrightness(brightness);
-  setLEDColor(255, 255, 255, 0); // White
-  strip.show();
-  strip.setBrightness(current_brightness); // Restore brightness
-}
-
-void wavePattern(unsigned long elapsed) {
-  for (int i = 0; i < LED_COUNT; i++) {
-    float wave = (sin((elapsed / 20.0) + (i * 0.5)) + 1.0) / 2.0;
-    uint8_t r = wave * 255;
-    uint8_t g = wave * 128;
-    uint8_t b = wave * 64;
-    setLEDPixel(i, r, g, b, 0);
-  }
-  strip.show();
-}
-
-void sparklePattern(unsigned long elapsed) {
-  static unsigned long last_sparkle = 0;
-  if (elapsed - last_sparkle > 100) {
-    strip.clear();
-    for (int i = 0; i < 5; i++) {
-      int pos = random(LED_COUNT);
-      setLEDPixel(pos, 255, 255, 255, 0);
-    }
-    strip.show();
-    last_sparkle = elapsed;
-  }
-}
-
-// Helper function for rainbow effect
-uint32_t Wheel(byte WheelPos) {
-  WheelPos = 255 - WheelPos;
-  if (WheelPos < 85) {
-    return strip.Color(255 - WheelPos * 3, 0, WheelPos * 3, 0);
-  }
-  if (WheelPos < 170) {
-    WheelPos -= 85;
-    return strip.Color(0, WheelPos * 3, 255 - WheelPos * 3, 0);
-  }
-  WheelPos -= 170;
-  return strip.Color(WheelPos * 3, 255 - WheelPos * 3, 0, 0);
-}
-
@@ -0,0 +1,271 @@
+#!/usr/bin/env python3
+"""
+ESP32 Telemetry Frame Decoder
+Decodes the binary sample frames published by the ESP32-S3 sketches
+(TelemetryBatch.h) and republishes each sample as JSON
+
+Features:
+- 'TB' frames: packed 25-byte samples
+- 'TD' frames: delta + zig-zag varint samples with a schema ID
+- Republishes one JSON message per sample, in sensor units
+- Decodes frames saved to files (--file), no MQTT needed
+
+Usage:
+    # Decode the batch and replay topics, republish samples as JSON
+    python esp32-telemetry.py --mqtt-host localhost --output-topic sensors/esp32-s3/samples
+
+    # Decode a saved frame
+    python esp32-telemetry.py --file frame.bin
+"""
+
+import sys
+import json
+import struct
+import argparse
+
+try:
+    import paho.mqtt.client as mqtt
+    MQTT_AVAILABLE = True
+except ImportError:
+    MQTT_AVAILABLE = False
+
+
+# Sample fields in wire order: (name, struct format, bits, signed).
+# Schema 1 is TelemetrySample (TelemetryBatch.h, TELEMETRY_SCHEMA_ID).
+SCHEMAS = {
+    1: [
+        ('timestamp', 'I', 32, False),        # ms since boot
+        ('sht21_temp', 'h', 16, True),        # centi-degC
+        ('sht21_humidity', 'H', 16, False),   # centi-%RH
+        ('bme680_temp', 'h', 16, True),       # centi-degC
+        ('bme680_pressure', 'I', 32, False),  # Pa
+        ('bme680_humidity', 'I', 32, False),  # milli-%RH
+        ('bme680_gas', 'I', 32, False),       # Ohms
+        ('iaq_score', 'h', 16, True),         # centi-points, -1 if not available
+        ('flags', 'B', 8, False),
+    ],
+}
+
+# Sample flags
+SAMPLE_SHT21_VALID = 0x01
+SAMPLE_BME680_VALID = 0x02
+SAMPLE_HEAT_STABLE = 0x04
+SAMPLE_IAQ_VALID = 0x08
+SAMPLE_SIGNIFICANT = 0x10
+
+TB_VERSION = 1
+TD_VERSION = 1
+
+
+class FrameError(ValueError):
+    """Frame is truncated or in an unknown format."""
+
+
+def _wrap(value: int, bits: int, signed: bool) -> int:
+    value &= (1 << bits) - 1
+    if signed and value >= 1 << (bits - 1):
+        value -= 1 << bits
+    return value
+
+
+def _varint(frame: bytes, pos: int) -> tuple[int, int]:
+    """Unsigned LEB128 at pos; returns (value, next position)."""
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(frame) or shift > 28:
+            raise FrameError("truncated varint")
+        byte = frame[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def _unzigzag(value: int) -> int:
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_tb(frame: bytes) -> dict:
+    """Decodes a 'TB' frame (fixed 25-byte samples)."""
+    if len(frame) < 16:
+        raise FrameError("truncated header")
+    magic, version, size, count, dropped, seq, uptime = struct.unpack_from("<2sBBHHII", frame)
+    if version != TB_VERSION:
+        raise FrameError(f"unknown TB version {version}")
+    fields = SCHEMAS[1]
+    fmt = "<" + "".join(f[1] for f in fields)
+    if size != struct.calcsize(fmt) or len(frame) < 16 + count * size:
+        raise FrameError("truncated samples")
+
+    samples = []
+    for i in range(count):
+        values = struct.unpack_from(fmt, frame, 16 + i * size)
+        samples.append({f[0]: v for f, v in zip(fields, values)})
+    return {'format': 'TB', 'schema': 1, 'dropped': dropped, 'seq': seq, 'uptime': uptime, 'samples': samples}
+
+
+def decode_td(frame: bytes) -> dict:
+    """Decodes a 'TD' frame (delta + zig-zag varint samples)."""
+    if len(frame) < 4:
+        raise FrameError("truncated header")
+    version, schema = frame[2], frame[3]
+    if version != TD_VERSION:
+        raise FrameError(f"unknown TD version {version}")
+    if schema not in SCHEMAS:
+        raise FrameError(f"unknown schema {schema}")
+    fields = SCHEMAS[schema]
+
+    pos = 4
+    count, pos = _varint(frame, pos)
+    dropped, pos = _varint(frame, pos)
+    seq, pos = _varint(frame, pos)
+    uptime, pos = _varint(frame, pos)
+
+    # Same state as the encoder: previous sample and time step, from zero
+    prev = [0] * len(fields)
+    step = 0
+    samples = []
+    for _ in range(count):
+        values = []
+        for i, (name, _fmt, bits, signed) in enumerate(fields):
+            if name == 'flags':
+                if pos >= len(frame):
+                    raise FrameError("truncated samples")
+                value = prev[i] ^ frame[pos]
+                pos += 1
+            elif name == 'timestamp':
+                raw, pos = _varint(frame, pos)
+                step = (step + _unzigzag(raw)) & 0xFFFFFFFF
+                value = (prev[i] + step) & 0xFFFFFFFF
+            else:
+                raw, pos = _varint(frame, pos)
+                value = _wrap(prev[i] + _unzigzag(raw), bits, signed)
+            values.append(value)
+        prev = values
+        samples.append(dict(zip((f[0] for f in fields), values)))
+    return {'format': 'TD', 'schema': schema, 'dropped': dropped, 'seq': seq, 'uptime': uptime, 'samples': samples}
+
+
+def decode_frame(frame: bytes) -> dict:
+    """Decodes either frame format, by its magic."""
+    if frame[:2] == b'TB':
+        return decode_tb(frame)
+    if frame[:2] == b'TD':
+        return decode_td(frame)
+    raise FrameError("not a telemetry frame")
+
+
+def sample_to_json(sample: dict) -> dict:
+    """One sample in sensor units, valid readings only."""
+    flags = sample['flags']
+    out = {'timestamp': sample['timestamp'] / 1000.0}
+    if flags & SAMPLE_SHT21_VALID:
+        out['sht21'] = {
+            'temperature': sample['sht21_temp'] / 100.0,
+            'humidity': sample['sht21_humidity'] / 100.0,
+        }
+    if flags & SAMPLE_BME680_VALID:
+        out['bme680'] = {
+            'temperature': sample['bme680_temp'] / 100.0,
+            'humidity': sample['bme680_humidity'] / 1000.0,
+            'pressure': sample['bme680_pressure'] / 100.0,       # hPa
+            'gas_resistance': sample['bme680_gas'] / 1000.0,     # kOhm
+            'heat_stable': bool(flags & SAMPLE_HEAT_STABLE),
+        }
+        if flags & SAMPLE_IAQ_VALID:
+            out['bme680']['iaq_score'] = sample['iaq_score'] / 100.0
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='ESP32 Telemetry Frame Decoder',
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="""
+Examples:
+  # Print decoded samples from the ESP32 batch and replay topics
+  esp32-telemetry.py --mqtt-host localhost
+
+  # Republish every sample as JSON
+  esp32-telemetry.py --mqtt-host localhost --output-topic sensors/esp32-s3/samples
+
+  # Decode saved frames
+  esp32-telemetry.py --file frame1.bin frame2.bin
+        """
+    )
+    parser.add_argument('--file', nargs='+', default=None,
+                       help='Decode frames from files and exit (no MQTT)')
+    parser.add_argument('--mqtt-host', default='localhost',
+                       help='MQTT broker host')
+    parser.add_argument('--mqtt-port', type=int, default=1883,
+                       help='MQTT broker port')
+    parser.add_argument('--topic', nargs='+', default=['sensors/esp32-s3/batch', 'sensors/esp32-s3/replay'],
+                       help='Frame topics to subscribe to')
+    parser.add_argument('--output-topic', default=None,
+                       help='Republish each sample as JSON on this topic')
+    parser.add_argument('--mqtt-client-id', default='esp32-telemetry-decoder',
+                       help='MQTT client ID (default: esp32-telemetry-decoder)')
+    parser.add_argument('--raw', action='store_true',
+                       help='Print samples in wire units (no scaling)')
+    parser.add_argument('--quiet', action='store_true',
+                       help='Suppress console output')
+    args = parser.parse_args()
+
+    def show(frame: bytes, source: str):
+        decoded = decode_frame(frame)
+        if not args.quiet:
+            print(f"{source}: {decoded['format']} seq {decoded['seq']}, {len(decoded['samples'])} samples, "
+                  f"{decoded['dropped']} dropped, {len(frame)} bytes")
+        for sample in decoded['samples']:
+            yield sample if args.raw else sample_to_json(sample)
+
+    if args.file:
+        for path in args.file:
+            with open(path, 'rb') as f:
+                for sample in show(f.read(), path):
+                    print(json.dumps(sample))
+        sys.exit(0)
+
+    if not MQTT_AVAILABLE:
+        print("❌ MQTT not available. Install with: uv pip install paho-mqtt")
+        sys.exit(1)
+
+    def on_connect(client, userdata, flags, reason_code, properties):
+        for topic in args.topic:
+            client.subscribe(topic, qos=1)
+        if not args.quiet:
+            print(f"✅ Connected, decoding {', '.join(args.topic)}")
+
+    def on_message(client, userdata, msg):
+        try:
+            for sample in show(msg.payload, msg.topic):
+                payload = json.dumps(sample)
+                if args.output_topic:
+                    client.publish(args.output_topic, payload, qos=1)
+                if not args.quiet:
+                    print(f"   {payload}")
+            sys.stdout.flush()
+        except FrameError as e:
+            print(f"   ❌ {msg.topic}: {e}", file=sys.stderr)
+
+    mqtt_client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, args.mqtt_client_id)
+    mqtt_client.on_connect = on_connect
+    mqtt_client.on_message = on_message
+    try:
+        mqtt_client.connect(args.mqtt_host, args.mqtt_port)
+    except Exception as e:
+        print(f"❌ MQTT connection failed: {e}")
+        sys.exit(1)
+
+    try:
+        mqtt_client.loop_forever()
+    except KeyboardInterrupt:
+        if not args.quiet:
+            print("\n✅ Decoder stopped")
+    mqtt_client.disconnect()
+
+
+if __name__ == '__main__':
+    main()